@@ -0,0 +1,65 @@
+#pragma once
+
+#include <moveit/robot_state/robot_state.h>
+#include <Eigen/Cholesky>
+#include <Eigen/Geometry>
+#include <vector>
+
+#include <modulation_rl/ik_stats.h>
+
+namespace anytime_ik {
+    struct Config {
+        // a partial solution is only executed if it is at least this close to the target [m, rad]
+        double max_pos_error = 0.02;
+        double max_rot_error = 0.1;
+        // share of the budget given to the full solve, the rest refines a partial solution
+        double full_solve_share = 0.7;
+        // damping and largest joint step [rad] of the damped least-squares iterations
+        double damping = 0.05;
+        double max_step = 0.2;
+        // metres per radian when ranking partial solutions
+        double rot_weight = 0.1;
+    };
+
+    struct Result {
+        ik_stats::IKStrategy strategy;
+        // distance between the pose of the returned joint values and the target
+        double pos_error;
+        double rot_error;
+    };
+
+    // IK with a hard time budget. Tries a full solve with setFromIK() first, if that fails refines the best joint values
+    // found from the seed with damped least-squares steps until the budget is used up, and holds the seed if the best of
+    // them is not within the acceptable pose error (or is rejected by the validity callback).
+    // kinematic_state is left at the returned joint values.
+    class AnytimeIK {
+      private:
+        Config config_;
+        std::vector<double> best_;
+        std::vector<double> positions_;
+        Eigen::MatrixXd jacobian_;
+        // temporaries of the damped least-squares steps, only dq_ is resized on the first call
+        Eigen::Matrix<double, 6, 6> jjt_;
+        Eigen::LDLT<Eigen::Matrix<double, 6, 6>> jjt_ldlt_;
+        Eigen::Matrix<double, 6, 1> jjt_solution_;
+        Eigen::VectorXd dq_;
+
+        void pose_error(robot_state::RobotState &state,
+                        const moveit::core::LinkModel *tip,
+                        const Eigen::Isometry3d &target,
+                        Eigen::Matrix<double, 6, 1> &error) const;
+
+      public:
+        explicit AnytimeIK(const Config &config = Config()) : config_(config){};
+        const Config &get_config() const { return config_; };
+        void set_config(const Config &config) { config_ = config; };
+        // budget [s] for the whole call. target is in the model frame of kinematic_state
+        Result solve(robot_state::RobotState &kinematic_state,
+                     const moveit::core::JointModelGroup *group,
+                     const std::string &tip_link,
+                     const Eigen::Isometry3d &target,
+                     const std::vector<double> &seed,
+                     double budget,
+                     const moveit::core::GroupStateValidityCallbackFn &validity_callback);
+    };
+}  // namespace anytime_ik
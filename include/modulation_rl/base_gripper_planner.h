@@ -35,6 +35,7 @@ class BaseGripperPlanner {
 
   public:
     BaseGripperPlanner();
+    virtual ~BaseGripperPlanner(){};
 
     PlannedVelocities transformToVelocity(tf::Transform current, tf::Transform next, tf::Transform baseTransform, double upper_vel_limit);
 
@@ -51,5 +52,10 @@ class BaseGripperPlanner {
 
     virtual tf::Transform get_last_attractor() = 0;
     virtual GripperPlan get_prev_plan() { return prevPlan_; };
+    // raw progress of the plan (for the gmm in the tip frame), to continue it from an env snapshot
+    const GripperPlan &get_plan_state() const { return prevPlan_; };
+    void set_plan_state(const GripperPlan &prev_plan) { prevPlan_ = prev_plan; };
+    virtual double get_time_offset() const { return 0.0; };
+    virtual void set_time_offset(double time_offset){};
     virtual std::vector<tf::Transform> get_mus() = 0;
 };
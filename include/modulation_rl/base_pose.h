@@ -0,0 +1,56 @@
+#pragma once
+
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+#include <tf/tf.h>
+#include <tf/transform_listener.h>
+#include <string>
+
+#include <modulation_rl/latest_value.h>
+
+namespace base_pose {
+    // newest base pose in the map frame and the base velocity from odometry (in the base frame)
+    struct BasePoseSample {
+        tf::Transform map_base;
+        double vel_x = 0.0;
+        double vel_y = 0.0;
+        double vel_yaw = 0.0;
+        ros::Time stamp;
+        bool valid = false;
+    };
+
+    // Base pose fed from the odometry callback into a lock-free latest-value slot, so that the per-step reads do not go through
+    // the tf buffer. The localization correction map -> odom changes slowly and is refreshed from tf within the callback at most
+    // every map_odom_period seconds. One reader thread at a time.
+    class BasePoseProvider {
+      private:
+        const std::string map_frame_;
+        const std::string base_frame_;
+        const ros::Duration map_odom_period_;
+        tf::TransformListener &listener_;
+        ros::Subscriber odom_sub_;
+        LatestValue<BasePoseSample> pose_;
+        double max_extrapolation_ = 0.1;
+        // only touched by the callback
+        tf::StampedTransform map_odom_;
+        bool have_map_odom_ = false;
+
+        void odom_callback(const nav_msgs::Odometry::ConstPtr &msg);
+
+      public:
+        BasePoseProvider(ros::NodeHandle &nh,
+                         const std::string &odom_topic,
+                         tf::TransformListener &listener,
+                         const std::string &map_frame,
+                         const std::string &base_frame,
+                         double map_odom_period = 0.1);
+        // false until the first odometry message could be transformed into the map frame
+        bool has_pose();
+        // newest pose, extrapolated with the last velocity to time (at most max_extrapolation seconds). ros::Time(0): as received
+        tf::Transform get(ros::Time time = ros::Time(0));
+        const BasePoseSample &get_sample();
+        void set_max_extrapolation(double max_extrapolation) { max_extrapolation_ = max_extrapolation; };
+        // constant twist in the base frame over dt
+        static tf::Transform extrapolate(const BasePoseSample &sample, double dt);
+    };
+}  // namespace base_pose
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <moveit/collision_detection/collision_matrix.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_state/robot_state.h>
+#include <tf/transform_datatypes.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <modulation_rl/latest_value.h>
+
+namespace collision_monitor {
+    // Checks the robot against the collision objects of the scene on its own thread, so that the step path neither waits for
+    // checkCollisionUnpadded nor shares a scene with the planning scene monitor's update thread. The env posts the newest
+    // joint values and base pose every cycle, the worker checks whichever snapshot is the newest once it is free and
+    // publishes the result. Results therefore lag the posted state by about one check.
+    // post(), take_collision() and clear() are called by one env thread, set_scene() while it is not stepping.
+    class SceneCollisionMonitor {
+      private:
+        struct StateSnapshot {
+            std::vector<double> joint_values;
+            double x = 0.0;
+            double y = 0.0;
+            double theta = 0.0;
+            // clear() calls before the post, results of older generations are dropped
+            uint32_t generation = 0;
+        };
+        const std::string joint_group_name_;
+        // group checked against the scene, all links if empty
+        const std::string collision_group_name_;
+        LatestValue<StateSnapshot> state_;
+        // private copy of the scene and its acm, guarded by scene_mutex_ (only contended by set_scene())
+        std::mutex scene_mutex_;
+        planning_scene::PlanningScenePtr scene_;
+        collision_detection::AllowedCollisionMatrix acm_;
+        robot_state::RobotStatePtr robot_state_;
+        // wakes the worker for a new snapshot
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+        bool posted_ = false;
+        std::atomic<bool> running_{true};
+        std::thread worker_;
+        // results packed into one word, so that clear() and a finishing check cannot interleave:
+        // generation << 32 | checks finished in this generation << 1 | any collision since the last take_collision()
+        std::atomic<uint64_t> result_{0};
+        std::atomic<bool> failed_{false};
+        // only touched by the env thread
+        uint32_t generation_ = 0;
+        uint32_t taken_checks_ = 0;
+
+        void run();
+        void add_result(uint32_t generation, bool collision);
+        // false if there is no scene yet
+        bool check(const StateSnapshot &snapshot, bool &collision);
+
+      public:
+        SceneCollisionMonitor(const std::string &joint_group_name, const std::string &collision_group_name);
+        ~SceneCollisionMonitor();
+        // check against a copy of scene with this acm from now on. The joints that are not posted keep their values in state
+        void set_scene(const planning_scene::PlanningSceneConstPtr &scene,
+                       const collision_detection::AllowedCollisionMatrix &acm,
+                       const robot_state::RobotState &state);
+        // newest joint values of the joint group and base pose in the world, never blocks on a running check
+        void post(const std::vector<double> &joint_values, const tf::Transform &base_transform);
+        // true if a check finished since the last call, collision then is whether any of them found one
+        bool take_collision(bool &collision);
+        // drop the results of states posted before, including the checks still running, e.g. from the previous episode
+        void clear();
+        // an exception was thrown by a check, the worker stopped
+        bool has_failed() const { return failed_.load(std::memory_order_relaxed); };
+    };
+}  // namespace collision_monitor
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <modulation_rl/profiler.h>
+
+namespace control_timing {
+    // timestamps of one control cycle of real / gazebo execution [s, ros time]
+    struct CycleRecord {
+        // rate_.sleep() returned
+        double wake;
+        // since the previous wake, NaN for the first cycle of an episode
+        double period;
+        // work between the previous wake and this sleep
+        double work;
+        // publishing the arm and base commands
+        double send;
+        // from the previous command until the first joint_states stamped after it, NaN if none arrived yet
+        double feedback_sample_delay;
+        bool deadline_miss;
+    };
+
+    // Cycle times, jitter around the expected period, send durations and feedback sample delays of the control loop.
+    // The newest cycles are kept in a fixed ring buffer, the histograms cover everything since the last reset().
+    // Not thread safe: written by the thread that runs the control cycles.
+    class ControlTiming {
+      private:
+        std::vector<CycleRecord> ring_;
+        uint64_t head_ = 0;
+        double expected_period_ = 0.0;
+        double last_wake_ = -1.0;
+        double sleep_start_ = -1.0;
+        profiler::Histogram cycle_time_;
+        profiler::Histogram jitter_;
+        profiler::Histogram work_;
+        profiler::Histogram send_;
+        profiler::Histogram feedback_sample_delay_;
+        uint64_t cycles_ = 0;
+        uint64_t deadline_misses_ = 0;
+        uint64_t episode_cycles_ = 0;
+        uint64_t episode_deadline_misses_ = 0;
+        CycleRecord &current() { return ring_[(head_ - 1) % ring_.size()]; };
+
+      public:
+        explicit ControlTiming(size_t capacity = 1024) : ring_(capacity){};
+        void set_expected_period(double period) { expected_period_ = period; };
+        // the first cycle after this does not count towards the cycles, cycle time, jitter and deadline misses
+        void begin_episode();
+        void sleep_start(double time) { sleep_start_ = time; };
+        // of the previous cycle, negative before the first cycle of an episode
+        double get_last_wake() const { return last_wake_; };
+        void wake(double time, bool met_deadline);
+        void command_sent(double time);
+        void add_feedback_sample_delay(double delay);
+        // cycles in the ring, oldest first
+        std::vector<CycleRecord> get_cycles() const;
+        const profiler::Histogram &get_cycle_time() const { return cycle_time_; };
+        const profiler::Histogram &get_jitter() const { return jitter_; };
+        const profiler::Histogram &get_work() const { return work_; };
+        const profiler::Histogram &get_send() const { return send_; };
+        const profiler::Histogram &get_feedback_sample_delay() const { return feedback_sample_delay_; };
+        // counters and mean / p50 / p95 / p99 / max per histogram [s]
+        std::map<std::string, double> get_summary() const;
+        // one line per cycle in the ring
+        void dump_csv(const std::string &filename) const;
+        void reset();
+    };
+}  // namespace control_timing
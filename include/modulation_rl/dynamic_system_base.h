@@ -24,30 +24,126 @@
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/system/error_code.hpp>
+#include <atomic>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <thread>
 #include "std_msgs/ColorRGBA.h"
 #include "tf/transform_datatypes.h"
 #include "visualization_msgs/MarkerArray.h"
 
+#include <modulation_rl/anytime_ik.h>
 #include <modulation_rl/base_gripper_planner.h>
+#include <modulation_rl/collision_monitor.h>
+#include <modulation_rl/control_timing.h>
 #include <modulation_rl/ellipse.h>
+#include <modulation_rl/env_rng.h>
+#include <modulation_rl/env_snapshot.h>
+#include <modulation_rl/episode_stats.h>
 #include <modulation_rl/gmm_planner.h>
+#include <modulation_rl/ik_stats.h>
+#include <modulation_rl/joint_stream.h>
+#include <modulation_rl/latest_value.h>
 #include <modulation_rl/linear_planner.h>
 #include <modulation_rl/modulation.h>
 #include <modulation_rl/modulation_ellipses.h>
+#include <modulation_rl/profiler.h>
+#include <modulation_rl/realtime.h>
+#include <modulation_rl/robot_state_cache.h>
+#include <modulation_rl/sim_clock.h>
 #include <modulation_rl/utils.h>
 #include <modulation_rl/worlds.h>
 
-// helper to be able to call ros::init before initialising node handle and rate
+// helper to be able to call ros::init before initialising node handle and rate.
+// An empty node_name initialises an anonymous "ds" node. A no-op if the process already called ros::init()
 class ROSCommonNode {
   protected:
-    ROSCommonNode(int argc, char **argv, const char *node_name) { ros::init(argc, argv, node_name); }
+    ROSCommonNode(int argc, char **argv, const std::string &node_name) {
+        if (node_name.empty()) {
+            ros::init(argc, argv, "ds", ros::init_options::AnonymousName);
+        } else {
+            ros::init(argc, argv, node_name);
+        }
+    }
 };
 
 class DynamicSystem_base : ROSCommonNode {
   private:
+    // arguments of reset() used for the episodes prepared in the background
+    struct AutoResetConfig {
+        std::vector<double> base_start;
+        std::string start_pose_distribution;
+        std::string gripper_goal_distribution;
+        std::string gmm_model_path;
+        double success_thres_dist;
+        double success_thres_rot;
+        double start_pause;
+    };
+    // start configuration, goal and planner of the next episode
+    struct PreparedEpisode {
+        tf::Transform base_transform;
+        tf::Transform rel_gripper_pose;
+        std::vector<double> joint_values;
+        tf::Transform gripper_goal_input;
+        tf::Transform gripper_goal;
+        tf::Transform base_goal;
+        int planner_slot;
+        BaseGripperPlanner *planner = NULL;
+    };
+    // planners owned by the env and reinitialised for every goal instead of allocating new ones.
+    // Two slots so that the auto-reset thread can prepare the next plan while the current one is in use
+    struct PlannerSlot {
+        LinearPlanner *linear = NULL;
+        GMMPlanner *gmm = NULL;
+    };
+    // outcome of one planner, base, ik and command cycle
+    struct ControlCycle {
+        GripperPlan next_plan;
+        // plan before the start pause is applied
+        tf::Transform planned_gripper;
+        tf::Transform planned_base;
+        tf::Transform desired_base;
+        tf::Transform desired_gripper_rel;
+        geometry_msgs::Twist base_cmd_rel;
+        bool found_ik;
+        // only set by the anytime ik
+        ik_stats::IKStrategy ik_strategy = ik_stats::FULL_SOLVE;
+        double ik_pos_error = 0.0;
+        double ik_rot_error = 0.0;
+        bool collision = false;
+        double regularization = 0.0;
+        double last_dt;
+    };
+    // latest action posted by step() to the control thread
+    struct ControlCommand {
+        std::vector<double> base_actions;
+        int max_allow_ik_errors;
+        double transition_noise_ee;
+        double transition_noise_base;
+    };
+    // published by the control thread after every cycle, retval as returned by step() for this cycle
+    struct ControlObs {
+        std::vector<double> retval;
+        uint64_t cycle = 0;
+        // sum of the rewards (incl. regularization) of all cycles since the thread started
+        double reward_total = 0.0;
+    };
+    // commands of one cycle, handed from the control thread to the command thread in real-time mode
+    struct RobotCommand {
+        trajectory_msgs::JointTrajectory arm;
+        geometry_msgs::Twist base;
+    };
+    // arguments the active planner was created with, so that a snapshot can re-plan
+    struct PlannerInit {
+        std::string gmm_model_path;
+        tf::Transform goal_input;
+        tf::Transform initial_gripper;
+        tf::Transform initial_base;
+    };
+
     ros::Publisher gripper_visualizer_;
     ros::Publisher traj_visualizer_;
     ros::Publisher robstate_visualizer_;
@@ -73,9 +169,100 @@ class DynamicSystem_base : ROSCommonNode {
     const double time_step_train_;
     const double min_goal_dist_;
     const double max_goal_dist_;
-    BaseGripperPlanner *gripper_planner_;
+    BaseGripperPlanner *gripper_planner_ = NULL;
+    PlannerSlot planner_slots_[2];
+    int active_planner_slot_ = 0;
+    PlannerInit planner_init_;
     // For the modulation using the ellipses
     modulation_ellipses::Modulation modulation_;
+    // [gripper pose, base pose] and the modulated [gripper, base] velocities of the current cycle
+    Eigen::VectorXf ellipse_pose_ = Eigen::VectorXf::Zero(14);
+    Eigen::VectorXf ellipse_speed_ = Eigen::VectorXf::Zero(14);
+    void modulate_ellipse_velocity(tf::Vector3 planned_base_vel_rel, tf::Vector3 planned_gripper_vel_rel, const tf::Transform &desiredGripperTransform);
+    // per-phase timings of step() and reset() and the trace recorder, off by default
+    profiler::Profiler profiler_;
+    // if set, the trace is written to this directory at the end of every episode
+    std::string trace_dump_dir_;
+    int episode_ = 0;
+    // outcomes and latencies of the ik calls
+    ik_stats::IKStats ik_stats_;
+    // anytime ik with a per-cycle budget, see set_anytime_ik()
+    bool anytime_ik_enabled_ = false;
+    bool strategy_in_obs_ = false;
+    anytime_ik::AnytimeIK anytime_ik_;
+    // time kept free for sending the commands after the ik in real / gazebo execution [s]
+    double ik_send_reserve_ = 0.005;
+    // strategy of the last control cycle, part of the obs with the anytime ik
+    ik_stats::IKStrategy ik_strategy_ = ik_stats::FULL_SOLVE;
+    double ik_budget();
+    // success, kin fails, path lengths and ik failures per relative gripper pose of the episodes
+    episode_stats::EpisodeStats episode_stats_;
+    // cycle times, deadline misses and feedback latencies of real / gazebo execution
+    control_timing::ControlTiming control_timing_;
+    // pipelined auto reset: the next episode is prepared on a background thread while the current one runs
+    bool auto_reset_ = false;
+    AutoResetConfig auto_reset_config_;
+    planning_scene::PlanningScenePtr auto_reset_scene_;
+    std::future<PreparedEpisode> next_episode_;
+    void prepare_next_episode();
+    void discard_prepared_episode();
+    PreparedEpisode prepare_episode(const AutoResetConfig config, uint32_t seed, robot_state::RobotStatePtr state, int planner_slot);
+    std::vector<double> auto_reset();
+    // step started by step_async()
+    std::future<std::vector<double>> pending_step_;
+    // step() without the pending step check, what step_async() and rollout() run
+    std::vector<double> run_step(int max_allow_ik_errors,
+                                 std::vector<double> base_actions,
+                                 double transition_noise_ee,
+                                 double transition_noise_base);
+    // arm commands streamed to the controller command topics, see set_stream_arm_commands()
+    bool stream_arm_commands_ = false;
+    joint_stream::TrajectoryStreamer arm_streamer_;
+    // joint values and scene objects from the topics instead of the get_planning_scene service, NULL unless init_controllers_
+    robot_state_cache::RobotStateCache *state_cache_ = NULL;
+    // checks the achieved states against the scene objects on its own thread and fills ControlCycle.collision. Created by the
+    // first reset() with init_controllers_, NULL otherwise
+    collision_monitor::SceneCollisionMonitor *collision_monitor_ = NULL;
+    // fixed-rate control thread for non-analytical worlds: runs the control cycles at rate_ with the newest posted action,
+    // started by step() and stopped once done or by any method that changes the env state
+    bool control_thread_enabled_ = false;
+    std::thread control_thread_;
+    std::atomic<bool> control_running_{false};
+    std::atomic<bool> control_failed_{false};
+    std::exception_ptr control_error_;
+    LatestValue<ControlCommand> action_mailbox_;
+    LatestValue<ControlObs> obs_mailbox_;
+    // reward_total already returned by step_control_thread()
+    double reward_read_ = 0.0;
+    // real-time mode, see set_realtime(). The control thread then only hands its commands to the command thread, which
+    // serializes and publishes them
+    bool realtime_ = false;
+    int realtime_priority_ = 0;
+    int realtime_cpu_ = -1;
+    std::thread command_thread_;
+    LatestValue<RobotCommand> command_mailbox_;
+    // lockstep mode in gazebo, see set_lockstep(). NULL otherwise
+    sim_clock::LockstepClock *lockstep_clock_ = NULL;
+    // current time of the world: sim time in lockstep mode, ros time otherwise
+    double world_time();
+    void command_loop();
+    void preallocate_control_buffers();
+    void control_loop();
+    void start_control_thread();
+    std::vector<double> step_control_thread(int max_allow_ik_errors,
+                                            const std::vector<double> &base_actions,
+                                            double transition_noise_ee,
+                                            double transition_noise_base);
+    ControlCycle control_cycle(std::vector<double> &base_actions, double transition_noise_ee, double transition_noise_base, bool pause_gripper);
+    // trace dump, path point and episode stats of a finished step
+    void record_step(PathPoint &path_point,
+                     const ControlCycle &cycle,
+                     const tf::Vector3 &planned_gripper_pos,
+                     const tf::Vector3 &prev_gripper_pos,
+                     const tf::Vector3 &prev_base_pos,
+                     int done_ret);
+    // auto reset once done
+    std::vector<double> finish_step(std::vector<double> obs_vector);
     ros::Publisher ellipses_pub_;
 
     // For collision checking
@@ -88,18 +275,36 @@ class DynamicSystem_base : ROSCommonNode {
     bool check_scene_collisions();
 
     void set_new_random_goal(std::string gripper_goal_distribution);
+    void call_get_scene_at_init(moveit_msgs::GetPlanningScene &srv);
+    tf::Transform draw_random_goal(const tf::Transform &currentBase, const std::string &gripper_goal_distribution, env_rng::Generator &rng) const;
+    BaseGripperPlanner *create_planner(int slot,
+                                       const std::string &gmm_model_path,
+                                       const tf::Transform &gripper_goal_input,
+                                       tf::Transform &gripper_goal,
+                                       const tf::Transform &gripper_transform,
+                                       const tf::Transform &base_goal,
+                                       const tf::Transform &base_transform);
+    std::vector<double> start_gripper_goal(const tf::Transform &currentGripperGOAL_input, bool is_gmm);
+    void begin_episode();
     int calc_done_ret(bool found_ik, int max_allow_ik_errors);
     std_msgs::ColorRGBA get_ik_color(double alpha);
     visualization_msgs::Marker create_vel_marker(tf::Transform current_tf, tf::Vector3 vel, std::string ns, std::string color, int marker_id);
-    bool set_start_pose(std::vector<double> base_start, std::string start_pose_distribution);
-    void set_gripper_to_neutral();
-    bool out_of_workspace(tf::Transform gripper_tf);
+    bool set_start_pose(std::vector<double> base_start, std::string start_pose_distribution, bool do_close_gripper);
+    tf::Transform draw_start_base(const std::vector<double> &base_start, env_rng::Generator &rng) const;
+    void draw_start_arm(const std::string &start_pose_distribution,
+                        const tf::Transform &base_transform,
+                        env_rng::Generator &rng,
+                        robot_state::RobotState &state,
+                        planning_scene::PlanningScenePtr scene) const;
+    bool out_of_workspace(tf::Transform gripper_tf) const;
     void update_current_gripper_from_world();
-    double draw_rng(double lower, double upper);
+    double draw_rng(double lower, double upper, env_rng::Generator &rng) const;
     void add_goal_marker_tf(tf::Transform transfm, int marker_id, std::string color);
     tf::Transform parse_goal(const std::vector<double> &gripper_goal);
 
   protected:
+    // node handle of the instance's namespace, robot topics and services are resolved relative to it
+    ros::NodeHandle *ns_nh_;
     //! The node handle we'll be using
     ros::NodeHandle *nh_;
     std::vector<std::string> joint_names_;
@@ -107,7 +312,7 @@ class DynamicSystem_base : ROSCommonNode {
     planning_scene::PlanningScenePtr planning_scene_;
     ros::Rate rate_;
 
-    random_numbers::RandomNumberGenerator rng_;
+    env_rng::Generator rng_;
 
     tf::Transform currentGripperGOAL_;
     tf::Transform currentBaseGOAL_;
@@ -126,7 +331,7 @@ class DynamicSystem_base : ROSCommonNode {
     double slow_down_factor_;
     bool perform_collision_check_;
 
-    BaseWorld *world_;
+    BaseWorld *world_ = NULL;
 
     // current velocity
     PlannedVelocities planned_gripper_vel_;
@@ -137,7 +342,7 @@ class DynamicSystem_base : ROSCommonNode {
 
     void add_trajectory_point(const GripperPlan &next_plan, bool found_ik);
 
-    bool set_pose_in_world();
+    bool set_pose_in_world(bool do_close_gripper);
     virtual void stop_controllers(){};
     virtual void start_controllers(){};
 
@@ -152,9 +357,24 @@ class DynamicSystem_base : ROSCommonNode {
                                                              const double &last_dt,
                                                              const tf::Transform &desiredGripperTransform);
     virtual bool find_ik(const Eigen::Isometry3d &desiredState, const tf::Transform &desiredGripperTfWorld);
+    anytime_ik::Result find_ik_anytime(const Eigen::Isometry3d &desiredState, double budget);
     virtual double calc_reward(bool found_ik, double regularization);
     virtual void send_arm_command(const std::vector<double> &target_joint_values, double exec_duration) = 0;
-    virtual bool get_arm_success() = 0;
+    // wait for the goals of the last send_arm_command() until deadline, true if all of them succeeded
+    virtual bool wait_for_arm(const ros::Time &deadline) = 0;
+    bool get_arm_success() { return wait_for_arm(ros::Time::now() + ros::Duration(10.0)); };
+    // gripper goals, without waiting. close: grasp with limited effort
+    virtual void send_gripper_command(double position, bool close) {
+        throw std::runtime_error("NOT IMPLEMENTED YET");
+    };
+    virtual bool wait_for_gripper(const ros::Time &deadline) { return true; };
+    // dispatch the arm goal (and the gripper goal unless gripper_position is NaN) together, then wait for all of them with one
+    // deadline. True if the arm goal succeeded, a failed gripper goal only logs a warning
+    bool move_to(const std::vector<double> &joint_values, double exec_duration, double gripper_position, bool close_gripper, double timeout);
+    // publish a streamed trajectory of joint_names_ to the arm controller(s)
+    virtual void stream_arm_command(const trajectory_msgs::JointTrajectory &traj) {
+        throw std::runtime_error("Streaming arm commands is not supported for " + robo_config_.name);
+    };
 
   public:
     DynamicSystem_base(uint32_t seed,
@@ -167,12 +387,34 @@ class DynamicSystem_base : ROSCommonNode {
                        double time_step,
                        double slow_down_real_exec,
                        bool perform_collision_check,
-                       RoboConf robo_config);
+                       RoboConf robo_config,
+                       std::string node_name = "",
+                       std::string ros_namespace = "");
     ~DynamicSystem_base() {
+        if (pending_step_.valid()) {
+            pending_step_.wait();
+        }
+        stop_control_thread();
+        discard_prepared_episode();
+        delete collision_monitor_;
+        delete state_cache_;
+        if (lockstep_clock_ != NULL) {
+            // do not leave the simulation paused for whoever uses it next
+            try {
+                lockstep_clock_->unpause();
+            } catch (const std::exception &e) {
+                ROS_WARN("%s", e.what());
+            }
+            delete lockstep_clock_;
+        }
         delete nh_;
+        delete ns_nh_;
         // spinner_->stop();
         delete spinner_;
-        delete gripper_planner_;
+        for (PlannerSlot &slot : planner_slots_) {
+            delete slot.linear;
+            delete slot.gmm;
+        }
         delete world_;
     }
 
@@ -180,6 +422,23 @@ class DynamicSystem_base : ROSCommonNode {
                              std::vector<double> base_actions,
                              double transition_noise_ee,
                              double transition_noise_base);
+    // step() on a background thread so that the caller can e.g. run inference for other envs meanwhile. The other
+    // methods throw until step_wait() returned its result
+    void step_async(int max_allow_ik_errors,
+                    std::vector<double> base_actions,
+                    double transition_noise_ee,
+                    double transition_noise_base);
+    std::vector<double> step_wait();
+    // throws while a step_async() step has not been collected by step_wait(), it runs against the same state
+    void check_no_pending_step(const char *caller) const;
+    // runs up to max_steps steps without returning to python, stopping once done. base_actions has one row per step, with no rows zero
+    // actions are used. Returns one row [obs, reward, done, ik fails] per executed step and, if an auto reset happened, the first
+    // obs of the new episode (the last row then holds the terminal obs of the finished one)
+    std::pair<Eigen::MatrixXd, std::vector<double>> rollout(int max_steps,
+                                                            int max_allow_ik_errors,
+                                                            const Eigen::MatrixXd &base_actions,
+                                                            double transition_noise_ee,
+                                                            double transition_noise_base);
     std::vector<double> reset(std::vector<double> gripper_goal,
                               std::vector<double> base_start,
                               std::string start_pose_distribution,
@@ -197,8 +456,18 @@ class DynamicSystem_base : ROSCommonNode {
                                          double success_thres_rot,
                                          double start_pause);
     std::vector<PathPoint> visualize_robot_pose(std::string logfile);
+    // joins the control thread, the next step() starts it again. Reads of the state it mutates (obs, distances, stats)
+    // from outside step() have to call this first
+    void stop_control_thread();
+    // obs for the current state and planned velocities
+    std::vector<double> get_obs();
     int get_obs_dim();
     std::vector<double> build_obs_vector(tf::Vector3 current_planned_base_vel_world, tf::Vector3 PlannedVelocities, tf::Quaternion current_planned_gripper_vel_world);
+    // same into an existing vector, does not reallocate once it has the capacity
+    void fill_obs_vector(std::vector<double> &obs_vector,
+                         const tf::Vector3 &current_planned_base_vel_world,
+                         const tf::Vector3 &current_planned_gripper_vel_world,
+                         const tf::Quaternion &current_planned_gripper_vel_dq);
     double get_dist_to_goal();
     double get_rot_dist_to_goal();
     void add_goal_marker(std::vector<double> pos, int marker_id, std::string color);
@@ -207,6 +476,83 @@ class DynamicSystem_base : ROSCommonNode {
     void set_real_execution(std::string real_execution, double time_step, double slow_down_real_exec);
     std::string get_real_execution() { return world_->get_name(); };
     double get_slow_down_factor() { return slow_down_factor_; };
+    void set_profiling(bool enabled) {
+        check_no_pending_step("set_profiling");
+        stop_control_thread();
+        profiler_.set_enabled(enabled);
+    };
+    const profiler::Profiler &get_profiler() const { return profiler_; };
+    void reset_profile() {
+        check_no_pending_step("reset_profile");
+        stop_control_thread();
+        profiler_.reset();
+    };
+    void set_tracing(bool enabled, std::string dump_dir);
+    void dump_trace(std::string filename);
+    const ik_stats::IKStats &get_ik_stats() const { return ik_stats_; };
+    std::string get_strategy() const { return strategy_; };
+    std::string get_robot_name() const { return robo_config_.name; };
+    void reset_ik_stats() {
+        check_no_pending_step("reset_ik_stats");
+        stop_control_thread();
+        ik_stats_.reset();
+    };
+    const episode_stats::EpisodeStats &get_episode_stats() const { return episode_stats_; };
+    void reset_episode_stats() {
+        check_no_pending_step("reset_episode_stats");
+        stop_control_thread();
+        episode_stats_.reset();
+    };
+    const control_timing::ControlTiming &get_control_timing() const { return control_timing_; };
+    void reset_control_timing() {
+        check_no_pending_step("reset_control_timing");
+        stop_control_thread();
+        control_timing_.reset();
+    };
+    // with auto reset, step() directly starts the next episode (drawn with these reset() arguments) once the current one is done
+    // and returns [first obs of the new episode, reward, done, ik fails, terminal obs of the finished episode]
+    void set_auto_reset(bool enabled,
+                        std::vector<double> base_start,
+                        std::string start_pose_distribution,
+                        std::string gripper_goal_distribution,
+                        std::string gmm_model_path,
+                        double success_thres_dist,
+                        double success_thres_rot,
+                        double start_pause);
+    bool get_auto_reset() const { return auto_reset_; };
+    // in real and gazebo execution run the control loop on its own thread at the configured rate, independent of the caller.
+    // step() then only posts its action and returns the newest observation, waiting at most one control cycle
+    void set_control_thread(bool enabled);
+    bool get_control_thread() const { return control_thread_enabled_; };
+    // in real and gazebo execution publish JointTrajectory messages with n_lookahead extrapolated points to the controller
+    // command topics every cycle instead of sending a new one-point actionlib goal that preempts the previous one
+    void set_stream_arm_commands(bool enabled, int n_lookahead);
+    bool get_stream_arm_commands() const { return stream_arm_commands_; };
+    // real-time mode for real execution: locks the process memory, runs the control thread with SCHED_FIFO priority
+    // (priority > 0) pinned to cpu (>= 0) and keeps allocations, visualization, logging and publishing off its cycles.
+    // Implies the control thread and streamed arm commands. Exempt from the no-allocation rule (realtime::AllocationExempt):
+    // the ik solvers, the planners and the ellipse modulation, the tf lookup of the base before the first odometry and the
+    // stop command after the last cycle of an episode. Switching it off unlocks the memory again
+    void set_realtime(bool enabled, int priority, int cpu);
+    bool get_realtime() const { return realtime_; };
+    // gazebo only: keep the simulation paused and advance it by exactly one control cycle per inner step, waiting only for the
+    // resulting state instead of sleeping on rate_. Runs as fast as the physics allows, requires /use_sim_time. Not combined
+    // with the control thread
+    void set_lockstep(bool enabled);
+    bool get_lockstep() const { return lockstep_clock_ != NULL; };
+    // anytime ik: each cycle's ik has to finish within what is left of the control period (minus send_reserve [s]) in real /
+    // gazebo execution, within the usual 0.05 s otherwise. Executes the full solution, else the best partial one within
+    // max_pos_error [m] / max_rot_error [rad] of the target, else holds the current joint values. Only the fallback counts as
+    // ik failure. With strategy_in_obs the strategy (0 full, 1 partial, 2 fallback) replaces the zero entry of the obs that
+    // trained checkpoints expect
+    void set_anytime_ik(bool enabled, double max_pos_error, double max_rot_error, double send_reserve, bool strategy_in_obs);
+    bool get_anytime_ik() const { return anytime_ik_enabled_; };
+    // capture the current state to evaluate several branches from it, including the state of the random stream, so that every
+    // restore() continues with the same noise as the run it was taken from. Also rewinds the logged path, the displayed
+    // trajectory and the metrics of the running episode. The cross-episode histograms count the steps of every branch
+    env_snapshot::Snapshot snapshot();
+    // analytical worlds only. Re-plans for the goal of the snapshot, does not touch a prepared auto reset episode
+    void restore(const env_snapshot::Snapshot &snapshot);
 };
 
 namespace validityFun {
@@ -214,6 +560,8 @@ namespace validityFun {
                             // const kinematics_constraint_aware::KinematicsRequest &request,
                             // kinematics_constraint_aware::KinematicsResponse &response,
                             robot_state::RobotStatePtr kinematic_state,
+                            profiler::Profiler *profiler,
+                            ik_stats::IKStats *ik_stats,
                             const robot_state::JointModelGroup *joint_model_group,
                             const double *joint_group_variable_values
                             // const std::vector<double> &joint_group_variable_values
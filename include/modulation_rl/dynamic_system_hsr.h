@@ -1,5 +1,6 @@
 #pragma once
 #include <modulation_rl/dynamic_system_base.h>
+#include <modulation_rl/goal_wait.h>
 
 #include <tmc_robot_kinematics_model/numeric_ik_solver.hpp>
 #include <tmc_robot_kinematics_model/robot_kinematics_model.hpp>
@@ -32,7 +33,7 @@ class DynamicSystemHSR : public DynamicSystem_base {
 
     control_msgs::FollowJointTrajectoryGoal arm_goal_;
     void send_arm_command(const std::vector<double> &target_joint_values, double exec_duration);
-    bool get_arm_success();
+    bool wait_for_arm(const ros::Time &deadline);
 
   public:
     DynamicSystemHSR(uint32_t seed,
@@ -1,5 +1,6 @@
 #pragma once
 #include <modulation_rl/dynamic_system_base.h>
+#include <modulation_rl/goal_wait.h>
 
 #include <actionlib/client/simple_action_client.h>
 #include <geometry_msgs/Twist.h>
@@ -18,11 +19,14 @@ class DynamicSystemPR2 : public DynamicSystem_base {
     // ros::ServiceClient switch_controller_client_;
     void setup();
     pr2_controllers_msgs::JointTrajectoryGoal arm_goal_;
+    ros::Publisher arm_command_pub_;
     void send_arm_command(const std::vector<double> &target_joint_values, double exec_duration);
-    bool get_arm_success();
+    bool wait_for_arm(const ros::Time &deadline);
+    void stream_arm_command(const trajectory_msgs::JointTrajectory &traj);
     // void stop_controllers();
     // void start_controllers();
-    void move_gripper(double position, double effort, bool wait_for_result);
+    void send_gripper_command(double position, bool close);
+    bool wait_for_gripper(const ros::Time &deadline);
 
   public:
     DynamicSystemPR2(uint32_t seed,
@@ -34,7 +38,9 @@ class DynamicSystemPR2 : public DynamicSystem_base {
                      double penalty_scaling,
                      double time_step,
                      double slow_down_real_exec,
-                     bool perform_collision_check);
+                     bool perform_collision_check,
+                     std::string node_name = "",
+                     std::string ros_namespace = "");
 
     ~DynamicSystemPR2() {
         delete gripper_client_;
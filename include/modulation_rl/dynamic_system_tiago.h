@@ -2,6 +2,7 @@
 #include <actionlib/client/simple_action_client.h>
 #include <control_msgs/FollowJointTrajectoryAction.h>
 #include <modulation_rl/dynamic_system_base.h>
+#include <modulation_rl/goal_wait.h>
 #include <ros/topic.h>
 // #include <controller_manager_msgs/SwitchController.h>
 #include <geometry_msgs/Twist.h>
@@ -22,6 +23,13 @@ class DynamicSystemTiago : public DynamicSystem_base {
     // moveit::planning_interface::MoveGroupInterface* move_group_arm_torso_;
     control_msgs::FollowJointTrajectoryGoal arm_goal_;
     control_msgs::FollowJointTrajectoryGoal torso_goal_;
+    // streamed commands are split into the torso and the arm controller
+    ros::Publisher arm_command_pub_;
+    ros::Publisher torso_command_pub_;
+    std::vector<int> arm_joint_idx_;
+    std::vector<int> torso_joint_idx_;
+    trajectory_msgs::JointTrajectory arm_traj_;
+    trajectory_msgs::JointTrajectory torso_traj_;
 
     void setup();
     geometry_msgs::Twist calc_desired_base_transform(std::vector<double> &base_actions,
@@ -34,7 +42,11 @@ class DynamicSystemTiago : public DynamicSystem_base {
                                                      const double &last_dt,
                                                      const tf::Transform &desiredGripperTransform);
     void send_arm_command(const std::vector<double> &target_joint_values, double exec_duration);
-    bool get_arm_success();
+    bool wait_for_arm(const ros::Time &deadline);
+    // the same position-controlled goal for opening and closing
+    void send_gripper_command(double position, bool close);
+    bool wait_for_gripper(const ros::Time &deadline);
+    void stream_arm_command(const trajectory_msgs::JointTrajectory &traj);
     // void stop_controllers();
     // void start_controllers();
   public:
@@ -47,7 +59,9 @@ class DynamicSystemTiago : public DynamicSystem_base {
                        double penalty_scaling,
                        double time_step,
                        double slow_down_real_exec,
-                       bool perform_collision_check);
+                       bool perform_collision_check,
+                       std::string node_name = "",
+                       std::string ros_namespace = "");
     ~DynamicSystemTiago() {
         // delete move_group_arm_torso_;
     }
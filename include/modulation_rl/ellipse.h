@@ -4,27 +4,45 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <boost/shared_ptr.hpp>
+#include <array>
+#include <string>
 #include <vector>
 namespace ellipse {
 
+    // values updated while modulating, the shape parameters of the type are fixed at construction
+    struct EllipseState {
+        std::string type;
+        double height = 0.0;
+        double width = 0.0;
+        double alpha_ap = 0.0;
+        double p_alpha = 0.0;
+        double gamma = 0.0;
+        // _R, row major
+        std::array<float, 4> R = {{1.0f, 0.0f, 0.0f, 1.0f}};
+        bool in_collision = false;
+        std::vector<double> hyper_normal;
+        std::array<double, 2> p_point = {{0.0, 0.0}};
+        std::vector<double> speed;
+    };
+
     class Ellipse {
       private:
         // line_extraction::Line _line;
         double _height;
         double _width;
-        double _alpha_ap;
+        double _alpha_ap = 0.0;
         double _p1;
         double _p2;
         double _rho;
         double _alpha;
-        double _gamma;
+        double _gamma = 0.0;
         std::string _type;
         Eigen::Matrix2f _R;
         bool _in_collision;
         std::vector<double> _hyper_normal;
 
         std::array<double, 2> _p_point;
-        double _p_alpha;
+        double _p_alpha = 0.0;
         std::vector<double> _speed;
 
       public:
@@ -62,6 +80,8 @@ namespace ellipse {
         void setInCollision(bool b) { _in_collision = b; };
         void setHyperNormal(std::vector<double> n) { _hyper_normal = n; };
         std::vector<double> getHyperNormal() { return _hyper_normal; };
+        EllipseState getState() const;
+        void setState(const EllipseState &state);
     };
 
 }  // namespace ellipse
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace env_rng {
+    // Same draws as random_numbers::RandomNumberGenerator, but with an accessible generator state, so that a snapshot
+    // can save and restore it without changing the stream of the run it was taken from
+    class Generator {
+      public:
+        explicit Generator(uint32_t seed) : engine_(seed) {}
+
+        double uniformReal(double lower, double upper) { return std::uniform_real_distribution<double>(lower, upper)(engine_); }
+        int uniformInteger(int lower, int upper) { return std::uniform_int_distribution<int>(lower, upper)(engine_); }
+        double gaussian(double mean, double stddev) { return std::normal_distribution<double>(mean, stddev)(engine_); }
+
+        std::string get_state() const {
+            std::ostringstream s;
+            s << engine_;
+            return s.str();
+        }
+        void set_state(const std::string &state) {
+            std::istringstream s(state);
+            s >> engine_;
+            if (!s) {
+                throw std::runtime_error("Invalid rng state");
+            }
+        }
+
+      private:
+        std::mt19937 engine_;
+    };
+}  // namespace env_rng
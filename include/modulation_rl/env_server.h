@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <modulation_rl/dynamic_system_base.h>
+
+// command line configuration shared by the env server executables (modulation_rl_env_server, modulation_rl_socket_server)
+namespace env_server {
+    struct Config {
+        // shm server: name of the channel created by the ShmVecEnv
+        std::string channel;
+        // socket server: "host:port" or "unix:/path" to listen on
+        std::string address;
+        // socket server: number of envs hosted by the process, seeded with seed, seed + 1, ...
+        int num_envs = 1;
+        // socket server: step the envs of a batch on one thread each
+        bool parallel_steps = true;
+        std::string robot = "pr2";
+        uint32_t seed = 0;
+        std::string strategy = "relvelm";
+        double min_goal_dist = 1.0;
+        double max_goal_dist = 5.0;
+        double penalty_scaling = 0.0;
+        double time_step = 0.02;
+        bool perform_collision_check = false;
+        // arguments of every reset()
+        std::string start_pose_distribution = "rnd";
+        std::string gripper_goal_distribution = "rnd";
+        std::string gmm_model_path = "";
+        double success_thres_dist = 0.02;
+        double success_thres_rot = 0.05;
+        double start_pause = 0.0;
+        // episodes that end with done are followed by the background auto reset, step() then returns the terminal obs as well
+        bool auto_reset = false;
+        // if set, env i publishes and calls its services under <ros_namespace>/env_<seed + i> instead of the global names.
+        // move_group's get_planning_scene has to be available (e.g. remapped) there as well
+        std::string ros_namespace = "";
+    };
+
+    // key=value arguments, arguments without '=' (e.g. added by roslaunch) are skipped
+    Config parse_args(int argc, char **argv);
+    // analytical world, with auto reset if configured
+    DynamicSystem_base *make_env(const Config &config, uint32_t seed);
+    std::vector<double> reset(const Config &config, DynamicSystem_base *env);
+}  // namespace env_server
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <tf/tf.h>
+
+#include <modulation_rl/base_gripper_planner.h>
+#include <modulation_rl/ellipse.h>
+#include <modulation_rl/episode_stats.h>
+
+namespace env_snapshot {
+    // Everything step() depends on, so that several action branches can be evaluated from the same state.
+    // Plain values only: copying and restoring are O(state size), the planner is re-planned from the stored goal
+    // (a gmm is only parsed again if a different model is active)
+    struct Snapshot {
+        // episode it was taken in, only used to truncate the logged path points when restoring within the same episode
+        int episode = 0;
+        uint64_t path_size = 0;
+        uint64_t display_trajectory_size = 0;
+        // metrics of the running episode
+        episode_stats::Episode episode_stats;
+
+        std::vector<double> joint_values;
+        tf::Transform base_transform;
+        tf::Transform gripper_transform;
+        tf::Transform rel_gripper_pose;
+        tf::Transform gripper_goal;
+        tf::Transform base_goal;
+        PlannedVelocities planned_gripper_vel;
+        PlannedVelocities planned_base_vel;
+
+        // arguments the planner was created with and its progress
+        std::string gmm_model_path;
+        tf::Transform planner_goal_input;
+        tf::Transform planner_initial_gripper;
+        tf::Transform planner_initial_base;
+        GripperPlan prev_plan;
+        double gmm_time_offset = 0.0;
+
+        double time = 0.0;
+        double time_planner = 0.0;
+        double reset_time = 0.0;
+        double set_goal_time = 0.0;
+        double start_pause = 0.0;
+        double success_thres_dist = 0.0;
+        double success_thres_rot = 0.0;
+        int ik_error_count = 0;
+        // anytime ik strategy of the last cycle
+        int ik_strategy = 0;
+        // textual state of the env rng, restored so that a branch continues the same stream as the run it was taken from
+        std::string rng_state;
+        // modulate_ellipse strategy
+        std::vector<ellipse::EllipseState> ellipses;
+        std::vector<double> ellipse_real_gamma;
+    };
+
+    // binary, host byte order. Throws if the file cannot be written / read or is not a snapshot
+    void save(const Snapshot &snapshot, const std::string &filename);
+    Snapshot load(const std::string &filename);
+}  // namespace env_snapshot
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <map>
+#include <string>
+
+namespace episode_stats {
+    // top-down grid of the gripper position relative to the base, x and y in [-REL_XY_RANGE, REL_XY_RANGE]
+    const int N_XY_BINS = 40;
+    const double REL_XY_RANGE = 1.0;
+    // gripper height relative to the base in [0, Z_MAX]
+    const int N_Z_BINS = 40;
+    const double Z_MAX = 2.0;
+    // kin fails per episode, larger counts go into the last bin
+    const int N_KIN_FAIL_BINS = 64;
+
+    // what the env recorded for one step
+    struct Step {
+        bool ik_fail;
+        bool collision;
+        // distance between the achieved and the planned gripper position
+        double dist_to_sol;
+        // distance gripper and base moved in this step
+        double gripper_dist;
+        double base_dist;
+        // gripper position relative to the base
+        double rel_x;
+        double rel_y;
+        double rel_z;
+    };
+
+    struct Episode {
+        uint64_t steps = 0;
+        uint64_t kin_fails = 0;
+        uint64_t collisions = 0;
+        double gripper_path_length = 0.0;
+        double base_path_length = 0.0;
+        // sums over the steps with / without ik solution
+        double dist_to_sol_success = 0.0;
+        double dist_to_sol_fail = 0.0;
+        double max_dist_to_sol = 0.0;
+        bool success = false;
+        double final_dist_to_goal = 0.0;
+    };
+
+    // Per-episode and cross-episode metrics of one env in fixed memory, so that an evaluation does not have to pull the full
+    // trajectory of every episode. Totals only include episodes that were ended with end_episode(), the histograms every step.
+    class EpisodeStats {
+      private:
+        Episode current_;
+        Episode last_;
+        uint64_t episodes_;
+        uint64_t successes_;
+        uint64_t zero_fail_episodes_;
+        uint64_t collision_free_episodes_;
+        uint64_t steps_;
+        uint64_t kin_fails_;
+        uint64_t collisions_;
+        double gripper_path_length_;
+        double base_path_length_;
+        double final_dist_to_goal_;
+        // sum and count of the per-episode mean distance to the ik solution
+        double dist_to_sol_success_sum_;
+        uint64_t dist_to_sol_success_n_;
+        double dist_to_sol_fail_sum_;
+        uint64_t dist_to_sol_fail_n_;
+        // episodes that ended within 0.1 / 0.05 of the goal and never deviated further than that from the plan
+        uint64_t reached_within_10cm_;
+        uint64_t reached_within_5cm_;
+        std::array<uint64_t, N_KIN_FAIL_BINS> kin_fails_hist_;
+        // row-major [x bin][y bin]
+        std::array<uint64_t, N_XY_BINS * N_XY_BINS> rel_xy_steps_;
+        std::array<uint64_t, N_XY_BINS * N_XY_BINS> rel_xy_fails_;
+        std::array<uint64_t, N_Z_BINS> rel_z_steps_;
+        std::array<uint64_t, N_Z_BINS> rel_z_fails_;
+
+      public:
+        EpisodeStats() { reset(); };
+        // drops the metrics of an episode that was not ended
+        void begin_episode() { current_ = Episode(); };
+        void add_step(const Step &step);
+        void end_episode(bool success, double final_dist_to_goal);
+        // metrics of the running and of the last ended episode
+        std::map<std::string, double> get_current() const { return to_map(current_); };
+        // running episode, e.g. to rewind it to a snapshot
+        const Episode &get_current_episode() const { return current_; };
+        void set_current_episode(const Episode &episode) { current_ = episode; };
+        std::map<std::string, double> get_last() const { return to_map(last_); };
+        static std::map<std::string, double> to_map(const Episode &episode);
+        // totals and means over the ended episodes
+        std::map<std::string, double> get_summary() const;
+        const std::array<uint64_t, N_KIN_FAIL_BINS> &get_kin_fails_hist() const { return kin_fails_hist_; };
+        const std::array<uint64_t, N_XY_BINS * N_XY_BINS> &get_rel_xy_steps() const { return rel_xy_steps_; };
+        const std::array<uint64_t, N_XY_BINS * N_XY_BINS> &get_rel_xy_fails() const { return rel_xy_fails_; };
+        const std::array<uint64_t, N_Z_BINS> &get_rel_z_steps() const { return rel_z_steps_; };
+        const std::array<uint64_t, N_Z_BINS> &get_rel_z_fails() const { return rel_z_fails_; };
+        // values outside the range go into the first / last bin
+        static int bin(double value, double lower, double upper, int n_bins);
+        void reset();
+    };
+}  // namespace episode_stats
@@ -65,8 +65,8 @@ class GaussianMixtureModel {
     double getkP() const { return _kP; };
     double getkV() const { return _kV; };
     std::vector<double> getPriors() const { return _Priors; };
-    std::vector<Eigen::VectorXf> getMu() const { return _MuEigen; };
-    std::vector<Eigen::MatrixXf> getSigma() const { return _Sigma; };
+    const std::vector<Eigen::VectorXf> &getMu() const { return _MuEigen; };
+    const std::vector<Eigen::MatrixXf> &getSigma() const { return _Sigma; };
     tf::StampedTransform getGoalState() const { return _goalState; };
     tf::Transform getStartState() const { return _startState; };
     tf::Transform getGraspPose() const { return _related_object_grasp_pose; };
@@ -103,7 +103,6 @@ class GaussianMixtureModel {
     int _plot_every_xth;
     // geometry_msgs::PoseArray trajectory_pose_array;
 
-    ros::NodeHandle nh_;
     // ros::Publisher Mu_pub_;
     // ros::Publisher Traj_pub_;
     // ros::Publisher Traj_pub2_;
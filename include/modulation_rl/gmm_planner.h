@@ -42,6 +42,13 @@ class GMMPlanner : public BaseGripperPlanner {
                tf::Transform initialBaseTransform,
                std::string gmm_model_path,
                double gmm_base_offset);
+    // start a new plan, reusing this instance. The model file is only parsed again if gmm_model_path changed
+    void reinit(tf::Transform gripperGoal,
+                tf::Transform initialGripperTransform,
+                tf::Transform baseGoal,
+                tf::Transform initialBaseTransform,
+                std::string gmm_model_path,
+                double gmm_base_offset);
 
     GripperPlan get_next_velocities(double time,
                                     double dt,
@@ -55,6 +62,8 @@ class GMMPlanner : public BaseGripperPlanner {
                                     bool update_prev_plan);
     tf::Transform get_last_attractor();
     GripperPlan get_prev_plan();
+    double get_time_offset() const { return gaussian_mixture_model_->gmm_time_offset_; };
+    void set_time_offset(double time_offset) { gaussian_mixture_model_->gmm_time_offset_ = time_offset; };
 
     std::vector<tf::Transform> get_mus();
 };
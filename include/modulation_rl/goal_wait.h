@@ -0,0 +1,24 @@
+#pragma once
+
+#include <actionlib/client/simple_action_client.h>
+#include <ros/ros.h>
+
+namespace goal_wait {
+    // Wait for the goal of client until deadline. Goals that were sent together execute concurrently on their servers, so
+    // waiting for them in turn with one shared deadline ends with the slowest of them instead of adding up per-goal timeouts.
+    // True if the goal succeeded
+    template <typename Client>
+    bool wait_until(Client &client, const ros::Time &deadline, const char *name) {
+        ros::Duration remaining = deadline - ros::Time::now();
+        // waitForResult() without a timeout would wait forever
+        if (remaining > ros::Duration(0.0)) {
+            client.waitForResult(remaining);
+        }
+        actionlib::SimpleClientGoalState state = client.getState();
+        if (state != actionlib::SimpleClientGoalState::SUCCEEDED) {
+            ROS_WARN("The %s goal did not succeed before the deadline: %s", name, state.toString().c_str());
+            return false;
+        }
+        return true;
+    }
+}  // namespace goal_wait
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <map>
+#include <string>
+
+#include <modulation_rl/profiler.h>
+
+namespace ik_stats {
+    // outcome of a single find_ik() call
+    enum IKResult {
+        SUCCESS = 0,
+        // the solver did not return any candidate before the timeout
+        NO_SOLUTION,
+        // the solver found candidates, but the validity callback rejected all of them (collisions)
+        COLLISION,
+        N_RESULTS
+    };
+    const char *result_name(IKResult result);
+
+    // what the anytime ik executed, see anytime_ik::AnytimeIK
+    enum IKStrategy {
+        // setFromIK() found a solution within the budget
+        FULL_SOLVE = 0,
+        // best refined joint values within the acceptable pose error
+        PARTIAL,
+        // holding the current joint values
+        FALLBACK,
+        N_STRATEGIES
+    };
+    const char *strategy_name(IKStrategy strategy);
+
+    // Counters and latency histograms of the IK calls of one env. Always collected, the overhead is two clock reads per call.
+    // The solver iterations of the kinematics plugin are not exposed by setFromIK, so the validity callback invocations
+    // (one per candidate solution) are counted instead.
+    class IKStats {
+      private:
+        uint64_t calls_ = 0;
+        std::array<uint64_t, N_RESULTS> results_;
+        uint64_t validity_checks_ = 0;
+        uint64_t validity_rejections_ = 0;
+        uint64_t max_validity_checks_per_call_ = 0;
+        uint64_t scene_collision_checks_ = 0;
+        uint64_t scene_collisions_ = 0;
+        std::array<uint64_t, N_STRATEGIES> strategies_;
+        // of the call that is currently running
+        uint64_t call_validity_checks_ = 0;
+        uint64_t call_validity_rejections_ = 0;
+        profiler::Clock::time_point call_start_;
+        // time until a solution was found and until the solver gave up
+        profiler::Histogram time_to_solution_;
+        profiler::Histogram time_to_failure_;
+        // pose error [m] of the executed partial solutions
+        profiler::Histogram partial_pos_error_;
+
+      public:
+        IKStats() { reset(); };
+        void begin_call();
+        void add_validity_check(bool valid);
+        IKResult end_call(bool success);
+        void add_scene_collision_check(bool in_collision);
+        void add_strategy(IKStrategy strategy, double pos_error);
+        uint64_t get_strategy_count(IKStrategy strategy) const { return strategies_[strategy]; };
+        uint64_t get_result_count(IKResult result) const { return results_[result]; };
+        const profiler::Histogram &get_time_to_solution() const { return time_to_solution_; };
+        const profiler::Histogram &get_time_to_failure() const { return time_to_failure_; };
+        const profiler::Histogram &get_partial_pos_error() const { return partial_pos_error_; };
+        // counters, failure counts per reason and summary statistics of the latencies [s]
+        std::map<std::string, double> get_summary() const;
+        void reset();
+    };
+}  // namespace ik_stats
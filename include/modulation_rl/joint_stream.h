@@ -0,0 +1,30 @@
+#pragma once
+
+#include <trajectory_msgs/JointTrajectory.h>
+#include <string>
+#include <vector>
+
+namespace joint_stream {
+    // Builds the JointTrajectory messages that are streamed to a controller's command topic every control cycle instead of
+    // sending one-point actionlib goals. The first point is the ik solution of the cycle, followed by lookahead points
+    // extrapolated with the joint velocities of the last two cycles so that the controller can spline through them. Each
+    // message replaces the remainder of the previous one. The message is allocated once and reused.
+    class TrajectoryStreamer {
+      private:
+        trajectory_msgs::JointTrajectory traj_;
+        std::vector<double> prev_target_;
+        bool has_prev_ = false;
+
+      public:
+        void init(const std::vector<std::string> &joint_names, int n_lookahead);
+        // restart from zero velocity, e.g. at the start of an episode
+        void reset() { has_prev_ = false; };
+        int get_n_lookahead() const { return traj_.points.size() - 1; };
+        const trajectory_msgs::JointTrajectory &get_trajectory() const { return traj_; };
+        // target reached exec_duration [s] after the message is received, the lookahead points follow every cycle_time [s]
+        const trajectory_msgs::JointTrajectory &update(const std::vector<double> &target, double exec_duration, double cycle_time);
+    };
+
+    // the joints with the given indices of a streamed trajectory, e.g. to split it into the torso and the arm controller
+    void select_joints(const trajectory_msgs::JointTrajectory &traj, const std::vector<int> &indices, trajectory_msgs::JointTrajectory &out);
+}  // namespace joint_stream
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer single-consumer slot that always hands the reader the newest published value (triple buffer).
+// The writer fills back() and publishes it, the reader picks up the newest value with update() and reads front(). Neither
+// side ever waits for the other and values that were overwritten before being read are skipped.
+template <typename T>
+class LatestValue {
+  private:
+    static const uint8_t INDEX_MASK = 3;
+    static const uint8_t FRESH = 4;
+    T slots_[3];
+    // slot last published by the writer, with FRESH set until the reader picked it up
+    std::atomic<uint8_t> latest_{1};
+    // only touched by the writer / reader
+    uint8_t back_ = 0;
+    uint8_t front_ = 2;
+
+  public:
+    // writer
+    T &back() { return slots_[back_]; };
+    void publish() { back_ = latest_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX_MASK; };
+    void write(const T &value) {
+        back() = value;
+        publish();
+    };
+
+    // reader. Returns true if a value was published since the last update()
+    bool update() {
+        if (!(latest_.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front_ = latest_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    };
+    const T &front() const { return slots_[front_]; };
+    // the newest value, returns whether it was not read before
+    bool read(T &value) {
+        bool fresh = update();
+        value = front();
+        return fresh;
+    };
+
+    // all three slots, only while neither side is active, e.g. to preallocate buffers
+    template <typename F>
+    void for_each_slot(F f) {
+        for (T &slot : slots_) {
+            f(slot);
+        }
+    };
+};
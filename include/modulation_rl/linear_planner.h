@@ -34,6 +34,8 @@ class LinearPlanner : public BaseGripperPlanner {
                   tf::Transform initialGripperTransform,
                   tf::Transform baseGoal,
                   tf::Transform initialBaseTransform);
+    // start a new plan, reusing this instance
+    void reinit(tf::Transform gripperGoal, tf::Transform initialGripperTransform, tf::Transform baseGoal, tf::Transform initialBaseTransform);
 
     GripperPlan get_next_velocities(double time,
                                     double dt,
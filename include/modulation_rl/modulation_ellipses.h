@@ -30,6 +30,14 @@
 
 namespace modulation_ellipses {
 
+    // IRM modulation field evaluated for a batch of base poses and a fixed gripper pose. One row per base pose, one column per ellipse
+    struct FieldEvaluation {
+        Eigen::MatrixXd gamma;
+        Eigen::MatrixXd weights;
+        // modulated base velocity: [x, y, rotation] (entries 7, 8 and 12 of the full speed vector)
+        Eigen::MatrixXd modulated_speed;
+    };
+
     class Modulation {
       private:
         std::vector<ellipse::Ellipse> ellipses_;
@@ -46,6 +54,8 @@ namespace modulation_ellipses {
         double gamma_alpha_;
         std::vector<std::vector<double>> xi_wave_;
 
+        void updateEllipsesFromGripper(Eigen::VectorXf &curr_speed, Eigen::VectorXd &curr_gripper_pose);
+        static double computeGripperPitch(const Eigen::Quaterniond &Q);
         void computeXiWave();
         void computeGamma();
         void computeGammaAlpha(int ellipseNr);
@@ -104,8 +114,13 @@ namespace modulation_ellipses {
 
         Eigen::VectorXf compModulation();
         void run(Eigen::VectorXf &curr_pose, Eigen::VectorXf &curr_speed);
+        FieldEvaluation evaluateField(const Eigen::VectorXf &gripper_pose, const Eigen::VectorXf &curr_speed, const Eigen::MatrixXd &base_xy, const Eigen::VectorXd &base_yaw);
 
         visualization_msgs::MarkerArray getEllipsesVisMarker(Eigen::VectorXf &curr_pose, Eigen::VectorXf &curr_speed);
+
+        // state carried from one run() to the next: the ellipses and the gamma values of the first run
+        void getState(std::vector<ellipse::EllipseState> &ellipses, std::vector<double> &real_gamma) const;
+        void setState(const std::vector<ellipse::EllipseState> &ellipses, const std::vector<double> &real_gamma);
     };
 
 }  // namespace modulation_ellipses
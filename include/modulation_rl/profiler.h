@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace profiler {
+    // phases of DynamicSystem_base::step() and reset() that are timed
+    enum Phase {
+        STEP = 0,
+        PLANNER,
+        BASE_TRANSFORM,
+        MODULATION,
+        IK,
+        FK,
+        EXECUTION,
+        VISUALIZATION,
+        TRAJECTORY,
+        OBS,
+        RESET,
+        START_POSE,
+        SET_GOAL,
+        GMM_LOAD,
+        ACTION_REPEAT,
+        COLLISION_CHECK,
+        N_PHASES
+    };
+    const char *phase_name(Phase phase);
+
+    typedef std::chrono::steady_clock Clock;
+
+    // log2-spaced histogram of durations: bucket i counts durations in [2^i, 2^(i+1)) microseconds, bucket 0 everything below 2us
+    class Histogram {
+      public:
+        static const int N_BUCKETS = 24;
+        Histogram() { reset(); };
+        void add(double seconds);
+        void reset();
+        // approximated from the buckets (upper bucket edge), in seconds
+        double percentile(double p) const;
+
+        uint64_t count;
+        double total;
+        double min;
+        double max;
+        std::array<uint64_t, N_BUCKETS> buckets;
+    };
+
+    struct TraceEvent {
+        Phase phase;
+        int64_t start_ns;
+        int64_t dur_ns;
+    };
+
+    // Fixed size ring buffer with a single writer (the thread owning it). Once full, the oldest events are overwritten
+    class TraceRing {
+      private:
+        std::vector<TraceEvent> events_;
+        std::atomic<uint64_t> head_;
+
+      public:
+        TraceRing(size_t capacity, int tid) : events_(capacity), head_(0), tid(tid){};
+        void push(const TraceEvent &event) {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            events_[head % events_.size()] = event;
+            head_.store(head + 1, std::memory_order_release);
+        };
+        // events in chronological order
+        std::vector<TraceEvent> snapshot() const;
+        void clear() { head_.store(0, std::memory_order_release); };
+        const int tid;
+    };
+
+    // Flight recorder of phase begin/end events. Each thread writes into its own ring, so recording needs no locks;
+    // the mutex is only taken the first time a thread records and when dumping.
+    class TraceRecorder {
+      private:
+        const uint64_t id_;
+        size_t capacity_;
+        std::mutex rings_mutex_;
+        std::vector<std::unique_ptr<TraceRing>> rings_;
+        TraceRing &local_ring();
+
+      public:
+        explicit TraceRecorder(size_t capacity = 1 << 16);
+        void set_capacity(size_t capacity) { capacity_ = capacity; };
+        void record(Phase phase, Clock::time_point start, Clock::time_point end);
+        // write all buffered events as chrome trace json (chrome://tracing, ui.perfetto.dev). Best called while the env is idle, e.g. between episodes
+        void dump_chrome_trace(const std::string &filename);
+        void clear();
+    };
+
+    // Aggregates the phase durations of one env and optionally records them into a trace. Both are disabled by default,
+    // in which case the ScopedTimers cost a single branch.
+    // The histograms are not thread safe: each env is only stepped from one thread at a time.
+    class Profiler {
+      private:
+        bool enabled_ = false;
+        bool tracing_ = false;
+        std::array<Histogram, N_PHASES> histograms_;
+        TraceRecorder tracer_;
+
+      public:
+        void set_enabled(bool enabled) { enabled_ = enabled; };
+        bool is_enabled() const { return enabled_; };
+        void set_tracing(bool tracing) { tracing_ = tracing; };
+        bool is_tracing() const { return tracing_; };
+        void record(Phase phase, double seconds) { histograms_[phase].add(seconds); };
+        const Histogram &get_histogram(Phase phase) const { return histograms_[phase]; };
+        // summary per phase that has been hit at least once: count, total, mean, min, max, p50, p95, p99 [s]
+        std::map<std::string, std::map<std::string, double>> get_summary() const;
+        void reset();
+        TraceRecorder &get_tracer() { return tracer_; };
+    };
+
+    class ScopedTimer {
+      private:
+        Profiler &profiler_;
+        const Phase phase_;
+        const bool timed_;
+        const bool traced_;
+        Clock::time_point start_;
+
+      public:
+        // active=false disables the timer, for phases that only apply to some calls
+        ScopedTimer(Profiler &profiler, Phase phase, bool active = true) :
+            profiler_(profiler),
+            phase_(phase),
+            timed_(active && profiler.is_enabled()),
+            traced_(active && profiler.is_tracing()) {
+            if (timed_ || traced_) {
+                start_ = Clock::now();
+            }
+        };
+        ~ScopedTimer() {
+            if (timed_ || traced_) {
+                Clock::time_point end = Clock::now();
+                if (timed_) {
+                    profiler_.record(phase_, std::chrono::duration<double>(end - start_).count());
+                }
+                if (traced_) {
+                    profiler_.get_tracer().record(phase_, start_, end);
+                }
+            }
+        };
+    };
+}  // namespace profiler
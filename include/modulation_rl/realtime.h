@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+// Process and thread setup for running the control loop under real-time constraints. All functions throw on failure,
+// typically because the user lacks the rtprio / memlock limits (see /etc/security/limits.conf).
+namespace realtime {
+    // lock all current and future pages into RAM and keep freed heap memory in the process, so that allocations after
+    // the warm-up neither page fault nor go back to the kernel
+    void lock_memory();
+    // undo lock_memory(): unlock the pages and restore the glibc defaults for heap trimming and mmaps of large blocks
+    void unlock_memory();
+    // touch the given amount of stack of the calling thread so that it is mapped before the loop starts
+    void prefault_stack(size_t bytes = 256 * 1024);
+    // priority > 0: SCHED_FIFO with this priority (1-99). cpu >= 0: pin the calling thread to this cpu
+    void configure_current_thread(int priority, int cpu);
+
+    // Marks a part of a real-time control cycle that is allowed to allocate, e.g. the ik solvers and the planners that are
+    // not under our control. Only bookkeeping for the calling thread, read by the allocation checks in the tests. Nests
+    class AllocationExempt {
+      private:
+        static int &depth() {
+            static thread_local int depth = 0;
+            return depth;
+        };
+
+      public:
+        AllocationExempt() { depth()++; };
+        ~AllocationExempt() { depth()--; };
+        AllocationExempt(const AllocationExempt &) = delete;
+        AllocationExempt &operator=(const AllocationExempt &) = delete;
+        static bool active() { return depth() > 0; };
+    };
+}  // namespace realtime
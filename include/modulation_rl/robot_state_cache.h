@@ -0,0 +1,72 @@
+#pragma once
+
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit_msgs/CollisionObject.h>
+#include <moveit_msgs/PlanningScene.h>
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <modulation_rl/latest_value.h>
+
+namespace robot_state_cache {
+    // Newest joint positions and scene collision objects, maintained from the joint_states and planning scene topics instead of
+    // calling get_planning_scene whenever the env needs the actual robot state. The callbacks write into lock-free latest-value
+    // slots, so reads are a copy of a few doubles and never block on the network. One reader thread at a time.
+    class RobotStateCache {
+      private:
+        struct JointSnapshot {
+            std::vector<double> positions;
+            ros::Time stamp;
+        };
+        struct WorldSnapshot {
+            std::vector<moveit_msgs::CollisionObject> objects;
+            uint64_t version = 0;
+        };
+        std::vector<std::string> joint_names_;
+        ros::Subscriber joint_states_sub_;
+        ros::Subscriber scene_sub_;
+        LatestValue<JointSnapshot> joints_;
+        LatestValue<WorldSnapshot> world_;
+
+        // only touched by the joint_states callback: message layout -> index into joint_names_ (-1 for other joints),
+        // rebuilt when the layout changes. Joints can be spread over several messages, so positions are accumulated
+        std::vector<std::string> msg_names_;
+        std::vector<int> msg_index_;
+        std::vector<double> positions_;
+        std::vector<bool> received_;
+        int n_received_ = 0;
+        // only touched by the planning scene callback
+        std::map<std::string, moveit_msgs::CollisionObject> objects_;
+        uint64_t world_version_ = 0;
+        // only touched by the reader
+        uint64_t applied_world_version_ = 0;
+        // time of the last command that still waits for feedback (0: none) and the measured delay (< 0: none new)
+        std::atomic<double> command_time_{0.0};
+        std::atomic<double> feedback_sample_delay_{-1.0};
+
+        void joint_states_callback(const sensor_msgs::JointState::ConstPtr &msg);
+        void scene_callback(const moveit_msgs::PlanningScene::ConstPtr &msg);
+
+      public:
+        // known_objects: the collision objects from get_planning_scene, the scene topic only sends diffs to late subscribers
+        RobotStateCache(ros::NodeHandle &nh,
+                        const std::vector<std::string> &joint_names,
+                        const std::string &joint_states_topic,
+                        const std::string &scene_topic,
+                        const std::vector<moveit_msgs::CollisionObject> &known_objects);
+        // newest positions in the order of joint_names. False until every joint was received at least once
+        bool get_joint_values(std::vector<double> &values);
+        ros::Time get_joint_stamp() const { return joints_.front().stamp; };
+        // replace the collision objects of the scene if they changed since the last call. Returns whether it did
+        bool update_world(planning_scene::PlanningScenePtr scene);
+        // feedback sample delay: from a command sent at time [s] until the first joint_states stamped after it. This is when the
+        // next state sample was taken, not when the command took effect
+        void mark_command(double time) { command_time_.store(time, std::memory_order_release); };
+        // true once the delay of the last marked command was measured, only returns each measurement once
+        bool take_feedback_sample_delay(double &delay);
+    };
+}  // namespace robot_state_cache
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Shared-memory request/response channel between a learner and one env server process (modulation_rl_env_server).
+// Each direction is a single-producer single-consumer ring of fixed size slots holding raw doubles, waiting is done with
+// futexes on the ring counters, so nothing is serialized and an idle side does not spin.
+namespace shm_channel {
+    enum Command : uint32_t {
+        // request: payload = base actions, int_arg = max_allow_ik_errors, noise_ee / noise_base set
+        // response: payload = step() return value
+        STEP = 0,
+        // request: no payload. response: payload = first obs
+        RESET,
+        // request: server exits after responding without payload
+        CLOSE,
+        // response: the command threw, payload = message as chars (one per double)
+        ERROR
+    };
+
+    struct MessageHeader {
+        uint32_t command;
+        int32_t int_arg;
+        double noise_ee;
+        double noise_base;
+        // number of doubles in the payload
+        uint32_t size;
+    };
+
+    struct RingHeader {
+        // total number of pushed / popped messages, also the futex words
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+    };
+
+    // view of a ring inside the mapped segment
+    class Ring {
+      private:
+        RingHeader *header_;
+        char *slots_;
+        uint32_t n_slots_;
+        uint32_t slot_capacity_;
+        // the process on the other end, waits fail once it is gone. 0: not connected yet
+        const std::atomic<int32_t> *peer_pid_;
+        size_t slot_bytes() const { return sizeof(MessageHeader) + slot_capacity_ * sizeof(double); };
+        void wait_while_equal(const std::atomic<uint32_t> &word, uint32_t value);
+
+      public:
+        Ring() : header_{NULL}, slots_{NULL}, n_slots_{0}, slot_capacity_{0}, peer_pid_{NULL} {};
+        Ring(RingHeader *header, char *slots, uint32_t n_slots, uint32_t slot_capacity, const std::atomic<int32_t> *peer_pid);
+        static size_t bytes(uint32_t n_slots, uint32_t slot_capacity);
+        // blocks while the ring is full
+        void push(const MessageHeader &header, const double *payload);
+        // blocks while the ring is empty. Copies at most capacity doubles of the payload to out
+        MessageHeader pop(double *out, uint32_t capacity);
+        uint32_t get_slot_capacity() const { return slot_capacity_; };
+    };
+
+    class Channel {
+      private:
+        std::string name_;
+        bool owner_;
+        void *memory_;
+        size_t bytes_;
+        Ring requests_;
+        Ring responses_;
+        Channel(const std::string &name, bool owner, void *memory, size_t bytes);
+
+      public:
+        // learner side: creates the segment /name (replacing a stale one), unlinked again by the destructor
+        static Channel *create(const std::string &name, uint32_t n_slots, uint32_t slot_capacity);
+        // server side: maps an existing segment and registers this process as the server
+        static Channel *open(const std::string &name);
+        ~Channel();
+        // blocks until a server opened the channel, false on timeout
+        bool wait_for_server(double timeout);
+        Ring &requests() { return requests_; };
+        Ring &responses() { return responses_; };
+        std::string get_name() const { return name_; };
+    };
+}  // namespace shm_channel
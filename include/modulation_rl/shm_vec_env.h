@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <modulation_rl/shm_channel.h>
+
+// Learner side of the shm env servers: drives one modulation_rl_env_server process per channel with a single batched call.
+// Requests are sent to all servers before waiting for the first response, so the envs step in parallel
+class ShmVecEnv {
+  private:
+    std::vector<shm_channel::Channel *> channels_;
+    // known after the first reset()
+    int obs_dim_ = -1;
+    bool step_pending_ = false;
+    std::vector<double> buffer_;
+    // one response per server in envs. Throws only after all of them were received, so no reply is left in a ring
+    void collect(shm_channel::Command command, const std::vector<int> &envs, Eigen::MatrixXd &result);
+    std::vector<int> all_envs() const;
+
+  public:
+    ShmVecEnv(std::vector<std::string> channel_names, uint32_t n_slots, uint32_t slot_capacity);
+    ~ShmVecEnv();
+    bool wait_for_servers(double timeout);
+    int get_num_envs() const { return channels_.size(); };
+    int get_obs_dim() const { return obs_dim_; };
+    // reset() of the envs selected by mask (all if empty) with the reset arguments the servers were started with.
+    // Returns num_envs x obs_dim, rows of envs that were not reset are NaN
+    Eigen::MatrixXd reset(const std::vector<bool> &mask = std::vector<bool>());
+    // one row of base actions per env
+    void step_async(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base);
+    // num_envs x (2 * obs_dim + 3): [obs, reward, done, ik fails, terminal obs]. The terminal obs is NaN unless the server auto reset
+    Eigen::MatrixXd step_wait();
+    Eigen::MatrixXd step(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base);
+    // stops the servers
+    void close();
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace sim_clock {
+    // Advances a paused simulation by fixed time steps: unpauses the physics, waits until the clock topic passed the target
+    // time and pauses again. Works with gazebo and with any stand-in that offers the two Empty services and publishes the
+    // clock while unpaused.
+    class LockstepClock {
+      private:
+        ros::Subscriber clock_sub_;
+        ros::ServiceClient pause_client_;
+        ros::ServiceClient unpause_client_;
+        std::mutex mutex_;
+        std::condition_variable clock_cv_;
+        // newest clock [s], < 0 before the first message
+        double now_ = -1.0;
+
+        void clock_callback(const rosgraph_msgs::Clock::ConstPtr &msg);
+        void call(ros::ServiceClient &client);
+
+      public:
+        LockstepClock(ros::NodeHandle &nh, const std::string &clock_topic, const std::string &pause_service, const std::string &unpause_service);
+        double now();
+        // false if the clock did not reach time within timeout [s, wall time]
+        bool wait_until(double time, double timeout);
+        // run the simulation for dt [s] and pause it again. Returns the simulated time that actually passed. The overshoot
+        // over dt is bounded by one clock period plus the simulated time until the pause call arrives: about the real-time
+        // factor times the clock delivery and the pause service round trip. Throws if the clock does not advance
+        double advance(double dt, double timeout = 5.0);
+        void pause() { call(pause_client_); };
+        void unpause() { call(unpause_client_); };
+    };
+}  // namespace sim_clock
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Binary request/response protocol between a SocketVecEnv and modulation_rl_socket_server over tcp or unix sockets.
+// Every frame is a fixed header followed by rows x cols doubles in host byte order (the magic rejects peers with another one).
+// A client may send several requests before reading the responses, they are answered in order and carry the request id.
+namespace socket_protocol {
+    enum Command : uint32_t {
+        // response: 1 x 2 [num_envs, obs_dim]
+        INFO = 0,
+        // request: no payload to reset all envs, or num_envs x 1 mask (non-zero: reset the env)
+        // response: num_envs x obs_dim, NaN rows for envs that were not reset
+        RESET,
+        // request: num_envs x n_actions, int_arg = max_allow_ik_errors, noise_ee / noise_base set
+        // response: num_envs x (2 * obs_dim + 3) [obs, reward, done, ik fails, terminal obs (NaN unless auto reset)]
+        STEP,
+        // response: num_envs x 0, the server exits afterwards
+        CLOSE,
+        // response: the request failed, 1 x n message chars
+        ERROR
+    };
+
+    struct FrameHeader {
+        uint32_t magic;
+        uint32_t command;
+        uint32_t request_id;
+        int32_t int_arg;
+        double noise_ee;
+        double noise_base;
+        uint32_t rows;
+        uint32_t cols;
+    };
+    FrameHeader make_header(Command command, uint32_t request_id, uint32_t rows, uint32_t cols);
+
+    // address: "host:port" for tcp, "unix:/path" for a unix socket
+    int listen_on(const std::string &address);
+    int accept_connection(int listen_fd);
+    // retries until the server is up or the timeout [s] passed
+    int connect_to(const std::string &address, double timeout);
+
+    // throw on errors and closed connections
+    void send_frame(int fd, const FrameHeader &header, const double *data);
+    FrameHeader recv_frame(int fd, std::vector<double> &data);
+    void send_error(int fd, uint32_t request_id, const std::string &message);
+    std::string error_message(const std::vector<double> &data);
+}  // namespace socket_protocol
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <modulation_rl/socket_protocol.h>
+
+// Aggregates the envs of several modulation_rl_socket_server processes (possibly on other hosts) into one vector env.
+// Rows of the batched actions / results are ordered by server, then by the env within the server.
+// step_async() may be called several times before step_wait(): the batches are pipelined and returned in order
+class SocketVecEnv {
+  private:
+    struct Server {
+        std::string address;
+        // -1 once closed after a protocol error
+        int fd;
+        int num_envs;
+        // row of its first env in the batch
+        int first_env;
+    };
+    std::vector<Server> servers_;
+    int num_envs_ = 0;
+    int obs_dim_ = -1;
+    uint32_t next_request_id_ = 0;
+    // ids of the step batches sent but not received yet, oldest first
+    std::deque<uint32_t> in_flight_;
+    std::vector<double> buffer_;
+    // throws if a connection was closed, checked before sending so that no server is left a request ahead of the others
+    void check_connections() const;
+    void disconnect(Server &server);
+    // request without payload to every server
+    uint32_t send_all(socket_protocol::Command command);
+    // one response per server into its rows of result. Throws only after all of them were received
+    void receive_all(socket_protocol::Command command, uint32_t request_id, Eigen::MatrixXd &result);
+
+  public:
+    SocketVecEnv(std::vector<std::string> addresses, double connect_timeout);
+    ~SocketVecEnv();
+    int get_num_envs() const { return num_envs_; };
+    int get_obs_dim() const { return obs_dim_; };
+    int get_num_in_flight() const { return in_flight_.size(); };
+    // reset() of the envs selected by mask (all if empty) with the reset arguments the servers were started with.
+    // Returns num_envs x obs_dim, rows of envs that were not reset are NaN
+    Eigen::MatrixXd reset(const std::vector<bool> &mask = std::vector<bool>());
+    // one row of base actions per env
+    void step_async(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base);
+    // result of the oldest pending step_async(): num_envs x (2 * obs_dim + 3) [obs, reward, done, ik fails, terminal obs (NaN unless auto reset)]
+    Eigen::MatrixXd step_wait();
+    Eigen::MatrixXd step(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base);
+    // stops the servers
+    void close();
+};
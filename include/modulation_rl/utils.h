@@ -29,6 +29,8 @@ struct RoboConf {
     const std::vector<std::string> neutral_pos_joint_names;
     const std::vector<double> neutral_pos_values;
     const std::string base_cmd_topic;
+    // odometry of the base, feeds the cached base pose in gazebo / real execution
+    const std::string odom_topic;
     const double base_vel_rng;
     const double base_rot_rng;
     const double z_min;
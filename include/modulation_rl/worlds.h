@@ -13,16 +13,23 @@
 #include <Eigen/Geometry>
 #include "tf/transform_datatypes.h"
 
+#include <modulation_rl/base_pose.h>
 #include <modulation_rl/utils.h>
 
 class BaseWorld {
   public:
     BaseWorld(std::string name,
               // for worlds that do not include full simulation of controllers, continuous time, etc.
-              bool is_analytical);
+              bool is_analytical,
+              // odometry topic relative to nh for the cached base pose, NULL / empty: look up tf on every call
+              ros::NodeHandle *nh = NULL,
+              std::string odom_topic = "");
+    virtual ~BaseWorld() { delete base_pose_; };
     const std::string name_;
     const bool is_analytical_;
     tf::TransformListener listener_;
+    base_pose::BasePoseProvider *base_pose_ = NULL;
+    // newest base pose in the map frame, extrapolated to now if it comes from odometry
     tf::Transform get_base_transform_world();
     virtual void set_model_state(std::string model_name, tf::Transform world_transform, RoboConf robo_config, ros::Publisher &cmd_base_vel_pub) = 0;
 
@@ -38,13 +45,13 @@ class GazeboWorld : public BaseWorld {
     //    ros::ServiceClient pause_gazebo_client_;
     //    ros::ServiceClient unpause_gazebo_client_;
   public:
-    GazeboWorld();
+    GazeboWorld(ros::NodeHandle *nh = NULL, std::string odom_topic = "");
     void set_model_state(std::string model_name, tf::Transform world_transform, RoboConf robo_config, ros::Publisher &cmd_base_vel_pub);
 };
 
 class RealWorld : public BaseWorld {
   public:
-    RealWorld();
+    RealWorld(ros::NodeHandle *nh = NULL, std::string odom_topic = "");
     void set_model_state(std::string model_name, tf::Transform world_transform, RoboConf robo_config, ros::Publisher &cmd_base_vel_pub);
     bool is_within_world(tf::Transform base_transform);
 };
@@ -5,7 +5,7 @@ import numpy as np
 import torch
 from gym import spaces, Env
 
-from dynamic_system_py import PR2Env, TiagoEnv #, HSREnv
+from dynamic_system_py import PR2Env, TiagoEnv, EnvSnapshot #, HSREnv
 
 
 class ActionRanges:
@@ -84,6 +84,8 @@ class ModulationEnv(Env):
                  max_goal_dist: float = 5,
                  stack_k_obs: int = 1,
                  perform_collision_check: bool = False,
+                 node_name: str = '',
+                 ros_namespace: str = '',
                  hsr_ik_slack_dist=None,
                  hsr_ik_slack_rot_dist: float = None,
                  hsr_sol_dist_reward: bool = None):
@@ -95,6 +97,8 @@ class ModulationEnv(Env):
             penalty_scaling: how much to weight the penalty for large action modulations in the reward
             min_actions: lower bound constraints for actions
             max_actions: upper bound constraints for actions
+            node_name: name of the ros node, '' (default) for an anonymous node, so that several env processes do not replace each other's node. Ignored if the process already initialised one
+            ros_namespace: namespace for the env's topics, services and controllers, so that several envs can share one roscore
         """
         assert 0 < min_goal_dist < max_goal_dist
         args = [seed,
@@ -109,9 +113,9 @@ class ModulationEnv(Env):
                 perform_collision_check
                 ]
         if env == 'pr2':
-            self._env = PR2Env(*args)
+            self._env = PR2Env(*args, node_name, ros_namespace)
         elif env == 'tiago':
-            self._env = TiagoEnv(*args)
+            self._env = TiagoEnv(*args, node_name, ros_namespace)
         elif env == 'hsr':
             self._env = HSREnv(*args, hsr_ik_slack_dist, hsr_ik_slack_rot_dist, hsr_sol_dist_reward)
         else:
@@ -280,23 +284,83 @@ class ModulationEnv(Env):
             done_return (int): whether the episode terminated, see cls.DoneReturnCode
             nr_kin_failure (int): cumulative number of kinetic failures in this episode
         """
+        retval = self._env.step(*self._step_args(action, eval))
+        return self._process_step_output(retval)
+
+    def step_async(self, action, eval=False):
+        """Start step() on a background thread and return immediately. Nothing else may be called on this env until step_wait()."""
+        self._env.step_async(*self._step_args(action, eval))
+
+    def step_wait(self):
+        """Wait for the step started by step_async(). Returns the same as step(). Releases the GIL while waiting."""
+        return self._process_step_output(self._env.step_wait())
+
+    def _step_args(self, action, eval):
         if eval:
             transition_noise_ee, transition_noise_base, thres = 0, 0, self._ik_fail_thresh_eval
         else:
             transition_noise_ee, transition_noise_base, thres = self._transition_noise_ee, self._transition_noise_base, self._ik_fail_thresh
 
         base_actions = self._convert_policy_to_env_actions(action)
-        retval = self._env.step(thres, base_actions, transition_noise_ee, transition_noise_base)
+        return thres, base_actions, transition_noise_ee, transition_noise_base
+
+    def _process_step_output(self, retval):
         obs, reward, done_return, nr_kin_failures = self._parse_env_output(retval)
 
+        info = {'nr_kin_failures': nr_kin_failures}
+        if len(retval) > self.state_dim + 3:
+            # auto reset: obs is already the first obs of the next episode, the last one of this episode is appended
+            self._last_k_obs.appendleft(np.array(retval[self.state_dim + 3:]))
+            info['terminal_observation'] = self._stack_obs(self._last_k_obs)
+            for _ in range(len(self._last_k_obs)):
+                self._last_k_obs.appendleft(np.zeros(self.state_dim))
+
         # use unnormalised obs to have them for the replay buffer (see last_orig_obs())
         self._last_k_obs.appendleft(obs)
         stacked_obs = self._stack_obs(self._last_k_obs)
 
-        info = {'nr_kin_failures': nr_kin_failures}
-
         return stacked_obs, reward, done_return, info
 
+    def rollout(self, k: int, actions=None, eval=False):
+        """
+        Take up to k steps in the environment within a single call, stopping once done.
+        Args:
+            k: maximum number of steps
+            actions: array of shape [k, self.action_dim] with values in range [-1, 1] or None for zero actions
+                     (the baseline for the unmodulated and modulate_ellipse strategies, which ignore the actions)
+            eval: whether to use the ik_fail_thresh or ik_fail_thresh_eval
+
+        Returns:
+            obs: array of shape [n, self.state_dim] (unstacked), last row is the terminal obs if done
+            rewards: array of length n
+            dones: array of length n
+            nr_kin_failures: array of length n
+        With auto reset the env already is in the next episode if the last step is done, the frame stack (see last_orig_obs()) then
+        holds its first obs.
+        """
+        if eval:
+            transition_noise_ee, transition_noise_base, thres = 0, 0, self._ik_fail_thresh_eval
+        else:
+            transition_noise_ee, transition_noise_base, thres = self._transition_noise_ee, self._transition_noise_base, self._ik_fail_thresh
+
+        if actions is None:
+            base_actions = np.zeros([0, 0])
+        else:
+            assert len(actions) >= k, "need one action per step"
+            base_actions = np.array([self._convert_policy_to_env_actions(a) for a in actions[:k]], dtype=np.float64)
+        retval, next_episode_obs = self._env.rollout(k, thres, base_actions, transition_noise_ee, transition_noise_base)
+        obs = retval[:, :self.state_dim]
+        rewards, dones, nr_kin_failures = retval[:, self.state_dim], retval[:, self.state_dim + 1], retval[:, self.state_dim + 2]
+
+        # keep the frame stack consistent with step()
+        for o in obs:
+            self._last_k_obs.appendleft(o)
+        if next_episode_obs:
+            for _ in range(len(self._last_k_obs) - 1):
+                self._last_k_obs.appendleft(np.zeros(self.state_dim))
+            self._last_k_obs.appendleft(np.array(next_episode_obs))
+        return obs, rewards, dones, nr_kin_failures
+
     def visualize(self, logdir: str = "", logfile: str = "") -> list:
         if logfile:
             os.makedirs(logdir, exist_ok=True)
@@ -385,6 +449,129 @@ class ModulationEnv(Env):
     def get_slow_down_factor(self):
         return self._env.get_slow_down_factor()
 
+    def set_profiling(self, enabled: bool):
+        """Switch the per-phase timers of the C++ step() and reset() on or off"""
+        self._env.set_profiling(enabled)
+
+    def get_profile(self) -> dict:
+        """Per-phase timings in seconds: {phase: {count, total, mean, min, max, p50, p95, p99, histogram}, bucket_edges: [...]}"""
+        return self._env.get_profile()
+
+    def reset_profile(self):
+        self._env.reset_profile()
+
+    def set_tracing(self, enabled: bool, dump_dir: str = ""):
+        """Record a trace of the step phases. If dump_dir is set, a chrome trace is written there at the end of each episode"""
+        if dump_dir:
+            os.makedirs(dump_dir, exist_ok=True)
+        self._env.set_tracing(enabled, dump_dir)
+
+    def dump_trace(self, filename: str):
+        """Write the recorded trace as chrome trace json (open in ui.perfetto.dev) and clear it"""
+        self._env.dump_trace(filename)
+
+    def get_ik_stats(self) -> dict:
+        """IK calls, failures by reason (no_solution / collision), validity checks and time to solution / failure [s]. With the
+        anytime ik also the strategy counts (strategy_full_solve / _partial / _fallback) and the pose error of partial solutions [m]"""
+        return self._env.get_ik_stats()
+
+    def reset_ik_stats(self):
+        self._env.reset_ik_stats()
+
+    def get_episode_stats(self) -> dict:
+        """Success, kin fails, collisions, path lengths and distances to the ik solutions of the last and the running episode and
+        aggregated over all ended episodes, plus histograms of the ik failures by relative gripper position"""
+        return self._env.get_episode_stats()
+
+    def reset_episode_stats(self):
+        self._env.reset_episode_stats()
+
+    def get_control_timing(self) -> dict:
+        """Cycle time, jitter, send duration and feedback sample delay [s] of the control loop in gazebo / real execution,
+        with deadline misses and the newest cycles as rows of 'cycles' (columns in 'cycle_columns')"""
+        return self._env.get_control_timing()
+
+    def reset_control_timing(self):
+        self._env.reset_control_timing()
+
+    def set_auto_reset(self,
+                       enabled: bool,
+                       start_pose_distribution: str = "rnd",
+                       gripper_goal_distribution: str = "rnd",
+                       success_thres_dist: float = 0.02,
+                       success_thres_rot: float = 0.05,
+                       base_start: list = None,
+                       gmm_model_path: str = ""):
+        """Prepare the next episode (random start pose, goal and planner) in the background. Once an episode is done, step() directly
+        returns the first obs of the next one and the last obs of the finished episode in info['terminal_observation'].
+        Only for the analytical (sim) world."""
+        if gmm_model_path:
+            assert os.path.exists(gmm_model_path), f"Path {gmm_model_path} doesn't exist"
+        self._env.set_auto_reset(enabled, base_start or [], start_pose_distribution, gripper_goal_distribution, gmm_model_path,
+                                 success_thres_dist, success_thres_rot, self._start_pause)
+
+    def set_control_thread(self, enabled: bool):
+        """In real and gazebo execution, run the control loop at the configured rate on a native thread. step() then posts its action
+        and returns the newest observation instead of blocking for the whole control cycle, so slow inference does not stall the robot.
+        The returned reward is the sum over all cycles since the previous step(). Getters of the obs, distances and statistics
+        stop the thread until the next step(). No effect in the analytical world."""
+        self._env.set_control_thread(enabled)
+
+    def get_control_thread(self) -> bool:
+        return self._env.get_control_thread()
+
+    def set_stream_arm_commands(self, enabled: bool, n_lookahead: int = 3):
+        """In real and gazebo execution, publish the ik solution plus n_lookahead extrapolated points as a JointTrajectory to the
+        controller command topics every cycle, instead of a new one-point actionlib goal that preempts the previous one"""
+        self._env.set_stream_arm_commands(enabled, n_lookahead)
+
+    def get_stream_arm_commands(self) -> bool:
+        return self._env.get_stream_arm_commands()
+
+    def set_realtime(self, enabled: bool, priority: int = 0, cpu: int = -1):
+        """Real-time mode for real execution: locks the process memory (mlockall) and runs the control thread with SCHED_FIFO
+        priority (if priority > 0) pinned to cpu (if cpu >= 0). Visualization, path recording, logging and publishing are kept
+        off the control cycles. Enables the control thread and streamed arm commands. Needs the rtprio and memlock limits."""
+        self._env.set_realtime(enabled, priority, cpu)
+
+    def get_realtime(self) -> bool:
+        return self._env.get_realtime()
+
+    def set_lockstep(self, enabled: bool):
+        """Gazebo only: keep the simulation paused and advance it by exactly one control cycle per inner step, so that training runs
+        as fast as the physics allows instead of in real time. Requires /use_sim_time, the control thread is not used meanwhile."""
+        self._env.set_lockstep(enabled)
+
+    def get_lockstep(self) -> bool:
+        return self._env.get_lockstep()
+
+    def set_anytime_ik(self,
+                       enabled: bool,
+                       max_pos_error: float = 0.02,
+                       max_rot_error: float = 0.1,
+                       send_reserve: float = 0.005,
+                       strategy_in_obs: bool = False):
+        """Give each control cycle's ik a hard budget: what is left of the control period minus send_reserve [s] in real / gazebo
+        execution, the usual 0.05 s otherwise. If the full solve does not finish in time, the best partial solution within
+        max_pos_error [m] / max_rot_error [rad] is executed, else the arm holds its joints (counted as ik failure). The strategy
+        (0 full, 1 partial, 2 fallback) is reported in the ik stats and, with strategy_in_obs, in the obs entry that is otherwise
+        always 0. Leave it off for trained checkpoints."""
+        self._env.set_anytime_ik(enabled, max_pos_error, max_rot_error, send_reserve, strategy_in_obs)
+
+    def get_anytime_ik(self) -> bool:
+        return self._env.get_anytime_ik()
+
+    def snapshot(self):
+        """Capture the env state (including the noise stream) to evaluate several action branches from it with restore().
+        snapshot[0].save(filename) / EnvSnapshot.load(filename) write the env part to disk, the frame stack is only kept in memory."""
+        return self._env.snapshot(), deque(self._last_k_obs, maxlen=self._last_k_obs.maxlen)
+
+    def restore(self, snapshot):
+        """Continue from a snapshot(). Only for the analytical (sim) world."""
+        env_snapshot, last_k_obs = snapshot
+        self._env.restore(env_snapshot)
+        self._last_k_obs = deque(last_k_obs, maxlen=last_k_obs.maxlen)
+
     def set_ik_slack(self, ik_slack_dist: float, ik_slack_rot_dist: float):
         assert self._env_name == 'hsr'
         self._env.set_ik_slack(ik_slack_dist, ik_slack_rot_dist)
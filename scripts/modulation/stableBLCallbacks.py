@@ -12,8 +12,7 @@ import wandb
 from stable_baselines3.common.callbacks import BaseCallback, EventCallback
 from stable_baselines3.common.vec_env import DummyVecEnv, VecEnv, sync_envs_normalization
 
-from modulation.utils import calc_dist_to_sol
-from modulation.visualise import plot_pathPoints, plot_relative_pose_map, plot_zfailure_hist
+from modulation.visualise import plot_pathPoints, plot_relative_pose_map, plot_relative_pose_hist, plot_zfailure_hist_binned
 
 
 # from stable_baselines3.common.evaluation import evaluate_policy
@@ -57,6 +56,8 @@ def evaluate_policy(model, env, n_eval_episodes=10, deterministic=True,
     ik_fail_thresh_eval = env.get_attr('_ik_fail_thresh_eval')[0]
     # slow_down = env.env_method('get_slow_down_factor')[0]
     max_len = 100_000
+    # per-episode metrics are aggregated natively, the full trajectories are only pulled for the plotted and logged episodes
+    env.env_method('reset_episode_stats')
     with torch.no_grad():
         for i in range(n_eval_episodes):
             obs = env.env_method('reset')
@@ -102,21 +103,20 @@ def evaluate_policy(model, env, n_eval_episodes=10, deterministic=True,
             episode_actions.append(episode_action)
             # kin fails are cumulative
             kin_fails.append(episode_kin_fails[-1])
-            final_dist_to_goal.append(env.env_method('get_dist_to_goal')[0])
+            episode_stats = env.env_method('get_episode_stats')[0]['last_episode']
+            final_dist_to_goal.append(episode_stats['final_dist_to_goal'])
+            collisions.append(episode_stats['collisions'])
+            dist_gripper_sols_max.append(episode_stats['max_dist_to_sol'])
+            dist_gripper_sols_success.append(episode_stats['dist_to_sol_success'])
+            if episode_kin_fails[-1]:  # nan if there are no failures
+                dist_gripper_sols_fail.append(episode_stats['dist_to_sol_fail'])
 
             if i in np.linspace(0, n_eval_episodes, n_rosbags, dtype=np.int):
                 log_dir, logfile = f'{file_log_path}/trajectories/{global_step}/{name_prefix}', f'e{i}'
             else:
                 log_dir, logfile = "", ""
-            pathPoint = env.env_method('visualize', log_dir, logfile)[0]
-            collisions.append(np.sum([p["collision"] for p in pathPoint]))
-
-            dists_to_sol = [calc_dist_to_sol(p) for p in pathPoint]
-            dist_gripper_sols_max.append(max(dists_to_sol))
-            dist_gripper_sols_success.append(np.mean([dists_to_sol[i] for i, p in enumerate(pathPoint) if not p["ik_fail"]]))
-            if episode_kin_fails[-1]:  # nan if there are no failures
-                dist_gripper_sols_fail.append(np.mean([dists_to_sol[i] for i, p in enumerate(pathPoint) if p["ik_fail"]]))
-            pathPoints.append(pathPoint)
+            if logfile or (plot_n_path_points is None) or (len(pathPoints) < plot_n_path_points):
+                pathPoints.append(env.env_method('visualize', log_dir, logfile)[0])
 
             if (verbose > 1) or (real_exec != "sim"):
                 rospy.loginfo(f"{name_prefix}: Eval ep {i}: {(time.time() - t) / 60:.2f} minutes. "
@@ -142,11 +142,13 @@ def evaluate_policy(model, env, n_eval_episodes=10, deterministic=True,
     fig_pathPoints = plot_pathPoints(pathPoints[:plot_n_path_points] if plot_n_path_points else pathPoints)
     log_dict[f"{name_prefix}/pathPoints"] = wandb.Image(fig_pathPoints)
 
-    fig_relPose2d, fig_relPose3d = plot_relative_pose_map(pathPoints)
-    log_dict[f"{name_prefix}/relPose2D"] = wandb.Image(fig_relPose2d)
+    all_episode_stats = env.env_method('get_episode_stats')[0]
+    log_dict[f"{name_prefix}/relPose2D"] = wandb.Image(plot_relative_pose_hist(all_episode_stats))
+    # the orientations are not binned, so this one only shows the pulled trajectories
+    _, fig_relPose3d = plot_relative_pose_map(pathPoints)
     log_dict[f"{name_prefix}/relPose3D"] = wandb.Image(fig_relPose3d)
 
-    f_zfailure_hist = plot_zfailure_hist(pathPoints)
+    f_zfailure_hist = plot_zfailure_hist_binned(all_episode_stats)
     log_dict[f"{name_prefix}/zfailure_hist"] = wandb.Image(f_zfailure_hist)
 
     fails_per_episode = np.array(kin_fails)
@@ -106,3 +106,28 @@ def plot_zfailure_hist(path_points: list):
     sns.histplot(x=gripper_rel_z, hue=ik_fails, multiple='stack', ax=ax)
     ax.set_title("Kinematic failures per height of the gripper")
     return f
+
+
+def plot_relative_pose_hist(episode_stats: dict):
+    """Top-down ik failure rate per relative gripper position, from the histograms of get_episode_stats()"""
+    steps, fails, r = episode_stats["rel_xy_steps"], episode_stats["rel_xy_fails"], episode_stats["rel_xy_range"]
+    with np.errstate(invalid='ignore'):
+        rate = fails / steps
+    f, ax = plt.subplots(1, 1, figsize=(14, 12))
+    # rows are the x bins
+    im = ax.imshow(rate.T, origin='lower', extent=[-r, r, -r, r], cmap='coolwarm', vmin=0, vmax=1)
+    f.colorbar(im, ax=ax, label='ik failure rate')
+    ax.set_title("Relative gripper poses top-down")
+    return f
+
+
+def plot_zfailure_hist_binned(episode_stats: dict):
+    """Steps and kinematic failures per gripper height, from the histograms of get_episode_stats()"""
+    steps, fails = np.array(episode_stats["rel_z_steps"]), np.array(episode_stats["rel_z_fails"])
+    edges = np.linspace(0, episode_stats["z_max"], len(steps) + 1)
+    f, ax = plt.subplots(1, 1, figsize=(14, 12))
+    ax.bar(edges[:-1], steps - fails, width=np.diff(edges), align='edge', label='ik success')
+    ax.bar(edges[:-1], fails, width=np.diff(edges), align='edge', bottom=steps - fails, label='ik failure')
+    ax.legend()
+    ax.set_title("Kinematic failures per height of the gripper")
+    return f
@@ -0,0 +1,110 @@
+#include <modulation_rl/anytime_ik.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace anytime_ik {
+    // [position; rotation] error of tip towards target in the model frame
+    void AnytimeIK::pose_error(robot_state::RobotState &state,
+                               const moveit::core::LinkModel *tip,
+                               const Eigen::Isometry3d &target,
+                               Eigen::Matrix<double, 6, 1> &error) const {
+        const Eigen::Isometry3d &current = state.getGlobalLinkTransform(tip);
+        error.head<3>() = target.translation() - current.translation();
+        Eigen::AngleAxisd rot_error(target.linear() * current.linear().transpose());
+        error.tail<3>() = rot_error.angle() * rot_error.axis();
+    }
+
+    Result AnytimeIK::solve(robot_state::RobotState &kinematic_state,
+                            const moveit::core::JointModelGroup *group,
+                            const std::string &tip_link,
+                            const Eigen::Isometry3d &target,
+                            const std::vector<double> &seed,
+                            double budget,
+                            const moveit::core::GroupStateValidityCallbackFn &validity_callback) {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(budget, 0.0)));
+        const moveit::core::LinkModel *tip = kinematic_state.getLinkModel(tip_link);
+        Eigen::Matrix<double, 6, 1> error;
+        Result result;
+
+        // a) full solve
+        if ((budget > 0.0) && kinematic_state.setFromIK(group, target, budget * config_.full_solve_share, validity_callback)) {
+            kinematic_state.updateLinkTransforms();
+            pose_error(kinematic_state, tip, target, error);
+            result.strategy = ik_stats::FULL_SOLVE;
+            result.pos_error = error.head<3>().norm();
+            result.rot_error = error.tail<3>().norm();
+            return result;
+        }
+
+        // b) refine from the seed until the deadline, keeping the best joint values
+        kinematic_state.setJointGroupPositions(group, seed);
+        kinematic_state.updateLinkTransforms();
+        pose_error(kinematic_state, tip, target, error);
+        double seed_pos_error = error.head<3>().norm(), seed_rot_error = error.tail<3>().norm();
+        double best_pos_error = seed_pos_error, best_rot_error = seed_rot_error;
+        double best_cost = best_pos_error + config_.rot_weight * best_rot_error;
+        best_ = seed;
+        positions_ = seed;
+        // the jacobian is expressed in the frame of the link the group is attached to
+        const moveit::core::LinkModel *root = group->getJointModels()[0]->getParentLinkModel();
+        while (Clock::now() < deadline) {
+            kinematic_state.getJacobian(group, tip, Eigen::Vector3d::Zero(), jacobian_);
+            if (root != NULL) {
+                const Eigen::Matrix3d root_rot = kinematic_state.getGlobalLinkTransform(root).linear().transpose();
+                error.head<3>() = root_rot * error.head<3>();
+                error.tail<3>() = root_rot * error.tail<3>();
+            }
+            jjt_.noalias() = jacobian_ * jacobian_.transpose();
+            jjt_.diagonal().array() += config_.damping * config_.damping;
+            jjt_solution_ = jjt_ldlt_.compute(jjt_).solve(error);
+            dq_.noalias() = jacobian_.transpose() * jjt_solution_;
+            const double step = dq_.norm();
+            if (step > config_.max_step) {
+                dq_ *= config_.max_step / step;
+            }
+            for (int i = 0; i < std::min((int)positions_.size(), (int)dq_.size()); i++) {
+                positions_[i] += dq_[i];
+            }
+            kinematic_state.setJointGroupPositions(group, positions_);
+            kinematic_state.enforceBounds(group);
+            kinematic_state.copyJointGroupPositions(group, positions_);
+            kinematic_state.updateLinkTransforms();
+            pose_error(kinematic_state, tip, target, error);
+
+            const double pos_error = error.head<3>().norm(), rot_error = error.tail<3>().norm();
+            const double cost = pos_error + config_.rot_weight * rot_error;
+            if (cost < best_cost) {
+                best_ = positions_;
+                best_cost = cost;
+                best_pos_error = pos_error;
+                best_rot_error = rot_error;
+            }
+            if ((step < 1e-6) || (best_pos_error < 1e-4 && best_rot_error < 1e-3)) {
+                // converged or stuck
+                break;
+            }
+        }
+
+        kinematic_state.setJointGroupPositions(group, best_);
+        bool acceptable = (best_pos_error <= config_.max_pos_error) && (best_rot_error <= config_.max_rot_error);
+        if (acceptable && validity_callback) {
+            acceptable = validity_callback(&kinematic_state, group, best_.data());
+        }
+        if (acceptable) {
+            result.strategy = ik_stats::PARTIAL;
+            result.pos_error = best_pos_error;
+            result.rot_error = best_rot_error;
+        } else {
+            // c) hold the current joint values
+            kinematic_state.setJointGroupPositions(group, seed);
+            result.strategy = ik_stats::FALLBACK;
+            result.pos_error = seed_pos_error;
+            result.rot_error = seed_rot_error;
+        }
+        kinematic_state.updateLinkTransforms();
+        return result;
+    }
+}  // namespace anytime_ik
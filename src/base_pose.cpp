@@ -0,0 +1,76 @@
+#include <modulation_rl/base_pose.h>
+
+#include <algorithm>
+
+namespace base_pose {
+    BasePoseProvider::BasePoseProvider(ros::NodeHandle &nh,
+                                       const std::string &odom_topic,
+                                       tf::TransformListener &listener,
+                                       const std::string &map_frame,
+                                       const std::string &base_frame,
+                                       double map_odom_period) :
+        map_frame_{map_frame},
+        base_frame_{base_frame},
+        map_odom_period_{map_odom_period},
+        listener_{listener} {
+        odom_sub_ = nh.subscribe(odom_topic, 10, &BasePoseProvider::odom_callback, this, ros::TransportHints().tcpNoDelay());
+    }
+
+    void BasePoseProvider::odom_callback(const nav_msgs::Odometry::ConstPtr &msg) {
+        if (!have_map_odom_ || (msg->header.stamp - map_odom_.stamp_ > map_odom_period_) || (msg->header.stamp < map_odom_.stamp_)) {
+            try {
+                listener_.lookupTransform(map_frame_, msg->header.frame_id, ros::Time(0), map_odom_);
+                // the correction is only refreshed at the period, measure it from the odometry time
+                map_odom_.stamp_ = msg->header.stamp;
+                have_map_odom_ = true;
+            } catch (const tf::TransformException &e) {
+                ROS_WARN_THROTTLE(5.0, "No %s -> %s transform yet: %s", map_frame_.c_str(), msg->header.frame_id.c_str(), e.what());
+            }
+        }
+        if (!have_map_odom_) {
+            return;
+        }
+        tf::Transform odom_base;
+        tf::poseMsgToTF(msg->pose.pose, odom_base);
+
+        BasePoseSample &sample = pose_.back();
+        sample.map_base = map_odom_ * odom_base;
+        sample.vel_x = msg->twist.twist.linear.x;
+        sample.vel_y = msg->twist.twist.linear.y;
+        sample.vel_yaw = msg->twist.twist.angular.z;
+        sample.stamp = msg->header.stamp;
+        sample.valid = true;
+        pose_.publish();
+    }
+
+    bool BasePoseProvider::has_pose() {
+        pose_.update();
+        return pose_.front().valid;
+    }
+
+    const BasePoseSample &BasePoseProvider::get_sample() {
+        pose_.update();
+        return pose_.front();
+    }
+
+    tf::Transform BasePoseProvider::get(ros::Time time) {
+        const BasePoseSample &sample = get_sample();
+        if (!sample.valid) {
+            throw std::runtime_error("No odometry received on " + odom_sub_.getTopic());
+        }
+        if (time.isZero()) {
+            return sample.map_base;
+        }
+        double dt = std::min(std::max((time - sample.stamp).toSec(), 0.0), max_extrapolation_);
+        return extrapolate(sample, dt);
+    }
+
+    tf::Transform BasePoseProvider::extrapolate(const BasePoseSample &sample, double dt) {
+        // rotate the translation by half of the yaw change: exact for a constant twist to second order
+        double dyaw = sample.vel_yaw * dt;
+        tf::Quaternion half(tf::Vector3(0.0, 0.0, 1.0), 0.5 * dyaw);
+        tf::Vector3 dpos = tf::quatRotate(half, tf::Vector3(sample.vel_x * dt, sample.vel_y * dt, 0.0));
+        tf::Transform delta(tf::Quaternion(tf::Vector3(0.0, 0.0, 1.0), dyaw), dpos);
+        return sample.map_base * delta;
+    }
+}  // namespace base_pose
@@ -0,0 +1,136 @@
+#include <modulation_rl/collision_monitor.h>
+
+#include <ros/ros.h>
+
+namespace collision_monitor {
+    SceneCollisionMonitor::SceneCollisionMonitor(const std::string &joint_group_name, const std::string &collision_group_name) :
+        joint_group_name_{joint_group_name},
+        collision_group_name_{collision_group_name} {
+        worker_ = std::thread(&SceneCollisionMonitor::run, this);
+    }
+
+    SceneCollisionMonitor::~SceneCollisionMonitor() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            running_.store(false);
+        }
+        wake_.notify_one();
+        worker_.join();
+    }
+
+    void SceneCollisionMonitor::set_scene(const planning_scene::PlanningSceneConstPtr &scene,
+                                          const collision_detection::AllowedCollisionMatrix &acm,
+                                          const robot_state::RobotState &state) {
+        // the copy does not depend on scene, so the monitor's updates to it cannot race with the checks
+        planning_scene::PlanningScenePtr copy = planning_scene::PlanningScene::clone(scene);
+        robot_state::RobotStatePtr state_copy(new robot_state::RobotState(state));
+        std::lock_guard<std::mutex> lock(scene_mutex_);
+        scene_ = copy;
+        acm_ = acm;
+        robot_state_ = state_copy;
+    }
+
+    void SceneCollisionMonitor::post(const std::vector<double> &joint_values, const tf::Transform &base_transform) {
+        StateSnapshot &snapshot = state_.back();
+        snapshot.joint_values = joint_values;
+        snapshot.x = base_transform.getOrigin().x();
+        snapshot.y = base_transform.getOrigin().y();
+        snapshot.theta = base_transform.getRotation().getAngle() * base_transform.getRotation().getAxis().getZ();
+        snapshot.generation = generation_;
+        state_.publish();
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            posted_ = true;
+        }
+        wake_.notify_one();
+    }
+
+    bool SceneCollisionMonitor::take_collision(bool &collision) {
+        uint64_t result = result_.load(std::memory_order_acquire);
+        while (true) {
+            const uint32_t checks = (result >> 1) & 0x7fffffff;
+            if (((result >> 32) != generation_) || (checks == taken_checks_)) {
+                return false;
+            }
+            // reset the collision flag unless the worker added a result in the meantime
+            if (result_.compare_exchange_weak(result, result & ~(uint64_t)1, std::memory_order_acq_rel)) {
+                taken_checks_ = checks;
+                collision = result & 1;
+                return true;
+            }
+        }
+    }
+
+    void SceneCollisionMonitor::clear() {
+        generation_++;
+        taken_checks_ = 0;
+        result_.store((uint64_t)generation_ << 32, std::memory_order_release);
+    }
+
+    void SceneCollisionMonitor::add_result(uint32_t generation, bool collision) {
+        uint64_t result = result_.load(std::memory_order_acquire);
+        while ((result >> 32) == generation) {
+            const uint64_t checks = (((result >> 1) + 1) & 0x7fffffff) << 1;
+            const uint64_t updated = (result & ~(uint64_t)0xffffffff) | checks | (result & 1) | (collision ? 1 : 0);
+            if (result_.compare_exchange_weak(result, updated, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+        // posted before the last clear()
+    }
+
+    bool SceneCollisionMonitor::check(const StateSnapshot &snapshot, bool &collision) {
+        std::lock_guard<std::mutex> lock(scene_mutex_);
+        if (!scene_) {
+            return false;
+        }
+        robot_state_->setJointGroupPositions(joint_group_name_, snapshot.joint_values);
+        robot_state_->setVariablePosition("world_joint/x", snapshot.x);
+        robot_state_->setVariablePosition("world_joint/y", snapshot.y);
+        robot_state_->setVariablePosition("world_joint/theta", snapshot.theta);
+        robot_state_->update();
+
+        collision_detection::CollisionRequest collision_request;
+        if (collision_group_name_ != "") {
+            collision_request.group_name = collision_group_name_;
+        }
+        collision_detection::CollisionResult collision_result;
+        scene_->checkCollisionUnpadded(collision_request, collision_result, *robot_state_, acm_);
+        collision = collision_result.collision;
+        return true;
+    }
+
+    void SceneCollisionMonitor::run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                wake_.wait(lock, [this]() { return posted_ || !running_.load(); });
+                if (!running_.load()) {
+                    return;
+                }
+                posted_ = false;
+            }
+            // only the newest snapshot, the ones posted during the last check are skipped
+            if (!state_.update()) {
+                continue;
+            }
+            try {
+                const StateSnapshot &snapshot = state_.front();
+                if ((result_.load(std::memory_order_acquire) >> 32) != snapshot.generation) {
+                    // posted before the last clear()
+                    continue;
+                }
+                bool collision;
+                if (!check(snapshot, collision)) {
+                    // no scene yet
+                    continue;
+                }
+                add_result(snapshot.generation, collision);
+            } catch (const std::exception &e) {
+                ROS_ERROR("Scene collision check failed, stopping the collision monitor: %s", e.what());
+                failed_.store(true);
+                return;
+            }
+        }
+    }
+}  // namespace collision_monitor
@@ -0,0 +1,122 @@
+#include <modulation_rl/control_timing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace control_timing {
+    namespace {
+        void add_histogram(std::map<std::string, double> &s, const std::string &name, const profiler::Histogram &h) {
+            s[name + "_count"] = h.count;
+            s[name + "_mean"] = (h.count > 0) ? h.total / h.count : NAN;
+            s[name + "_p50"] = (h.count > 0) ? h.percentile(0.5) : NAN;
+            s[name + "_p95"] = (h.count > 0) ? h.percentile(0.95) : NAN;
+            s[name + "_p99"] = (h.count > 0) ? h.percentile(0.99) : NAN;
+            s[name + "_max"] = (h.count > 0) ? h.max : NAN;
+        }
+    }  // namespace
+
+    void ControlTiming::begin_episode() {
+        last_wake_ = -1.0;
+        episode_cycles_ = 0;
+        episode_deadline_misses_ = 0;
+    }
+
+    void ControlTiming::wake(double time, bool met_deadline) {
+        CycleRecord &r = ring_[head_ % ring_.size()];
+        head_++;
+        r.wake = time;
+        r.period = NAN;
+        r.work = NAN;
+        r.send = NAN;
+        r.feedback_sample_delay = NAN;
+        r.deadline_miss = false;
+        // the first cycle of an episode has no period, it counts neither as cycle nor as deadline miss
+        if (last_wake_ >= 0.0) {
+            cycles_++;
+            episode_cycles_++;
+            r.period = time - last_wake_;
+            r.work = sleep_start_ - last_wake_;
+            // ros::Rate also reports a miss if the cycle ran over by less than the sleep granularity, so use its verdict
+            r.deadline_miss = !met_deadline;
+            cycle_time_.add(r.period);
+            jitter_.add(std::abs(r.period - expected_period_));
+            work_.add(r.work);
+            if (r.deadline_miss) {
+                deadline_misses_++;
+                episode_deadline_misses_++;
+            }
+        }
+        last_wake_ = time;
+    }
+
+    void ControlTiming::command_sent(double time) {
+        if (head_ == 0) {
+            return;
+        }
+        CycleRecord &r = current();
+        r.send = time - r.wake;
+        send_.add(r.send);
+    }
+
+    void ControlTiming::add_feedback_sample_delay(double delay) {
+        if (head_ == 0) {
+            return;
+        }
+        current().feedback_sample_delay = delay;
+        feedback_sample_delay_.add(delay);
+    }
+
+    std::vector<CycleRecord> ControlTiming::get_cycles() const {
+        uint64_t n = std::min<uint64_t>(head_, ring_.size());
+        std::vector<CycleRecord> cycles;
+        cycles.reserve(n);
+        for (uint64_t i = head_ - n; i < head_; i++) {
+            cycles.push_back(ring_[i % ring_.size()]);
+        }
+        return cycles;
+    }
+
+    std::map<std::string, double> ControlTiming::get_summary() const {
+        std::map<std::string, double> s;
+        s["expected_period"] = expected_period_;
+        s["cycles"] = cycles_;
+        s["deadline_misses"] = deadline_misses_;
+        s["deadline_miss_rate"] = (cycles_ > 0) ? (double)deadline_misses_ / cycles_ : NAN;
+        s["episode_cycles"] = episode_cycles_;
+        s["episode_deadline_misses"] = episode_deadline_misses_;
+        add_histogram(s, "cycle_time", cycle_time_);
+        add_histogram(s, "jitter", jitter_);
+        add_histogram(s, "work", work_);
+        add_histogram(s, "send", send_);
+        add_histogram(s, "feedback_sample_delay", feedback_sample_delay_);
+        return s;
+    }
+
+    void ControlTiming::dump_csv(const std::string &filename) const {
+        std::ofstream f(filename);
+        if (!f.good()) {
+            throw std::runtime_error("Could not open " + filename + " to write the control timings");
+        }
+        f.precision(15);
+        f << "wake,period,work,send,feedback_sample_delay,deadline_miss\n";
+        for (const CycleRecord &r : get_cycles()) {
+            f << r.wake << "," << r.period << "," << r.work << "," << r.send << "," << r.feedback_sample_delay << "," << r.deadline_miss << "\n";
+        }
+    }
+
+    void ControlTiming::reset() {
+        head_ = 0;
+        last_wake_ = -1.0;
+        cycle_time_.reset();
+        jitter_.reset();
+        work_.reset();
+        send_.reset();
+        feedback_sample_delay_.reset();
+        cycles_ = 0;
+        deadline_misses_ = 0;
+        episode_cycles_ = 0;
+        episode_deadline_misses_ = 0;
+    }
+}  // namespace control_timing
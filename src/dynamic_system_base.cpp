@@ -15,9 +15,12 @@ DynamicSystem_base::DynamicSystem_base(uint32_t seed,
                                        double time_step,
                                        double slow_down_real_exec,
                                        bool perform_collision_check,
-                                       RoboConf robo_config) :
-    ROSCommonNode(0, NULL, "ds"),
-    nh_{new ros::NodeHandle("modulation_rl_ik")},
+                                       RoboConf robo_config,
+                                       std::string node_name,
+                                       std::string ros_namespace) :
+    ROSCommonNode(0, NULL, node_name),
+    ns_nh_{new ros::NodeHandle(ros_namespace)},
+    nh_{new ros::NodeHandle(*ns_nh_, "modulation_rl_ik")},
     rate_{50},
     rng_{seed},
     robo_config_{robo_config},
@@ -38,9 +41,11 @@ DynamicSystem_base::DynamicSystem_base(uint32_t seed,
     traj_visualizer_ = nh_->advertise<moveit_msgs::DisplayTrajectory>("traj_visualizer", 1);
     gripper_visualizer_ = nh_->advertise<visualization_msgs::Marker>("gripper_goal_visualizer", 1);
     robstate_visualizer_ = nh_->advertise<moveit_msgs::DisplayRobotState>("robot_state_visualizer", 50);
-    ellipses_pub_ = nh_->advertise<visualization_msgs::MarkerArray>("/GMM/Ellipses", 1, true);
-    cmd_base_vel_pub_ = nh_->advertise<geometry_msgs::Twist>(robo_config_.base_cmd_topic, 1);
-    client_get_scene_ = nh_->serviceClient<moveit_msgs::GetPlanningScene>("/get_planning_scene");
+    // relative names so that several envs can share one master, each in its own namespace. With the default empty namespace
+    // these resolve to the same global names as before
+    ellipses_pub_ = ns_nh_->advertise<visualization_msgs::MarkerArray>("GMM/Ellipses", 1, true);
+    cmd_base_vel_pub_ = ns_nh_->advertise<geometry_msgs::Twist>(robo_config_.base_cmd_topic, 1);
+    client_get_scene_ = ns_nh_->serviceClient<moveit_msgs::GetPlanningScene>("get_planning_scene");
 
     // https://readthedocs.org/projects/moveit/downloads/pdf/latest/
     // https://ros-planning.github.io/moveit_tutorials/doc/planning_scene_monitor/planning_scene_monitor_tutorial.html
@@ -60,6 +65,7 @@ DynamicSystem_base::DynamicSystem_base(uint32_t seed,
     // Set startstate for trajectory visualization
     joint_names_ = joint_model_group_->getVariableNames();
     link_names_ = joint_model_group_->getLinkModelNames();
+    arm_streamer_.init(joint_names_, 3);
 
     planning_scene_.reset(new planning_scene::PlanningScene(kinematic_model));
     ROS_INFO("Planning frame: %s", planning_scene_->getPlanningFrame().c_str());
@@ -67,9 +73,7 @@ DynamicSystem_base::DynamicSystem_base(uint32_t seed,
     moveit_msgs::GetPlanningScene scene_srv1;
     moveit_msgs::PlanningScene currentScene;
     scene_srv1.request.components.components = 2;  // moveit_msgs::PlanningSceneComponents::ROBOT_STATE;
-    if (!client_get_scene_.call(scene_srv1)) {
-        ROS_WARN("Failed to call service /get_planning_scene");
-    }
+    call_get_scene_at_init(scene_srv1);
     planning_scene_->setPlanningSceneDiffMsg(scene_srv1.response.scene);
     robot_state::RobotState robstate = planning_scene_->getCurrentState();
     display_trajectory_.model_id = robo_config_.name;
@@ -106,40 +110,53 @@ DynamicSystem_base::DynamicSystem_base(uint32_t seed,
 
     set_real_execution(real_execution, time_step_real_exec_, slow_down_real_exec);
 
-    // always do this so we can later change to real_execution
-    if (init_controllers_) {
-        planning_scene_monitor_.reset(new planning_scene_monitor::PlanningSceneMonitor(robot_model_loader));
-        planning_scene_monitor_->startSceneMonitor("/my_planning_scene");
-    }
-
+    // seed for the state cache: monitored_planning_scene only sends diffs to late subscribers
+    std::vector<moveit_msgs::CollisionObject> known_objects;
     if (perform_collision_check_) {
         // Collision constraint function GroupStateValidityCallbackFn(),
         moveit_msgs::GetPlanningScene scene_srv;
         moveit_msgs::PlanningScene currentScene;
         scene_srv.request.components.components = 24;  // moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_NAMES;
-        if (!client_get_scene_.call(scene_srv)) {
-            ROS_WARN("Failed to call service /get_planning_scene");
-        }
+        call_get_scene_at_init(scene_srv);
         currentScene = scene_srv.response.scene;
         ROS_INFO("Known collision objects:");
         for (int i = 0; i < (int)scene_srv.response.scene.world.collision_objects.size(); ++i) {
             ROS_INFO_STREAM(scene_srv.response.scene.world.collision_objects[i].id);
         }
         planning_scene_->setPlanningSceneDiffMsg(currentScene);
-        constraint_callback_fn_ = boost::bind(&validityFun::validityCallbackFn, planning_scene_, kinematic_state_, _2, _3);
+        constraint_callback_fn_ = boost::bind(&validityFun::validityCallbackFn, planning_scene_, kinematic_state_, &profiler_, &ik_stats_, _2, _3);
+        known_objects = scene_srv.response.scene.world.collision_objects;
+    }
+
+    // always do this so we can later change to real_execution
+    if (init_controllers_) {
+        planning_scene_monitor_.reset(new planning_scene_monitor::PlanningSceneMonitor(robot_model_loader));
+        planning_scene_monitor_->startSceneMonitor(ns_nh_->resolveName("my_planning_scene"));
+        state_cache_ = new robot_state_cache::RobotStateCache(*ns_nh_, joint_names_, "joint_states", "move_group/monitored_planning_scene", known_objects);
     }
 
     if (strategy_ == "modulate_ellipse") {
         modulation_.setEllipses();
     }
+    preallocate_control_buffers();
 }
 
 void DynamicSystem_base::set_real_execution(std::string real_execution, double time_step, double slow_down_real_exec) {
-    if (real_execution == "gazebo") {
-        world_ = new GazeboWorld();
+    check_no_pending_step("set_real_execution");
+    stop_control_thread();
+    if ((lockstep_clock_ != NULL) && (real_execution != "gazebo")) {
+        set_lockstep(false);
+    }
+    if ((world_ != NULL) && (world_->get_name() == real_execution)) {
+        // keep the current world
+    } else if (real_execution == "gazebo") {
+        delete world_;
+        world_ = new GazeboWorld(ns_nh_, robo_config_.odom_topic);
     } else if (real_execution == "world") {
-        world_ = new RealWorld();
+        delete world_;
+        world_ = new RealWorld(ns_nh_, robo_config_.odom_topic);
     } else if (real_execution == "sim") {
+        delete world_;
         world_ = new SimWorld();
     } else {
         throw std::runtime_error("Unknown real_execution value");
@@ -149,13 +166,65 @@ void DynamicSystem_base::set_real_execution(std::string real_execution, double t
     }
     time_step_real_exec_ = time_step;
     slow_down_factor_ = (world_->is_analytical()) ? 1.0 : slow_down_real_exec;
+    if (auto_reset_ && !world_->is_analytical()) {
+        ROS_WARN("Disabling auto reset, it is only supported for analytical worlds");
+        discard_prepared_episode();
+        auto_reset_ = false;
+    }
+}
+
+void DynamicSystem_base::set_tracing(bool enabled, std::string dump_dir) {
+    check_no_pending_step("set_tracing");
+    stop_control_thread();
+    profiler_.set_tracing(enabled);
+    trace_dump_dir_ = dump_dir;
+}
+
+void DynamicSystem_base::dump_trace(std::string filename) {
+    stop_control_thread();
+    profiler_.get_tracer().dump_chrome_trace(filename);
+    profiler_.get_tracer().clear();
+    ROS_INFO("Written trace to %s", filename.c_str());
+}
+
+// Under a ros_namespace the service is resolved in that namespace and has to be provided (or remapped) there. Fail loudly
+// instead of silently running without the robot state and collision objects of move_group
+void DynamicSystem_base::call_get_scene_at_init(moveit_msgs::GetPlanningScene &srv) {
+    if (client_get_scene_.call(srv)) {
+        return;
+    }
+    if (ns_nh_->getNamespace() != "/") {
+        throw std::runtime_error("Failed to call service " + client_get_scene_.getService() + ", provide or remap get_planning_scene in " + ns_nh_->getNamespace());
+    }
+    ROS_WARN("Failed to call service %s", client_get_scene_.getService().c_str());
+}
+
+// random goal around currentBase. Only reads constant members, so it is also used from the auto-reset thread
+tf::Transform DynamicSystem_base::draw_random_goal(const tf::Transform &currentBase,
+                                                   const std::string &gripper_goal_distribution,
+                                                   env_rng::Generator &rng) const {
+    if (gripper_goal_distribution == "fixed") {
+        throw std::runtime_error("Fixed gripper_goal_distribution not implemented anymore");
+    }
+    double min_goal_height = (gripper_goal_distribution == "restricted_ws") ? robo_config_.restricted_ws_z_min : robo_config_.z_min;
+    double max_goal_height = (gripper_goal_distribution == "restricted_ws") ? robo_config_.restricted_ws_z_max : robo_config_.z_max;
+
+    double goal_dist = rng.uniformReal(min_goal_dist_, max_goal_dist_);
+    double goal_orientation = rng.uniformReal(0.0, M_PI);
+    int rnd_sign = (rng.uniformInteger(0, 1) == 1) ? 1 : -1;
+
+    double x_goal = currentBase.getOrigin().x() + goal_dist * cos(goal_orientation);
+    double y_goal = currentBase.getOrigin().y() + ((double)rnd_sign) * goal_dist * sin(goal_orientation);
+    double z_goal = rng.uniformReal(min_goal_height, max_goal_height);
+
+    tf::Quaternion q_goal;
+    q_goal.setRPY(rng.uniformReal(0.0, 2 * M_PI), rng.uniformReal(0.0, 2 * M_PI), rng.uniformReal(0.0, 2 * M_PI));
+    return tf::Transform(q_goal.normalized(), tf::Vector3(x_goal, y_goal, z_goal));
 }
 
 void DynamicSystem_base::set_new_random_goal(std::string gripper_goal_distribution) {
     // slightly hacky / hardcoded real world case to ensure we get a random goal in a valid part of the map
     tf::Transform currentBase;
-    double min_goal_height = (gripper_goal_distribution == "restricted_ws") ? robo_config_.restricted_ws_z_min : robo_config_.z_min;
-    double max_goal_height = (gripper_goal_distribution == "restricted_ws") ? robo_config_.restricted_ws_z_max : robo_config_.z_max;
 
     // only used in real world execution
     if (world_->get_name() == "world") {
@@ -165,24 +234,9 @@ void DynamicSystem_base::set_new_random_goal(std::string gripper_goal_distributi
     }
     bool valid = false;
     while (!valid) {
-        // random goal around the origin
-        currentGripperGOAL_.setIdentity();
-        double goal_dist = rng_.uniformReal(min_goal_dist_, max_goal_dist_);
-        double goal_orientation = rng_.uniformReal(0.0, M_PI);
-        int rnd_sign = (rng_.uniformInteger(0, 1) == 1) ? 1 : -1;
-
-        double x_goal = currentBase.getOrigin().x() + goal_dist * cos(goal_orientation);
-        double y_goal = currentBase.getOrigin().y() + ((double)rnd_sign) * goal_dist * sin(goal_orientation);
-        double z_goal = rng_.uniformReal(min_goal_height, max_goal_height);
-        currentGripperGOAL_.setOrigin(tf::Vector3(x_goal, y_goal, z_goal));
-
-        tf::Quaternion q_goal;
-        q_goal.setRPY(rng_.uniformReal(0.0, 2 * M_PI), rng_.uniformReal(0.0, 2 * M_PI), rng_.uniformReal(0.0, 2 * M_PI));
-        currentGripperGOAL_.setRotation(q_goal.normalized());
-
-        if (gripper_goal_distribution == "fixed") {
-            throw std::runtime_error("Fixed gripper_goal_distribution not implemented anymore");
-        }
+        currentGripperGOAL_ = draw_random_goal(currentBase, gripper_goal_distribution, rng_);
+        double x_goal = currentGripperGOAL_.getOrigin().x();
+        double y_goal = currentGripperGOAL_.getOrigin().y();
 
         if (world_->get_name() == "world") {
             // ensure the goal is within our map
@@ -227,6 +281,10 @@ std::vector<double> DynamicSystem_base::set_gripper_goal(std::vector<double> gri
                                                          double success_thres_dist,
                                                          double success_thres_rot,
                                                          double start_pause) {
+    check_no_pending_step("set_gripper_goal");
+    // the control thread owns the env state while it runs
+    stop_control_thread();
+    profiler::ScopedTimer timer(profiler_, profiler::SET_GOAL);
     success_thres_dist_ = success_thres_dist;
     success_thres_rot_ = success_thres_rot;
     start_pause_ = start_pause;
@@ -247,29 +305,60 @@ std::vector<double> DynamicSystem_base::set_gripper_goal(std::vector<double> gri
         currentGripperGOAL_ = utils::tip_to_gripper_goal(currentGripperGOAL_input, robo_config_.tip_to_gripper_offset, robo_config_.gripper_to_base_rot_offset);
     }
 
-    // There's probably a better way than redefining the planner everytime
-    // NOTE: IF ADJUSTING PLANNER VELOCITY CONSTRAINTS, ALSO ADJUST robo_config_.base_vel_rng, robo_config_.base_rot_rng (DON'T FORGET TIAGO)
-    if (gmm_model_path != ""){
+    {
+        profiler::ScopedTimer gmm_timer(profiler_, profiler::GMM_LOAD, gmm_model_path != "");
+        gripper_planner_ = create_planner(active_planner_slot_, gmm_model_path, currentGripperGOAL_input, currentGripperGOAL_, currentGripperTransform_, currentBaseGOAL_, currentBaseTransform_);
+    }
+    planner_init_ = {gmm_model_path, currentGripperGOAL_input, currentGripperTransform_, currentBaseTransform_};
+    return start_gripper_goal(currentGripperGOAL_input, gmm_model_path != "");
+}
+
+// Reinitialise the planner of the given slot for a new goal, only allocating it the first time.
+// NOTE: IF ADJUSTING PLANNER VELOCITY CONSTRAINTS, ALSO ADJUST robo_config_.base_vel_rng, robo_config_.base_rot_rng (DON'T FORGET TIAGO)
+// For the gmm planner gripper_goal is moved to its last attractor. Apart from the slot only reads constant members, so it is also used from the auto-reset thread
+BaseGripperPlanner *DynamicSystem_base::create_planner(int slot,
+                                                       const std::string &gmm_model_path,
+                                                       const tf::Transform &gripper_goal_input,
+                                                       tf::Transform &gripper_goal,
+                                                       const tf::Transform &gripper_transform,
+                                                       const tf::Transform &base_goal,
+                                                       const tf::Transform &base_transform) {
+    PlannerSlot &planners = planner_slots_[slot];
+    if (gmm_model_path != "") {
         // goal for gmm planner is origin of the object -> pass original goal input to planner, then change to wrist goal after instantiating, then call tip_to_gripper_goal() again
-        gripper_planner_ = new GMMPlanner(robo_config_.tip_to_gripper_offset,
+        if (planners.gmm == NULL) {
+            planners.gmm = new GMMPlanner(robo_config_.tip_to_gripper_offset,
                                           robo_config_.gripper_to_base_rot_offset,
-                                          currentGripperGOAL_input,
-                                          currentGripperTransform_,
-                                          currentBaseGOAL_,
-                                          currentBaseTransform_,
+                                          gripper_goal_input,
+                                          gripper_transform,
+                                          base_goal,
+                                          base_transform,
                                           gmm_model_path,
                                           robo_config_.gmm_base_offset);
-        currentGripperGOAL_ = gripper_planner_->get_last_attractor();
-        currentGripperGOAL_ = utils::tip_to_gripper_goal(currentGripperGOAL_, robo_config_.tip_to_gripper_offset, robo_config_.gripper_to_base_rot_offset);
+        } else {
+            planners.gmm->reinit(gripper_goal_input, gripper_transform, base_goal, base_transform, gmm_model_path, robo_config_.gmm_base_offset);
+        }
+        gripper_goal = utils::tip_to_gripper_goal(planners.gmm->get_last_attractor(), robo_config_.tip_to_gripper_offset, robo_config_.gripper_to_base_rot_offset);
+        return planners.gmm;
+    } else {
+        if (planners.linear == NULL) {
+            planners.linear = new LinearPlanner(gripper_goal, gripper_transform, base_goal, base_transform);
+        } else {
+            planners.linear->reinit(gripper_goal, gripper_transform, base_goal, base_transform);
+        }
+        return planners.linear;
+    }
+}
 
+// second half of set_gripper_goal(), once the goal and gripper_planner_ are set
+std::vector<double> DynamicSystem_base::start_gripper_goal(const tf::Transform &currentGripperGOAL_input, bool is_gmm) {
+    if (is_gmm) {
         // display the attractors of the gmm
         std::vector<tf::Transform> mus = gripper_planner_->get_mus();
         for (int i = 0; i < mus.size(); i++) {
             visualization_msgs::Marker m = utils::marker_from_transform(mus[i], "gmm_mus", "blue", 1.0, 0, robo_config_.frame_id);
             gripper_visualizer_.publish(m);
         }
-    } else {
-        gripper_planner_ = new LinearPlanner(currentGripperGOAL_, currentGripperTransform_, currentBaseGOAL_, currentBaseTransform_);
     }
     // plan velocities to be modulated and set in next step. Assumes currentGripperTransform_, currentGripperTransform_ and prev_gripper_plan_ have already been set
     set_goal_time_ = time_;
@@ -293,6 +382,15 @@ std::vector<double> DynamicSystem_base::set_gripper_goal(std::vector<double> gri
         planning_scene::PlanningScenePtr scene = planning_scene_monitor_->getPlanningScene();
         // scene->getCurrentStateNonConst().update();
         setAllowedCollisionMatrix(scene, allowed_collisions, true);
+        if (collision_monitor_ == NULL) {
+            collision_monitor_ = new collision_monitor::SceneCollisionMonitor(robo_config_.joint_model_group_name, robo_config_.scene_collision_group_name);
+        }
+        {
+            // copy while the scene monitor is not updating it
+            planning_scene_monitor::LockedPlanningSceneRO locked_scene(planning_scene_monitor_);
+            collision_monitor_->set_scene(locked_scene, acm_, *kinematic_state_);
+        }
+        collision_monitor_->clear();
     }
 
     visualization_msgs::Marker goal_input_marker = utils::marker_from_transform(currentGripperGOAL_input, "gripper_goal_input", utils::get_color_msg("blue"), marker_counter_, robo_config_.frame_id);
@@ -303,97 +401,100 @@ std::vector<double> DynamicSystem_base::set_gripper_goal(std::vector<double> gri
     return build_obs_vector(tf::Vector3(0, 0, 0), tf::Vector3(0, 0, 0), tf::Quaternion(0, 0, 0, 0));
 }
 
-void DynamicSystem_base::set_gripper_to_neutral() {
-    // a) predefined neutral position
-    kinematic_state_->setVariablePositions(robo_config_.neutral_pos_joint_names, robo_config_.neutral_pos_values);
-    // update values
-    const Eigen::Affine3d &end_effector_state = kinematic_state_->getGlobalLinkTransform(robo_config_.global_link_transform);
-    tf::transformEigenToTF(end_effector_state, rel_gripper_pose_);
-    currentGripperTransform_ = currentBaseTransform_ * rel_gripper_pose_;
-
-    kinematic_state_->copyJointGroupPositions(joint_model_group_, current_joint_values_);
-}
-
-double DynamicSystem_base::draw_rng(double lower, double upper) {
+double DynamicSystem_base::draw_rng(double lower, double upper, env_rng::Generator &rng) const {
     if (lower == upper) {
         return lower;
     } else if (lower > upper) {
         throw std::runtime_error("lower > upper");
     } else {
-        return rng_.uniformReal(lower, upper);
+        return rng.uniformReal(lower, upper);
     }
 }
 
-bool DynamicSystem_base::out_of_workspace(tf::Transform gripper_tf) {
+bool DynamicSystem_base::out_of_workspace(tf::Transform gripper_tf) const {
     return (gripper_tf.getOrigin().z() < robo_config_.restricted_ws_z_min) || (gripper_tf.getOrigin().z() > robo_config_.restricted_ws_z_max);
 }
 
-// base_start: [xmin, xmax, ymin, ymax] or empty to use origin
-bool DynamicSystem_base::set_start_pose(std::vector<double> base_start, std::string start_pose_distribution) {
-    // Reset Base to origin
+// base_start: [xmin, xmax, ymin, ymax, yawmin, yawmax] or empty to use origin
+tf::Transform DynamicSystem_base::draw_start_base(const std::vector<double> &base_start, env_rng::Generator &rng) const {
     double xbase = 0, ybase = 0, yawbase = 0;
-
-    if (world_->get_name() == "world") {
-        ROS_INFO("Real world execution set. Taking the current base transform as starting point.");
-        currentBaseTransform_ = world_->get_base_transform_world();
-    } else {
-        if (!base_start.empty()) {
-            if (base_start.size() != 6) { throw std::runtime_error("invalid length of specified base_start"); }
-            xbase = draw_rng(base_start[0], base_start[1]);
-            ybase = draw_rng(base_start[2], base_start[3]);
-            yawbase = draw_rng(base_start[4], base_start[5]);
-        }
-
-        currentBaseTransform_.setOrigin(tf::Vector3(xbase, ybase, 0.0));
-        tf::Quaternion q_base;
-        q_base.setRPY(0.0, 0.0, yawbase);
-        currentBaseTransform_.setRotation(q_base);
+    if (!base_start.empty()) {
+        if (base_start.size() != 6) { throw std::runtime_error("invalid length of specified base_start"); }
+        xbase = draw_rng(base_start[0], base_start[1], rng);
+        ybase = draw_rng(base_start[2], base_start[3], rng);
+        yawbase = draw_rng(base_start[4], base_start[5], rng);
     }
-    // Reset Gripper pose to start
+    tf::Quaternion q_base;
+    q_base.setRPY(0.0, 0.0, yawbase);
+    return tf::Transform(q_base, tf::Vector3(xbase, ybase, 0.0));
+}
+
+// Set the arm joints of state to a start configuration for a robot at base_transform.
+// Only reads constant members, so it is also used from the auto-reset thread with its own state and copy of the scene
+void DynamicSystem_base::draw_start_arm(const std::string &start_pose_distribution,
+                                        const tf::Transform &base_transform,
+                                        env_rng::Generator &rng,
+                                        robot_state::RobotState &state,
+                                        planning_scene::PlanningScenePtr scene) const {
     if (start_pose_distribution == "fixed") {
-        set_gripper_to_neutral();
+        // a) predefined neutral position
+        state.setVariablePositions(robo_config_.neutral_pos_joint_names, robo_config_.neutral_pos_values);
     } else if ((start_pose_distribution == "rnd") || (start_pose_distribution == "restricted_ws")) {
         // c) RANDOM pose relative to base
         collision_detection::CollisionRequest collision_request;
         collision_request.group_name = robo_config_.joint_model_group_name;
         collision_detection::CollisionResult collision_result;
 
+        // moveit only draws from a random_numbers generator, seeded from rng to stay reproducible
+        random_numbers::RandomNumberGenerator joint_rng(rng.uniformInteger(0, std::numeric_limits<int>::max()));
         bool invalid = true;
         while (invalid) {
-            kinematic_state_->setToRandomPositions(joint_model_group_, rng_);
+            state.setToRandomPositions(joint_model_group_, joint_rng);
 
             // check if in self-collision
-            planning_scene_->getCurrentStateNonConst().update();
+            scene->getCurrentStateNonConst().update();
 
-            robot_state::RobotState state_copy(*kinematic_state_);
-            state_copy.setVariablePosition("world_joint/x", currentBaseTransform_.getOrigin().x());
-            state_copy.setVariablePosition("world_joint/y", currentBaseTransform_.getOrigin().y());
-            state_copy.setVariablePosition("world_joint/theta", currentBaseTransform_.getRotation().getAngle() * currentBaseTransform_.getRotation().getAxis().getZ());
+            robot_state::RobotState state_copy(state);
+            state_copy.setVariablePosition("world_joint/x", base_transform.getOrigin().x());
+            state_copy.setVariablePosition("world_joint/y", base_transform.getOrigin().y());
+            state_copy.setVariablePosition("world_joint/theta", base_transform.getRotation().getAngle() * base_transform.getRotation().getAxis().getZ());
 
-            planning_scene_->checkCollisionUnpadded(collision_request, collision_result, state_copy);
+            scene->checkCollisionUnpadded(collision_request, collision_result, state_copy);
             invalid = collision_result.collision;
             ROS_INFO_COND(collision_result.collision, "set_start_pose: drawn pose in self-collision, trying again");
             collision_result.clear();
 
             if (start_pose_distribution == "restricted_ws") {
-                const Eigen::Affine3d &ee_pose = kinematic_state_->getGlobalLinkTransform(robo_config_.global_link_transform);
+                const Eigen::Affine3d &ee_pose = state.getGlobalLinkTransform(robo_config_.global_link_transform);
                 tf::Transform temp_tf;
                 tf::transformEigenToTF(ee_pose, temp_tf);
                 invalid &= out_of_workspace(temp_tf);
                 ROS_INFO_COND(invalid, "Goal outside of restricted ws, sampling again.");
             }
         }
-
-        const Eigen::Affine3d &end_effector_state = kinematic_state_->getGlobalLinkTransform(robo_config_.global_link_transform);
-        tf::transformEigenToTF(end_effector_state, rel_gripper_pose_);
-        // multiplication theoretically unnecessary as long as currentBaseTransform_ is the identity
-        currentGripperTransform_ = currentBaseTransform_ * rel_gripper_pose_;
-        kinematic_state_->copyJointGroupPositions(joint_model_group_, current_joint_values_);
     } else {
         throw std::runtime_error("Invalid start_pose_distribution");
     }
+}
+
+bool DynamicSystem_base::set_start_pose(std::vector<double> base_start, std::string start_pose_distribution, bool do_close_gripper) {
+    // Reset Base to origin
+    if (world_->get_name() == "world") {
+        ROS_INFO("Real world execution set. Taking the current base transform as starting point.");
+        currentBaseTransform_ = world_->get_base_transform_world();
+    } else {
+        currentBaseTransform_ = draw_start_base(base_start, rng_);
+    }
+    // Reset Gripper pose to start
+    draw_start_arm(start_pose_distribution, currentBaseTransform_, rng_, *kinematic_state_, planning_scene_);
 
-    bool success = set_pose_in_world();
+    const Eigen::Affine3d &end_effector_state = kinematic_state_->getGlobalLinkTransform(robo_config_.global_link_transform);
+    tf::transformEigenToTF(end_effector_state, rel_gripper_pose_);
+    // multiplication theoretically unnecessary as long as currentBaseTransform_ is the identity
+    currentGripperTransform_ = currentBaseTransform_ * rel_gripper_pose_;
+    kinematic_state_->copyJointGroupPositions(joint_model_group_, current_joint_values_);
+
+    bool success = set_pose_in_world(do_close_gripper);
     return success;
 }
 
@@ -409,17 +510,24 @@ std::vector<double> DynamicSystem_base::reset(std::vector<double> gripper_goal,
                                               double success_thres_rot,
                                               double start_pause,
                                               bool verbose) {
+    check_no_pending_step("reset");
+    stop_control_thread();
+    profiler::ScopedTimer timer(profiler_, profiler::RESET);
     ROS_INFO_COND(!world_->is_analytical(), "Reseting environment");
 
     ik_error_count_ = 0;
     verbose_ = verbose;
+    episode_++;
     // set start for both base and gripper
     // if not the analytical env, we actually execute it in gazebo to reset. This might sometimes fail. So continue sampling a few random poses
     bool success = false;
     int trials = 0, max_trials = 50;
-    while ((!success) && trials < max_trials) {
-        success = set_start_pose(base_start, start_pose_distribution);
-        trials++;
+    {
+        profiler::ScopedTimer start_pose_timer(profiler_, profiler::START_POSE);
+        while ((!success) && trials < max_trials) {
+            success = set_start_pose(base_start, start_pose_distribution, do_close_gripper);
+            trials++;
+        }
     }
     if (trials > max_trials) {
         throw std::runtime_error("Could not set start pose after 50 trials!!!");
@@ -437,12 +545,26 @@ std::vector<double> DynamicSystem_base::reset(std::vector<double> gripper_goal,
 //        }
     }
 
-    if (do_close_gripper) {
+    if (do_close_gripper && world_->is_analytical()) {
+        // in real / gazebo execution it was already sent together with the start pose
         close_gripper(0.0, false);
     }
+    begin_episode();
+
+    // Set new random goals for base and gripper. Assumes that we've already set the currentBaseTransform_, currentGripperTransform_
+    // also sets the plan for the first step
+    std::vector<double> obs = set_gripper_goal(gripper_goal, gripper_goal_distribution, gmm_model_path, success_thres_dist, success_thres_rot, start_pause);
 
+    add_trajectory_point(gripper_planner_->get_prev_plan(), true);
+
+    // return observation vector
+    return obs;
+}
+
+// reset time, visualizations and the recorded trajectory once the start pose is set
+void DynamicSystem_base::begin_episode() {
     // reset time after the start pose is set
-    time_ = (world_->is_analytical()) ? 0.0 : ros::Time::now().toSec();
+    time_ = (world_->is_analytical()) ? 0.0 : world_time();
     reset_time_ = time_;
 
     // Clear the visualizations
@@ -454,22 +576,233 @@ std::vector<double> DynamicSystem_base::reset(std::vector<double> gripper_goal,
 
     display_trajectory_.trajectory.clear();
     pathPoints_.clear();
+    episode_stats_.begin_episode();
+    ik_strategy_ = ik_stats::FULL_SOLVE;
+    control_timing_.begin_episode();
+    control_timing_.set_expected_period(rate_.expectedCycleTime().toSec());
+    arm_streamer_.reset();
     gripper_plan_marker_.markers.clear();
     marker_counter_++;
     if (marker_counter_ > 3) {
         marker_counter_ = 0;
     }
+}
 
-    // Set new random goals for base and gripper. Assumes that we've already set the currentBaseTransform_, currentGripperTransform_
-    // also sets the plan for the first step
-    std::vector<double> obs = set_gripper_goal(gripper_goal, gripper_goal_distribution, gmm_model_path, success_thres_dist, success_thres_rot, start_pause);
+void DynamicSystem_base::set_auto_reset(bool enabled,
+                                        std::vector<double> base_start,
+                                        std::string start_pose_distribution,
+                                        std::string gripper_goal_distribution,
+                                        std::string gmm_model_path,
+                                        double success_thres_dist,
+                                        double success_thres_rot,
+                                        double start_pause) {
+    check_no_pending_step("set_auto_reset");
+    // drop an episode prepared with the old settings
+    discard_prepared_episode();
+    auto_reset_ = enabled;
+    if (!enabled) {
+        return;
+    }
+    if (!world_->is_analytical()) {
+        // resets in gazebo or the real world have to move the robot, which cannot happen while the current episode runs
+        auto_reset_ = false;
+        throw std::runtime_error("auto reset is only supported for analytical worlds");
+    }
+    auto_reset_config_.base_start = base_start;
+    auto_reset_config_.start_pose_distribution = start_pose_distribution;
+    auto_reset_config_.gripper_goal_distribution = gripper_goal_distribution;
+    auto_reset_config_.gmm_model_path = gmm_model_path;
+    auto_reset_config_.success_thres_dist = success_thres_dist;
+    auto_reset_config_.success_thres_rot = success_thres_rot;
+    auto_reset_config_.start_pause = start_pause;
+    // private copy, the worker must not touch planning_scene_ while the env steps
+    auto_reset_scene_ = planning_scene::PlanningScene::clone(planning_scene_);
+    prepare_next_episode();
+}
 
-    add_trajectory_point(gripper_planner_->get_prev_plan(), true);
+void DynamicSystem_base::prepare_next_episode() {
+    // seed drawn here so that runs with the same env seed stay reproducible
+    uint32_t seed = rng_.uniformInteger(0, std::numeric_limits<int>::max());
+    // copy made on this thread, the worker then owns it
+    robot_state::RobotStatePtr state(new robot_state::RobotState(*kinematic_state_));
+    // the planner slot the running episode does not use
+    next_episode_ = std::async(std::launch::async, &DynamicSystem_base::prepare_episode, this, auto_reset_config_, seed, state, 1 - active_planner_slot_);
+}
 
-    // return observation vector
+void DynamicSystem_base::discard_prepared_episode() {
+    if (!next_episode_.valid()) {
+        return;
+    }
+    try {
+        // the planner stays in its slot for reuse
+        next_episode_.get();
+    } catch (const std::exception &e) {
+        ROS_WARN("Discarding failed episode preparation: %s", e.what());
+    }
+}
+
+// Runs on the auto-reset thread: everything of reset() that does not touch the state of the running episode
+DynamicSystem_base::PreparedEpisode DynamicSystem_base::prepare_episode(const AutoResetConfig config, uint32_t seed, robot_state::RobotStatePtr state, int planner_slot) {
+    env_rng::Generator rng(seed);
+    PreparedEpisode episode;
+
+    episode.base_transform = draw_start_base(config.base_start, rng);
+    draw_start_arm(config.start_pose_distribution, episode.base_transform, rng, *state, auto_reset_scene_);
+    tf::transformEigenToTF(state->getGlobalLinkTransform(robo_config_.global_link_transform), episode.rel_gripper_pose);
+    state->copyJointGroupPositions(joint_model_group_, episode.joint_values);
+
+    // goal is drawn around the origin, same as set_new_random_goal() for analytical worlds
+    tf::Transform origin;
+    origin.setIdentity();
+    episode.gripper_goal_input = draw_random_goal(origin, config.gripper_goal_distribution, rng);
+    episode.gripper_goal = episode.gripper_goal_input;
+    episode.base_goal = episode.gripper_goal_input;
+    episode.base_goal.setOrigin(tf::Vector3(episode.gripper_goal_input.getOrigin().x(), episode.gripper_goal_input.getOrigin().y(), 0.0));
+
+    episode.planner_slot = planner_slot;
+    episode.planner = create_planner(planner_slot,
+                                     config.gmm_model_path,
+                                     episode.gripper_goal_input,
+                                     episode.gripper_goal,
+                                     episode.base_transform * episode.rel_gripper_pose,
+                                     episode.base_goal,
+                                     episode.base_transform);
+    return episode;
+}
+
+// Swap in the episode prepared in the background and start preparing the next one. Same effect as reset() with the auto reset settings
+std::vector<double> DynamicSystem_base::auto_reset() {
+    profiler::ScopedTimer timer(profiler_, profiler::RESET);
+    PreparedEpisode episode = next_episode_.get();
+    // must switch slots before the next preparation starts on the other one
+    active_planner_slot_ = episode.planner_slot;
+    prepare_next_episode();
+
+    ik_error_count_ = 0;
+    episode_++;
+    currentBaseTransform_ = episode.base_transform;
+    rel_gripper_pose_ = episode.rel_gripper_pose;
+    currentGripperTransform_ = currentBaseTransform_ * rel_gripper_pose_;
+    current_joint_values_ = episode.joint_values;
+    kinematic_state_->setJointGroupPositions(joint_model_group_, current_joint_values_);
+    set_pose_in_world(false);
+    begin_episode();
+
+    profiler::ScopedTimer goal_timer(profiler_, profiler::SET_GOAL);
+    success_thres_dist_ = auto_reset_config_.success_thres_dist;
+    success_thres_rot_ = auto_reset_config_.success_thres_rot;
+    start_pause_ = auto_reset_config_.start_pause;
+    currentGripperGOAL_ = episode.gripper_goal;
+    currentBaseGOAL_ = episode.base_goal;
+    gripper_planner_ = episode.planner;
+    planner_init_ = {auto_reset_config_.gmm_model_path, episode.gripper_goal_input, currentGripperTransform_, currentBaseTransform_};
+    std::vector<double> obs = start_gripper_goal(episode.gripper_goal_input, auto_reset_config_.gmm_model_path != "");
+
+    add_trajectory_point(gripper_planner_->get_prev_plan(), true);
     return obs;
 }
 
+env_snapshot::Snapshot DynamicSystem_base::snapshot() {
+    check_no_pending_step("snapshot");
+    stop_control_thread();
+    env_snapshot::Snapshot s;
+    s.episode = episode_;
+    s.path_size = pathPoints_.size();
+    s.display_trajectory_size = display_trajectory_.trajectory.size();
+    s.episode_stats = episode_stats_.get_current_episode();
+    s.joint_values = current_joint_values_;
+    s.base_transform = currentBaseTransform_;
+    s.gripper_transform = currentGripperTransform_;
+    s.rel_gripper_pose = rel_gripper_pose_;
+    s.gripper_goal = currentGripperGOAL_;
+    s.base_goal = currentBaseGOAL_;
+    s.planned_gripper_vel = planned_gripper_vel_;
+    s.planned_base_vel = planned_base_vel_;
+
+    s.gmm_model_path = planner_init_.gmm_model_path;
+    s.planner_goal_input = planner_init_.goal_input;
+    s.planner_initial_gripper = planner_init_.initial_gripper;
+    s.planner_initial_base = planner_init_.initial_base;
+    s.prev_plan = gripper_planner_->get_plan_state();
+    s.gmm_time_offset = gripper_planner_->get_time_offset();
+
+    s.time = time_;
+    s.time_planner = time_planner_;
+    s.reset_time = reset_time_;
+    s.set_goal_time = set_goal_time_;
+    s.start_pause = start_pause_;
+    s.success_thres_dist = success_thres_dist_;
+    s.success_thres_rot = success_thres_rot_;
+    s.ik_error_count = ik_error_count_;
+    s.ik_strategy = ik_strategy_;
+    s.rng_state = rng_.get_state();
+    modulation_.getState(s.ellipses, s.ellipse_real_gamma);
+    return s;
+}
+
+void DynamicSystem_base::restore(const env_snapshot::Snapshot &snapshot) {
+    check_no_pending_step("restore");
+    profiler::ScopedTimer timer(profiler_, profiler::RESET);
+    if (!world_->is_analytical()) {
+        throw std::runtime_error("restoring a snapshot is only supported for analytical worlds");
+    }
+    if (snapshot.joint_values.size() != current_joint_values_.size()) {
+        throw std::runtime_error("snapshot was taken from a different robot");
+    }
+    // cheap reinit of the active slot, the background auto reset only uses the other one
+    tf::Transform gripper_goal = snapshot.gripper_goal;
+    gripper_planner_ = create_planner(active_planner_slot_,
+                                      snapshot.gmm_model_path,
+                                      snapshot.planner_goal_input,
+                                      gripper_goal,
+                                      snapshot.planner_initial_gripper,
+                                      snapshot.base_goal,
+                                      snapshot.planner_initial_base);
+    gripper_planner_->set_plan_state(snapshot.prev_plan);
+    gripper_planner_->set_time_offset(snapshot.gmm_time_offset);
+    planner_init_ = {snapshot.gmm_model_path, snapshot.planner_goal_input, snapshot.planner_initial_gripper, snapshot.planner_initial_base};
+
+    current_joint_values_ = snapshot.joint_values;
+    kinematic_state_->setJointGroupPositions(joint_model_group_, current_joint_values_);
+    currentBaseTransform_ = snapshot.base_transform;
+    currentGripperTransform_ = snapshot.gripper_transform;
+    rel_gripper_pose_ = snapshot.rel_gripper_pose;
+    currentGripperGOAL_ = snapshot.gripper_goal;
+    currentBaseGOAL_ = snapshot.base_goal;
+    planned_gripper_vel_ = snapshot.planned_gripper_vel;
+    planned_base_vel_ = snapshot.planned_base_vel;
+    set_pose_in_world(false);
+
+    time_ = snapshot.time;
+    time_planner_ = snapshot.time_planner;
+    reset_time_ = snapshot.reset_time;
+    set_goal_time_ = snapshot.set_goal_time;
+    start_pause_ = snapshot.start_pause;
+    success_thres_dist_ = snapshot.success_thres_dist;
+    success_thres_rot_ = snapshot.success_thres_rot;
+    ik_error_count_ = snapshot.ik_error_count;
+    ik_strategy_ = (ik_stats::IKStrategy)snapshot.ik_strategy;
+    episode_stats_.set_current_episode(snapshot.episode_stats);
+    rng_.set_state(snapshot.rng_state);
+    modulation_.setState(snapshot.ellipses, snapshot.ellipse_real_gamma);
+
+    // drop the path points and the displayed trajectory of the abandoned branch
+    if (snapshot.episode == episode_) {
+        if (pathPoints_.size() > snapshot.path_size) {
+            pathPoints_.resize(snapshot.path_size);
+        }
+        if (display_trajectory_.trajectory.size() > snapshot.display_trajectory_size) {
+            display_trajectory_.trajectory.resize(snapshot.display_trajectory_size);
+        }
+    }
+}
+
+std::vector<double> DynamicSystem_base::get_obs() {
+    check_no_pending_step("get_obs");
+    stop_control_thread();
+    return build_obs_vector(planned_base_vel_.vel_world, planned_gripper_vel_.vel_world, planned_gripper_vel_.dq);
+}
+
 // easiest way to know the dim without having to enforce that everything is already initialised
 int DynamicSystem_base::get_obs_dim() {
     return 22 + joint_names_.size();
@@ -480,6 +813,16 @@ std::vector<double> DynamicSystem_base::build_obs_vector(tf::Vector3 current_pla
                                                          tf::Vector3 current_planned_gripper_vel_world,
                                                          tf::Quaternion current_planned_gripper_vel_dq) {
     std::vector<double> obs_vector;
+    fill_obs_vector(obs_vector, current_planned_base_vel_world, current_planned_gripper_vel_world, current_planned_gripper_vel_dq);
+    return obs_vector;
+}
+
+void DynamicSystem_base::fill_obs_vector(std::vector<double> &obs_vector,
+                                         const tf::Vector3 &current_planned_base_vel_world,
+                                         const tf::Vector3 &current_planned_gripper_vel_world,
+                                         const tf::Quaternion &current_planned_gripper_vel_dq) {
+    profiler::ScopedTimer timer(profiler_, profiler::OBS);
+    obs_vector.clear();
     // whether to represent rotations as quaternions or euler angles
     bool use_euler = false;
 
@@ -488,21 +831,26 @@ std::vector<double> DynamicSystem_base::build_obs_vector(tf::Vector3 current_pla
     utils::add_rotation(obs_vector, rel_gripper_pose_.getRotation(), use_euler);
 
     // always provide the RL agent with the velocities normed to the time step used in training
-    GripperPlan next_plan_training = gripper_planner_->get_next_velocities(
-        time_planner_ / slow_down_factor_,
-        in_start_pause() ? 0.0 : time_step_train_,  // NOTE: should we include slow_down_factor_ here as well? -> SEEMS TO REDUCE PERFORMANCE FOR RELVEL, DIRVEL DOESN'T CARE
-        currentBaseTransform_,
-        currentGripperTransform_,
-        current_planned_base_vel_world,
-        current_planned_gripper_vel_world,
-        current_planned_gripper_vel_dq,
-        conf::min_planner_velocity,
-        conf::max_planner_velocity,
-        false);
-
-    // next planned gripper velocity
-    // Pass as obs the unconstrained velocities. For execution we will scale them into [min_planner_velocity_, max_planner_velocity_] range
-    PlannedVelocities planned_gripper_vel = gripper_planner_->transformToVelocity(currentGripperTransform_, next_plan_training.nextGripperTransform, currentBaseTransform_, 0.0);
+    GripperPlan next_plan_training;
+    PlannedVelocities planned_gripper_vel;
+    {
+        realtime::AllocationExempt planner_exempt;
+        next_plan_training = gripper_planner_->get_next_velocities(
+            time_planner_ / slow_down_factor_,
+            in_start_pause() ? 0.0 : time_step_train_,  // NOTE: should we include slow_down_factor_ here as well? -> SEEMS TO REDUCE PERFORMANCE FOR RELVEL, DIRVEL DOESN'T CARE
+            currentBaseTransform_,
+            currentGripperTransform_,
+            current_planned_base_vel_world,
+            current_planned_gripper_vel_world,
+            current_planned_gripper_vel_dq,
+            conf::min_planner_velocity,
+            conf::max_planner_velocity,
+            false);
+
+        // next planned gripper velocity
+        // Pass as obs the unconstrained velocities. For execution we will scale them into [min_planner_velocity_, max_planner_velocity_] range
+        planned_gripper_vel = gripper_planner_->transformToVelocity(currentGripperTransform_, next_plan_training.nextGripperTransform, currentBaseTransform_, 0.0);
+    }
     utils::add_vector3(obs_vector, planned_gripper_vel.vel_rel);
 
     // planned change in rotation
@@ -513,8 +861,8 @@ std::vector<double> DynamicSystem_base::build_obs_vector(tf::Vector3 current_pla
     utils::add_vector3(obs_vector, rel_gripper_goal.getOrigin());
     utils::add_rotation(obs_vector, rel_gripper_goal.getRotation(), use_euler);
 
-    // legacy to ensure compatibility of the trained checkpoints
-    obs_vector.push_back(0.0);
+    // legacy to ensure compatibility of the trained checkpoints. Optionally the anytime ik strategy of the last cycle
+    obs_vector.push_back((anytime_ik_enabled_ && strategy_in_obs_) ? (double)ik_strategy_ : 0.0);
 
     // current joint positions (8 values)
     for (int j = 0; j < current_joint_values_.size(); j++) {
@@ -524,7 +872,6 @@ std::vector<double> DynamicSystem_base::build_obs_vector(tf::Vector3 current_pla
     if (obs_vector.size() != get_obs_dim()) {
         throw std::runtime_error("get_obs_dim returning wrong value. Pls update.");
     }
-    return obs_vector;
 }
 
 // NOTE: the other parts of the reward (action regularization) happens in python
@@ -564,25 +911,90 @@ int DynamicSystem_base::calc_done_ret(bool found_ik, int max_allow_ik_errors) {
         }
         done_return = is_close ? 1 : 0;
     }
-    ROS_INFO_COND((done_return != 0) && (!world_->is_analytical()), "Episode finished with done_return %d and %d ik fails", done_return, ik_error_count_);
+    ROS_INFO_COND((done_return != 0) && (!world_->is_analytical()) && !realtime_, "Episode finished with done_return %d and %d ik fails", done_return, ik_error_count_);
     return done_return;
 }
 
 bool DynamicSystem_base::find_ik(const Eigen::Isometry3d &desiredState, const tf::Transform &desiredGripperTfWorld) {
     // kinematics::KinematicsQueryOptions ik_options;
     // ik_options.return_approximate_solution = true;
+    ik_stats_.begin_call();
+    bool success;
     if (perform_collision_check_) {
-        bool success = kinematic_state_->setFromIK(joint_model_group_, desiredState, 0.05, constraint_callback_fn_);
+        success = kinematic_state_->setFromIK(joint_model_group_, desiredState, 0.05, constraint_callback_fn_);
         if (!success) {
             // in case of a collision keep the current position
             // can apply this to any case of ik failure as moveit does not seem to set it to the next best solution anyway
             kinematic_state_->setJointGroupPositions(robo_config_.joint_model_group_name, current_joint_values_);
         }
-        return success;
     } else {
         // return kinematic_state_->setFromIK(joint_model_group_, desiredState, 5, 0.1, moveit::core::GroupStateValidityCallbackFn(), ik_options);
-        return kinematic_state_->setFromIK(joint_model_group_, desiredState, 0.05);
+        success = kinematic_state_->setFromIK(joint_model_group_, desiredState, 0.05);
+    }
+    ik_stats_.end_call(success);
+    return success;
+}
+
+anytime_ik::Result DynamicSystem_base::find_ik_anytime(const Eigen::Isometry3d &desiredState, double budget) {
+    ik_stats_.begin_call();
+    anytime_ik::Result result = anytime_ik_.solve(*kinematic_state_,
+                                                  joint_model_group_,
+                                                  robo_config_.global_link_transform,
+                                                  desiredState,
+                                                  current_joint_values_,
+                                                  budget,
+                                                  perform_collision_check_ ? constraint_callback_fn_ : moveit::core::GroupStateValidityCallbackFn());
+    // partial solutions are executed, only the fallback counts as failure like in the obs and the episode stats
+    ik_stats_.end_call(result.strategy != ik_stats::FALLBACK);
+    ik_stats_.add_strategy(result.strategy, result.pos_error);
+    return result;
+}
+
+double DynamicSystem_base::ik_budget() {
+    const double timeout = 0.05;
+    if (world_->is_analytical() || (lockstep_clock_ != NULL)) {
+        return timeout;
     }
+    // what is left of this cycle after the work since the last wake
+    const double period = rate_.expectedCycleTime().toSec(), last_wake = control_timing_.get_last_wake();
+    double remaining = period;
+    if (last_wake >= 0.0) {
+        remaining = last_wake + period - ros::Time::now().toSec();
+    }
+    return std::min(remaining - ik_send_reserve_, timeout);
+}
+
+void DynamicSystem_base::set_anytime_ik(bool enabled, double max_pos_error, double max_rot_error, double send_reserve, bool strategy_in_obs) {
+    check_no_pending_step("set_anytime_ik");
+    stop_control_thread();
+    anytime_ik::Config config = anytime_ik_.get_config();
+    config.max_pos_error = max_pos_error;
+    config.max_rot_error = max_rot_error;
+    anytime_ik_.set_config(config);
+    ik_send_reserve_ = send_reserve;
+    anytime_ik_enabled_ = enabled;
+    strategy_in_obs_ = strategy_in_obs;
+    ik_strategy_ = ik_stats::FULL_SOLVE;
+}
+
+void DynamicSystem_base::modulate_ellipse_velocity(tf::Vector3 planned_base_vel_rel, tf::Vector3 planned_gripper_vel_rel, const tf::Transform &desiredGripperTransform) {
+    planned_base_vel_rel *= slow_down_factor_;
+    planned_gripper_vel_rel *= slow_down_factor_;
+    // Need velocities in world frame
+    tf::Transform base_no_trans = currentBaseTransform_;
+    base_no_trans.setOrigin(tf::Vector3(0.0, 0.0, 0.0));
+
+    tf::Vector3 base_vel_wf = base_no_trans * planned_base_vel_rel;
+    tf::Vector3 gripper_vel_wf = base_no_trans * planned_gripper_vel_rel;
+
+    float base_rot_speed = 0.0001;
+    ellipse_speed_ << gripper_vel_wf.x(), gripper_vel_wf.y(), 0.0, 0.0, 0.0, 0.0, 0.0,
+                      base_vel_wf.x(), base_vel_wf.y(), 0.0, 0.0, 0.0, base_rot_speed, 0.0;
+    ellipse_pose_ << desiredGripperTransform.getOrigin().x(),desiredGripperTransform.getOrigin().y(), desiredGripperTransform.getOrigin().z(),
+                     desiredGripperTransform.getRotation().x(),desiredGripperTransform.getRotation().y(),desiredGripperTransform.getRotation().z(),desiredGripperTransform.getRotation().w(),
+                     currentBaseTransform_.getOrigin().x(),currentBaseTransform_.getOrigin().y(), currentBaseTransform_.getOrigin().z(),
+                     currentBaseTransform_.getRotation().x(),currentBaseTransform_.getRotation().y(),currentBaseTransform_.getRotation().z(),currentBaseTransform_.getRotation().w();
+    modulation_.run(ellipse_pose_, ellipse_speed_);
 }
 
 geometry_msgs::Twist DynamicSystem_base::calc_desired_base_transform(std::vector<double> &base_actions,
@@ -608,31 +1020,14 @@ geometry_msgs::Twist DynamicSystem_base::calc_desired_base_transform(std::vector
     double base_rotation = 0.0;
 
     if (strategy_ == "modulate_ellipse") {
-        // Need velocities in world frame
+        // modulated by modulate_ellipse_velocity() before this call
         tf::Transform base_no_trans = currentBaseTransform_;
         base_no_trans.setOrigin(tf::Vector3(0.0, 0.0, 0.0));
 
-        tf::Vector3 base_vel_wf = base_no_trans * planned_base_vel_rel;
-        tf::Vector3 gripper_vel_wf = base_no_trans * planned_gripper_vel_rel;
-
-        Eigen::VectorXf combined_pose(14);
-        Eigen::VectorXf combined_speed(14);
-        float base_rot_speed = 0.0001;
-        combined_speed << gripper_vel_wf.x(), gripper_vel_wf.y(), 0.0, 0.0, 0.0, 0.0, 0.0,
-                          base_vel_wf.x(), base_vel_wf.y(), 0.0, 0.0, 0.0, base_rot_speed, 0.0;
-        combined_pose << desiredGripperTransform.getOrigin().x(),desiredGripperTransform.getOrigin().y(), desiredGripperTransform.getOrigin().z(),
-                         desiredGripperTransform.getRotation().x(),desiredGripperTransform.getRotation().y(),desiredGripperTransform.getRotation().z(),desiredGripperTransform.getRotation().w(),
-                         currentBaseTransform_.getOrigin().x(),currentBaseTransform_.getOrigin().y(), currentBaseTransform_.getOrigin().z(),
-                         currentBaseTransform_.getRotation().x(),currentBaseTransform_.getRotation().y(),currentBaseTransform_.getRotation().z(),currentBaseTransform_.getRotation().w();
-        modulation_.run(combined_pose, combined_speed);
-
         // Transform back to robot frame
-        tf::Vector3 base_vel_rf = base_no_trans.inverse() * tf::Vector3(combined_speed(7), combined_speed(8), 0.0);
+        tf::Vector3 base_vel_rf = base_no_trans.inverse() * tf::Vector3(ellipse_speed_(7), ellipse_speed_(8), 0.0);
         base_vel_rel.setValue(base_vel_rf.x(), base_vel_rf.y(), 0.0);
-        base_rotation = utils::clamp_double(combined_speed(12) * 10.0, -base_rot_rng_t, base_rot_rng_t);
-
-        visualization_msgs::MarkerArray ma = modulation_.getEllipsesVisMarker(combined_pose, combined_speed);
-        ellipses_pub_.publish(ma);
+        base_rotation = utils::clamp_double(ellipse_speed_(12) * 10.0, -base_rot_rng_t, base_rot_rng_t);
     } else if (strategy_ == "unmodulated") {
         base_vel_rel.setValue(planned_base_vel_rel.x(),
                               planned_base_vel_rel.y(),
@@ -726,7 +1121,7 @@ geometry_msgs::Twist DynamicSystem_base::calc_desired_base_transform(std::vector
 double DynamicSystem_base::update_time(bool pause_gripper) {
     double dt;
     if ((!world_->is_analytical())) {
-        dt = (ros::Time::now().toSec() - time_);
+        dt = (world_time() - time_);
         // assume we call it in exactly the expected frequency?
         // dt = rate_.expectedCycleTime().toSec();
     } else {
@@ -745,131 +1140,319 @@ bool DynamicSystem_base::in_start_pause() {
     return (time_ - set_goal_time_) < start_pause_;
 }
 
-std::vector<double> DynamicSystem_base::step(int max_allow_ik_errors,
-                                             std::vector<double> base_actions,
-                                             double transition_noise_ee,
-                                             double transition_noise_base) {
-    PathPoint path_point;
-    bool pause_gripper = in_start_pause();
-
-    // utils::print_t(currentGripperTransform_, "currentGripperTransform_");
-    // utils::print_t(next_plan.nextGripperTransform, "next_plan.nextGripperTransform");
-
-    int action_repeat = (world_->is_analytical()) ? 1 : (time_step_real_exec_ / rate_.expectedCycleTime().toSec());
-
-    tf::Transform desiredGripperTransform, desiredBaseTransform, desired_gripper_pose_rel;
-    GripperPlan next_plan;
-    geometry_msgs::Twist base_cmd_rel;
-    bool found_ik;
-    bool collision = false;
-    double regularization = 0.0, last_dt;
-
-    for (int i = 0; i < action_repeat; i++) {
-        // plan velocities to be modulated and set in next step
-        last_dt = update_time(pause_gripper);
-        next_plan = gripper_planner_->get_next_velocities(time_planner_ / slow_down_factor_,
-                                                          last_dt / slow_down_factor_,
-                                                          currentBaseTransform_,
-                                                          currentGripperTransform_,
-                                                          planned_base_vel_.vel_world,
-                                                          planned_gripper_vel_.vel_world,
-                                                          planned_gripper_vel_.dq,
-                                                          conf::min_planner_velocity,
-                                                          conf::max_planner_velocity,
-                                                          !pause_gripper);
+DynamicSystem_base::ControlCycle DynamicSystem_base::control_cycle(std::vector<double> &base_actions,
+                                                                   double transition_noise_ee,
+                                                                   double transition_noise_base,
+                                                                   bool pause_gripper) {
+    profiler::ScopedTimer repeat_timer(profiler_, profiler::ACTION_REPEAT);
+    ControlCycle c;
+    // plan velocities to be modulated and set in next step
+    c.last_dt = update_time(pause_gripper);
+    {
+        profiler::ScopedTimer planner_timer(profiler_, profiler::PLANNER);
+        realtime::AllocationExempt planner_exempt;
+        c.next_plan = gripper_planner_->get_next_velocities(time_planner_ / slow_down_factor_,
+                                                            c.last_dt / slow_down_factor_,
+                                                            currentBaseTransform_,
+                                                            currentGripperTransform_,
+                                                            planned_base_vel_.vel_world,
+                                                            planned_gripper_vel_.vel_world,
+                                                            planned_gripper_vel_.dq,
+                                                            conf::min_planner_velocity,
+                                                            conf::max_planner_velocity,
+                                                            !pause_gripper);
         if (transition_noise_ee > 0.0001) {
             tf::Vector3 noise_vec = tf::Vector3(rng_.gaussian(0.0, transition_noise_ee), rng_.gaussian(0.0, transition_noise_ee), rng_.gaussian(0.0, transition_noise_ee));
-            next_plan.nextGripperTransform.setOrigin(next_plan.nextGripperTransform.getOrigin() + noise_vec);
-        }
-        if (i == 0) {
-            utils::pathPoint_insert_transform(path_point, "planned_gripper", next_plan.nextGripperTransform);
-            utils::pathPoint_insert_transform(path_point, "planned_base", next_plan.nextBaseTransform, true);
+            c.next_plan.nextGripperTransform.setOrigin(c.next_plan.nextGripperTransform.getOrigin() + noise_vec);
         }
+        c.planned_gripper = c.next_plan.nextGripperTransform;
+        c.planned_base = c.next_plan.nextBaseTransform;
 
         // constrain by base_vel_rng, not gripper planner max vel so that we could theoretically still catch up
         // must come before we update the currentGripperTransform_
         // even if pause_gripper, still calculate the originally planned one, because with relvel we still want to move the base relative to this originally planned speed(?)
         planned_gripper_vel_ = gripper_planner_->transformToVelocity(currentGripperTransform_,
-                                                                     next_plan.nextGripperTransform,
+                                                                     c.next_plan.nextGripperTransform,
                                                                      currentBaseTransform_,
                                                                      robo_config_.base_vel_rng);
         planned_base_vel_ = gripper_planner_->transformToVelocity(currentBaseTransform_,
-                                                                  next_plan.nextBaseTransform,
+                                                                  c.next_plan.nextBaseTransform,
                                                                   currentBaseTransform_,
                                                                   robo_config_.base_vel_rng);
+    }
+
+    if (pause_gripper) {
+        c.next_plan = gripper_planner_->get_prev_plan();
+    }
+    // set new gripper pose (optimistically assume it will be achieved, updating it again after trying to execute the ik)
+    const tf::Transform desiredGripperTransform = c.next_plan.nextGripperTransform;
 
-        if (pause_gripper) {
-            next_plan = gripper_planner_->get_prev_plan();
+    // ellipse modulation of the planned velocities, timed apart from the base transform
+    if (strategy_ == "modulate_ellipse") {
+        {
+            profiler::ScopedTimer modulation_timer(profiler_, profiler::MODULATION);
+            realtime::AllocationExempt modulation_exempt;
+            modulate_ellipse_velocity(planned_base_vel_.vel_rel, planned_gripper_vel_.vel_rel, desiredGripperTransform);
+        }
+        if (!realtime_) {
+            profiler::ScopedTimer vis_timer(profiler_, profiler::VISUALIZATION);
+            visualization_msgs::MarkerArray ma = modulation_.getEllipsesVisMarker(ellipse_pose_, ellipse_speed_);
+            ellipses_pub_.publish(ma);
         }
-        // set new gripper pose (optimistically assume it will be achieved, updating it again after trying to execute the ik)
-        desiredGripperTransform = next_plan.nextGripperTransform;
-
-        // apply the RL actions to the base, updating desiredBaseTransform while holding the velocity constraints
-        base_cmd_rel = calc_desired_base_transform(base_actions,
-                                                   planned_base_vel_.vel_rel,
-                                                   next_plan.nextBaseTransform.getRotation(),
-                                                   planned_gripper_vel_.vel_rel,
-                                                   desiredBaseTransform,
-                                                   transition_noise_base,
-                                                   regularization,
-                                                   last_dt,
-                                                   desiredGripperTransform);
-        // std::cout << "base_cmd_rel.linear.x: " << base_cmd_rel.linear.x << " , base_cmd_rel.linear.y: " << base_cmd_rel.linear.y << " , base_cmd_rel.angular.z: " <<
-        // base_cmd_rel.angular.z << std::endl;
-
-        // Update relative positions of the base, gripper and gripper_goal to the base (optimistically assume it will be achieved, updating it again after trying to execute the ik)
-        desired_gripper_pose_rel = desiredBaseTransform.inverse() * desiredGripperTransform;
-        //if (world_->is_analytical()){
-        //    desired_gripper_pose_rel = desiredBaseTransform.inverse() * desiredGripperTransform;
-        //} else {
-        //    desired_gripper_pose_rel = currentBaseTransform_.inverse() * desiredGripperTransform;
-        //}
+    }
+
+    // apply the RL actions to the base, updating desiredBaseTransform while holding the velocity constraints
+    {
+        profiler::ScopedTimer base_timer(profiler_, profiler::BASE_TRANSFORM);
+        c.base_cmd_rel = calc_desired_base_transform(base_actions,
+                                                     planned_base_vel_.vel_rel,
+                                                     c.next_plan.nextBaseTransform.getRotation(),
+                                                     planned_gripper_vel_.vel_rel,
+                                                     c.desired_base,
+                                                     transition_noise_base,
+                                                     c.regularization,
+                                                     c.last_dt,
+                                                     desiredGripperTransform);
+    }
+    // std::cout << "base_cmd_rel.linear.x: " << base_cmd_rel.linear.x << " , base_cmd_rel.linear.y: " << base_cmd_rel.linear.y << " , base_cmd_rel.angular.z: " <<
+    // base_cmd_rel.angular.z << std::endl;
+
+    // Update relative positions of the base, gripper and gripper_goal to the base (optimistically assume it will be achieved, updating it again after trying to execute the ik)
+    c.desired_gripper_rel = c.desired_base.inverse() * desiredGripperTransform;
+    //if (world_->is_analytical()){
+    //    desired_gripper_pose_rel = desiredBaseTransform.inverse() * desiredGripperTransform;
+    //} else {
+    //    desired_gripper_pose_rel = currentBaseTransform_.inverse() * desiredGripperTransform;
+    //}
+    if (!realtime_) {
+        profiler::ScopedTimer vis_timer(profiler_, profiler::VISUALIZATION);
         gripper_visualizer_.publish(
             create_vel_marker(currentGripperTransform_, 20 * (desiredGripperTransform.getOrigin() - currentGripperTransform_.getOrigin()), "gripper_vel", "cyan", 0));
-        gripper_visualizer_.publish(create_vel_marker(currentBaseTransform_, 20 * (desiredBaseTransform.getOrigin() - currentBaseTransform_.getOrigin()), "base_vel", "cyan", 0));
+        gripper_visualizer_.publish(create_vel_marker(currentBaseTransform_, 20 * (c.desired_base.getOrigin() - currentBaseTransform_.getOrigin()), "base_vel", "cyan", 0));
+    }
 
-        // Perform IK checks
-        Eigen::Isometry3d state;
-        tf::poseTFToEigen(desired_gripper_pose_rel, state);
-        const Eigen::Isometry3d &desiredState = state;
-        found_ik = find_ik(desiredState, desiredGripperTransform);
+    // Perform IK checks
+    Eigen::Isometry3d state;
+    tf::poseTFToEigen(c.desired_gripper_rel, state);
+    const Eigen::Isometry3d &desiredState = state;
+    {
+        profiler::ScopedTimer ik_timer(profiler_, profiler::IK);
+        realtime::AllocationExempt ik_exempt;
+        if (anytime_ik_enabled_) {
+            anytime_ik::Result ik = find_ik_anytime(desiredState, ik_budget());
+            c.found_ik = (ik.strategy != ik_stats::FALLBACK);
+            c.ik_strategy = ik.strategy;
+            c.ik_pos_error = ik.pos_error;
+            c.ik_rot_error = ik.rot_error;
+            ik_strategy_ = ik.strategy;
+        } else {
+            c.found_ik = find_ik(desiredState, desiredGripperTransform);
+        }
         kinematic_state_->copyJointGroupPositions(joint_model_group_, current_joint_values_);
+    }
 
-        if ((!world_->is_analytical())) {
-            rate_.sleep();
-            send_arm_command(current_joint_values_, 0.1);
-            cmd_base_vel_pub_.publish(base_cmd_rel);
-        };
-
-        if (!found_ik) {
-            ik_error_count_++;
-            // planning_scene_monitor_->getPlanningScene()->getCurrentState().copyJointGroupPositions(joint_model_group_, current_joint_values_);
+    if ((!world_->is_analytical())) {
+        profiler::ScopedTimer exec_timer(profiler_, profiler::EXECUTION);
+        if (lockstep_clock_ == NULL) {
+            control_timing_.sleep_start(ros::Time::now().toSec());
+            bool met_deadline = rate_.sleep();
+            control_timing_.wake(ros::Time::now().toSec(), met_deadline);
         }
-        // update state to what we actually achieve
-        // a) base: without execution we'll always be at the next base transform
-        if (world_->is_analytical()) {
-            currentBaseTransform_ = desiredBaseTransform;
+        if (realtime_) {
+            // copies into the preallocated slot, publishing happens on the command thread
+            RobotCommand &command = command_mailbox_.back();
+            command.arm = arm_streamer_.update(current_joint_values_, 0.1, rate_.expectedCycleTime().toSec());
+            command.base = c.base_cmd_rel;
+            command_mailbox_.publish();
         } else {
-            currentBaseTransform_ = world_->get_base_transform_world();
+            if (stream_arm_commands_) {
+                stream_arm_command(arm_streamer_.update(current_joint_values_, 0.1, rate_.expectedCycleTime().toSec()));
+            } else {
+                send_arm_command(current_joint_values_, 0.1);
+            }
+            cmd_base_vel_pub_.publish(c.base_cmd_rel);
         }
-        // b) gripper: update kinematic state from planning scene and run forward kinematics to get achieved currentGripperTransform_
+        if (lockstep_clock_ != NULL) {
+            // let the simulation run for exactly one cycle with these commands, the state is read below
+            lockstep_clock_->advance(rate_.expectedCycleTime().toSec());
+        } else {
+            const double sent = ros::Time::now().toSec();
+            control_timing_.command_sent(sent);
+            if (state_cache_ != NULL) {
+                double delay;
+                if (state_cache_->take_feedback_sample_delay(delay)) {
+                    control_timing_.add_feedback_sample_delay(delay);
+                }
+                state_cache_->mark_command(sent);
+            }
+        }
+    };
+
+    if (!c.found_ik) {
+        ik_error_count_++;
+        // planning_scene_monitor_->getPlanningScene()->getCurrentState().copyJointGroupPositions(joint_model_group_, current_joint_values_);
+    }
+    // update state to what we actually achieve
+    // a) base: without execution we'll always be at the next base transform
+    if (world_->is_analytical()) {
+        currentBaseTransform_ = c.desired_base;
+    } else {
+        profiler::ScopedTimer exec_timer(profiler_, profiler::EXECUTION);
+        currentBaseTransform_ = world_->get_base_transform_world();
+    }
+    // b) gripper: update kinematic state from planning scene and run forward kinematics to get achieved currentGripperTransform_
+    {
+        profiler::ScopedTimer fk_timer(profiler_, profiler::FK);
         const Eigen::Affine3d &end_effector_state_rel = kinematic_state_->getGlobalLinkTransform(robo_config_.global_link_transform);
         tf::transformEigenToTF(end_effector_state_rel, rel_gripper_pose_);
         currentGripperTransform_ = currentBaseTransform_ * rel_gripper_pose_;
-        // update_current_gripper_from_world();
+    }
+    // update_current_gripper_from_world();
+
+    // there seems to be an incompatibility with some geometries leading to occasional segfaults within planning_scene::PlanningScene::checkCollisionUnpadded
+    // if (init_controllers_){
+    //     c.collision |= check_scene_collisions();
+    // }
+    // checked asynchronously on a private copy of the scene instead. A collision is reported in the cycle its check finished
+    if (collision_monitor_ != NULL) {
+        collision_monitor_->post(current_joint_values_, currentBaseTransform_);
+        bool collision;
+        if (collision_monitor_->take_collision(collision)) {
+            ik_stats_.add_scene_collision_check(collision);
+            c.collision |= collision;
+        }
+    }
+
+    if (!realtime_) {
+        add_trajectory_point(c.next_plan, c.found_ik);
+    }
+    return c;
+}
+
+void DynamicSystem_base::record_step(PathPoint &path_point,
+                                     const ControlCycle &cycle,
+                                     const tf::Vector3 &planned_gripper_pos,
+                                     const tf::Vector3 &prev_gripper_pos,
+                                     const tf::Vector3 &prev_base_pos,
+                                     int done_ret) {
+    if ((done_ret != 0) && profiler_.is_tracing() && !trace_dump_dir_.empty() && !realtime_) {
+        dump_trace(trace_dump_dir_ + "/trace_" + robo_config_.name + "_" + std::to_string(episode_) + ".json");
+    }
+
+    // visualisation etc. Not recorded in real-time mode, the map allocates
+    if (!realtime_) {
+        utils::pathPoint_insert_transform(path_point, "base", currentBaseTransform_, true);
+        utils::pathPoint_insert_transform(path_point, "desired_base", cycle.desired_base, true);
+        path_point["base_cmd_linear_x"] = cycle.base_cmd_rel.linear.x;
+        path_point["base_cmd_linear_y"] = cycle.base_cmd_rel.linear.y;
+        path_point["base_cmd_angular_z"] = cycle.base_cmd_rel.angular.z;
+        utils::pathPoint_insert_transform(path_point, "gripper", currentGripperTransform_);
+        utils::pathPoint_insert_transform(path_point, "gripper_rel", rel_gripper_pose_);
+        utils::pathPoint_insert_transform(path_point, "desired_gripper_rel", cycle.desired_gripper_rel);
+        path_point["ik_fail"] = !cycle.found_ik;
+        if (anytime_ik_enabled_) {
+            path_point["ik_strategy"] = cycle.ik_strategy;
+            path_point["ik_pos_error"] = cycle.ik_pos_error;
+            path_point["ik_rot_error"] = cycle.ik_rot_error;
+        }
+        path_point["dt"] = cycle.last_dt;
+        path_point["collision"] = cycle.collision;
+        pathPoints_.push_back(path_point);
+    }
+
+    episode_stats::Step stats_step;
+    stats_step.ik_fail = !cycle.found_ik;
+    stats_step.collision = cycle.collision;
+    stats_step.dist_to_sol = currentGripperTransform_.getOrigin().distance(planned_gripper_pos);
+    stats_step.gripper_dist = currentGripperTransform_.getOrigin().distance(prev_gripper_pos);
+    stats_step.base_dist = currentBaseTransform_.getOrigin().distance(prev_base_pos);
+    stats_step.rel_x = rel_gripper_pose_.getOrigin().x();
+    stats_step.rel_y = rel_gripper_pose_.getOrigin().y();
+    stats_step.rel_z = rel_gripper_pose_.getOrigin().z();
+    episode_stats_.add_step(stats_step);
+    if (done_ret != 0) {
+        episode_stats_.end_episode(done_ret == 1, get_dist_to_goal());
+        if (!world_->is_analytical() && !realtime_) {
+            std::map<std::string, double> timing = control_timing_.get_summary();
+            ROS_INFO("Control loop: %d cycles, %d deadline misses, cycle time p50 %.4f / p99 %.4f s, jitter p99 %.4f s, feedback sample delay p50 %.4f s",
+                     (int)timing["episode_cycles"],
+                     (int)timing["episode_deadline_misses"],
+                     timing["cycle_time_p50"],
+                     timing["cycle_time_p99"],
+                     timing["jitter_p99"],
+                     timing["feedback_sample_delay_p50"]);
+            if (!trace_dump_dir_.empty()) {
+                control_timing_.dump_csv(trace_dump_dir_ + "/timing_" + robo_config_.name + "_" + std::to_string(episode_) + ".csv");
+            }
+        }
+    }
+}
 
-        // there seems to be an incompatibility with some geometries leading to occasional segfaults within planning_scene::PlanningScene::checkCollisionUnpadded
-        // if (init_controllers_){
-        //     collision |= check_scene_collisions();
-        // }
+std::vector<double> DynamicSystem_base::finish_step(std::vector<double> obs_vector) {
+    const int obs_dim = get_obs_dim();
+    if ((obs_vector[obs_dim + 1] != 0) && auto_reset_) {
+        // [first obs of the new episode, reward, done, ik fails, terminal obs of the finished episode]
+        std::vector<double> new_obs = auto_reset();
+        new_obs.insert(new_obs.end(), obs_vector.begin() + obs_dim, obs_vector.end());
+        new_obs.insert(new_obs.end(), obs_vector.begin(), obs_vector.begin() + obs_dim);
+        return new_obs;
+    }
+    return obs_vector;
+}
 
-        add_trajectory_point(next_plan, found_ik);
+void DynamicSystem_base::check_no_pending_step(const char *caller) const {
+    if (pending_step_.valid()) {
+        throw std::runtime_error(std::string(caller) + "() called before step_wait() returned the pending step");
     }
+}
+
+std::vector<double> DynamicSystem_base::step(int max_allow_ik_errors,
+                                             std::vector<double> base_actions,
+                                             double transition_noise_ee,
+                                             double transition_noise_base) {
+    check_no_pending_step("step");
+    return run_step(max_allow_ik_errors, base_actions, transition_noise_ee, transition_noise_base);
+}
+
+std::vector<double> DynamicSystem_base::run_step(int max_allow_ik_errors,
+                                                 std::vector<double> base_actions,
+                                                 double transition_noise_ee,
+                                                 double transition_noise_base) {
+    if (control_thread_enabled_ && !world_->is_analytical() && (lockstep_clock_ == NULL)) {
+        return finish_step(step_control_thread(max_allow_ik_errors, base_actions, transition_noise_ee, transition_noise_base));
+    }
+    profiler::ScopedTimer step_timer(profiler_, profiler::STEP);
+    PathPoint path_point;
+    bool pause_gripper = in_start_pause();
+
+    // utils::print_t(currentGripperTransform_, "currentGripperTransform_");
+    // utils::print_t(next_plan.nextGripperTransform, "next_plan.nextGripperTransform");
+
+    int action_repeat = (world_->is_analytical()) ? 1 : (time_step_real_exec_ / rate_.expectedCycleTime().toSec());
+    const tf::Vector3 prev_gripper_pos = currentGripperTransform_.getOrigin(), prev_base_pos = currentBaseTransform_.getOrigin();
+    tf::Vector3 planned_gripper_pos;
+
+    ControlCycle cycle;
+    double regularization = 0.0;
+    bool collision = false;
+    for (int i = 0; i < action_repeat; i++) {
+        cycle = control_cycle(base_actions, transition_noise_ee, transition_noise_base, pause_gripper);
+        regularization += cycle.regularization;
+        // a collision reported in any of the repeated cycles
+        collision |= cycle.collision;
+        if (i == 0) {
+            planned_gripper_pos = cycle.planned_gripper.getOrigin();
+            utils::pathPoint_insert_transform(path_point, "planned_gripper", cycle.planned_gripper);
+            utils::pathPoint_insert_transform(path_point, "planned_base", cycle.planned_base, true);
+        }
+    }
+
+    cycle.collision = collision;
 
     // reward and check if episode has finished -> Distance gripper to goal
     // found_ik &= get_arm_success();
-    double reward = calc_reward(found_ik, regularization);
-    int done_ret = calc_done_ret(found_ik, max_allow_ik_errors);
+    double reward = calc_reward(cycle.found_ik, regularization);
+    int done_ret = calc_done_ret(cycle.found_ik, max_allow_ik_errors);
 
     // build the observation return
     std::vector<double> obs_vector = build_obs_vector(planned_base_vel_.vel_world, planned_gripper_vel_.vel_world, planned_gripper_vel_.dq);
@@ -877,21 +1460,258 @@ std::vector<double> DynamicSystem_base::step(int max_allow_ik_errors,
     obs_vector.push_back(done_ret);
     obs_vector.push_back(ik_error_count_);
 
-    // visualisation etc
-    utils::pathPoint_insert_transform(path_point, "base", currentBaseTransform_, true);
-    utils::pathPoint_insert_transform(path_point, "desired_base", desiredBaseTransform, true);
-    path_point["base_cmd_linear_x"] = base_cmd_rel.linear.x;
-    path_point["base_cmd_linear_y"] = base_cmd_rel.linear.y;
-    path_point["base_cmd_angular_z"] = base_cmd_rel.angular.z;
-    utils::pathPoint_insert_transform(path_point, "gripper", currentGripperTransform_);
-    utils::pathPoint_insert_transform(path_point, "gripper_rel", rel_gripper_pose_);
-    utils::pathPoint_insert_transform(path_point, "desired_gripper_rel", desired_gripper_pose_rel);
-    path_point["ik_fail"] = !found_ik;
-    path_point["dt"] = last_dt;
-    path_point["collision"] = collision;
-    pathPoints_.push_back(path_point);
+    record_step(path_point, cycle, planned_gripper_pos, prev_gripper_pos, prev_base_pos, done_ret);
+    return finish_step(obs_vector);
+}
 
-    return obs_vector;
+void DynamicSystem_base::control_loop() {
+    ControlCommand command;
+    uint64_t cycles = 0;
+    double reward_total = 0.0;
+    try {
+        if (realtime_) {
+            realtime::configure_current_thread(realtime_priority_, realtime_cpu_);
+            realtime::prefault_stack();
+        }
+        rate_.reset();
+        while (control_running_.load(std::memory_order_relaxed)) {
+            // keep the last action if no new one was posted
+            action_mailbox_.read(command);
+            PathPoint path_point;
+            const tf::Vector3 prev_gripper_pos = currentGripperTransform_.getOrigin(), prev_base_pos = currentBaseTransform_.getOrigin();
+            ControlCycle cycle = control_cycle(command.base_actions, command.transition_noise_ee, command.transition_noise_base, in_start_pause());
+            if (!realtime_) {
+                utils::pathPoint_insert_transform(path_point, "planned_gripper", cycle.planned_gripper);
+                utils::pathPoint_insert_transform(path_point, "planned_base", cycle.planned_base, true);
+            }
+            double reward = calc_reward(cycle.found_ik, cycle.regularization);
+            int done_ret = calc_done_ret(cycle.found_ik, command.max_allow_ik_errors);
+            record_step(path_point, cycle, cycle.planned_gripper.getOrigin(), prev_gripper_pos, prev_base_pos, done_ret);
+            reward_total += reward;
+
+            ControlObs &obs = obs_mailbox_.back();
+            fill_obs_vector(obs.retval, planned_base_vel_.vel_world, planned_gripper_vel_.vel_world, planned_gripper_vel_.dq);
+            obs.retval.push_back(reward);
+            obs.retval.push_back(done_ret);
+            obs.retval.push_back(ik_error_count_);
+            obs.cycle = ++cycles;
+            obs.reward_total = reward_total;
+            obs_mailbox_.publish();
+            if (done_ret != 0) {
+                // stand still until the next episode starts. After the last cycle, so it may allocate
+                realtime::AllocationExempt stop_exempt;
+                cmd_base_vel_pub_.publish(geometry_msgs::Twist());
+                break;
+            }
+        }
+    } catch (...) {
+        control_error_ = std::current_exception();
+        control_failed_.store(true, std::memory_order_release);
+    }
+}
+
+void DynamicSystem_base::command_loop() {
+    while (control_running_.load(std::memory_order_relaxed)) {
+        if (command_mailbox_.update()) {
+            stream_arm_command(command_mailbox_.front().arm);
+            cmd_base_vel_pub_.publish(command_mailbox_.front().base);
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
+
+void DynamicSystem_base::preallocate_control_buffers() {
+    // sized at construction and whenever the streamed trajectory changes, so that the copies within the control cycles do
+    // not allocate. Only while the control thread is stopped
+    const int retval_size = get_obs_dim() + 3;
+    obs_mailbox_.for_each_slot([retval_size](ControlObs &obs) { obs.retval.reserve(retval_size); });
+    const trajectory_msgs::JointTrajectory &arm = arm_streamer_.get_trajectory();
+    command_mailbox_.for_each_slot([&arm](RobotCommand &command) { command.arm = arm; });
+}
+
+void DynamicSystem_base::start_control_thread() {
+    control_failed_ = false;
+    // drop an observation of a previous run that was not read
+    obs_mailbox_.update();
+    reward_read_ = 0.0;
+    if (realtime_) {
+        command_mailbox_.update();
+    }
+    control_running_ = true;
+    if (realtime_) {
+        command_thread_ = std::thread(&DynamicSystem_base::command_loop, this);
+    }
+    control_thread_ = std::thread(&DynamicSystem_base::control_loop, this);
+}
+
+void DynamicSystem_base::stop_control_thread() {
+    control_running_ = false;
+    if (control_thread_.joinable()) {
+        control_thread_.join();
+    }
+    if (command_thread_.joinable()) {
+        command_thread_.join();
+    }
+}
+
+void DynamicSystem_base::set_control_thread(bool enabled) {
+    check_no_pending_step("set_control_thread");
+    stop_control_thread();
+    control_thread_enabled_ = enabled;
+    // real-time mode relies on the control thread
+    if (realtime_ && !enabled) {
+        realtime::unlock_memory();
+    }
+    realtime_ &= enabled;
+}
+
+void DynamicSystem_base::set_realtime(bool enabled, int priority, int cpu) {
+    check_no_pending_step("set_realtime");
+    stop_control_thread();
+    if (enabled) {
+        realtime::lock_memory();
+        // actionlib goals allocate and block on the action client, so the real-time path is the control thread with streamed commands
+        control_thread_enabled_ = true;
+        stream_arm_commands_ = true;
+    } else if (realtime_) {
+        realtime::unlock_memory();
+    }
+    realtime_ = enabled;
+    realtime_priority_ = priority;
+    realtime_cpu_ = cpu;
+}
+
+double DynamicSystem_base::world_time() {
+    return (lockstep_clock_ != NULL) ? lockstep_clock_->now() : ros::Time::now().toSec();
+}
+
+void DynamicSystem_base::set_lockstep(bool enabled) {
+    check_no_pending_step("set_lockstep");
+    stop_control_thread();
+    if (enabled && (lockstep_clock_ == NULL)) {
+        if (world_->get_name() != "gazebo") {
+            throw std::runtime_error("Lockstep mode is only supported in gazebo");
+        }
+        if (!ros::Time::isSimTime()) {
+            throw std::runtime_error("Lockstep mode requires /use_sim_time");
+        }
+        lockstep_clock_ = new sim_clock::LockstepClock(*ns_nh_, "/clock", "/gazebo/pause_physics", "/gazebo/unpause_physics");
+        lockstep_clock_->pause();
+    } else if (!enabled && (lockstep_clock_ != NULL)) {
+        lockstep_clock_->unpause();
+        delete lockstep_clock_;
+        lockstep_clock_ = NULL;
+    }
+}
+
+void DynamicSystem_base::set_stream_arm_commands(bool enabled, int n_lookahead) {
+    check_no_pending_step("set_stream_arm_commands");
+    stop_control_thread();
+    arm_streamer_.init(joint_names_, n_lookahead);
+    preallocate_control_buffers();
+    stream_arm_commands_ = enabled;
+    // real-time mode relies on streamed commands
+    if (realtime_ && !enabled) {
+        realtime::unlock_memory();
+    }
+    realtime_ &= enabled;
+}
+
+std::vector<double> DynamicSystem_base::step_control_thread(int max_allow_ik_errors,
+                                                            const std::vector<double> &base_actions,
+                                                            double transition_noise_ee,
+                                                            double transition_noise_base) {
+    ControlCommand &command = action_mailbox_.back();
+    command.base_actions = base_actions;
+    command.max_allow_ik_errors = max_allow_ik_errors;
+    command.transition_noise_ee = transition_noise_ee;
+    command.transition_noise_base = transition_noise_base;
+    action_mailbox_.publish();
+    if (!control_thread_.joinable()) {
+        start_control_thread();
+    }
+    // newest observation. Only waits if the previous call already returned the latest one, i.e. for at most one cycle
+    while (!obs_mailbox_.update()) {
+        if (control_failed_.load(std::memory_order_acquire)) {
+            stop_control_thread();
+            std::rethrow_exception(control_error_);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    const ControlObs &obs = obs_mailbox_.front();
+    std::vector<double> retval = obs.retval;
+    // rewards of all cycles since the last call, not only of the newest one
+    retval[get_obs_dim()] = obs.reward_total - reward_read_;
+    reward_read_ = obs.reward_total;
+    if (retval[get_obs_dim() + 1] != 0) {
+        // the thread stops once done, join it before the caller touches the env again
+        stop_control_thread();
+    }
+    return retval;
+}
+
+std::pair<Eigen::MatrixXd, std::vector<double>> DynamicSystem_base::rollout(int max_steps,
+                                                                            int max_allow_ik_errors,
+                                                                            const Eigen::MatrixXd &base_actions,
+                                                                            double transition_noise_ee,
+                                                                            double transition_noise_base) {
+    check_no_pending_step("rollout");
+    bool zero_actions = (base_actions.rows() == 0);
+    if (!zero_actions && (base_actions.rows() < max_steps)) {
+        throw std::runtime_error("rollout needs one row of base actions per step");
+    }
+    // zero actions: the baseline for unmodulated and modulate_ellipse (which ignore the actions) and plain planner following for relvel
+    std::vector<double> actions(zero_actions ? 3 : base_actions.cols(), 0.0);
+    int obs_dim = get_obs_dim();
+    Eigen::MatrixXd result(max_steps, obs_dim + 3);
+    std::vector<double> next_episode_obs;
+
+    int n = 0;
+    while (n < max_steps) {
+        if (!zero_actions) {
+            for (int j = 0; j < base_actions.cols(); j++) {
+                actions[j] = base_actions(n, j);
+            }
+        }
+        std::vector<double> retval = run_step(max_allow_ik_errors, actions, transition_noise_ee, transition_noise_base);
+        // after an auto reset the terminal obs of the finished episode is appended, store that one
+        int obs_start = 0;
+        if ((int)retval.size() > obs_dim + 3) {
+            obs_start = obs_dim + 3;
+            next_episode_obs.assign(retval.begin(), retval.begin() + obs_dim);
+        }
+        for (int j = 0; j < obs_dim; j++) {
+            result(n, j) = retval[obs_start + j];
+        }
+        for (int j = 0; j < 3; j++) {
+            result(n, obs_dim + j) = retval[obs_dim + j];
+        }
+        n++;
+        if (retval[obs_dim + 1] != 0) {
+            break;
+        }
+    }
+    result.conservativeResize(n, Eigen::NoChange);
+    return std::make_pair(result, next_episode_obs);
+}
+
+void DynamicSystem_base::step_async(int max_allow_ik_errors,
+                                    std::vector<double> base_actions,
+                                    double transition_noise_ee,
+                                    double transition_noise_base) {
+    if (pending_step_.valid()) {
+        throw std::runtime_error("step_async() called before step_wait() returned the previous step");
+    }
+    pending_step_ = std::async(std::launch::async, &DynamicSystem_base::run_step, this, max_allow_ik_errors, base_actions, transition_noise_ee, transition_noise_base);
+}
+
+std::vector<double> DynamicSystem_base::step_wait() {
+    if (!pending_step_.valid()) {
+        throw std::runtime_error("step_wait() called without a pending step_async()");
+    }
+    // rethrows exceptions of step()
+    return pending_step_.get();
 }
 
 std_msgs::ColorRGBA DynamicSystem_base::get_ik_color(double alpha = 1.0) {
@@ -909,6 +1729,7 @@ void DynamicSystem_base::add_trajectory_point(const GripperPlan &next_plan, bool
     if (!verbose_) {
         return;
     }
+    profiler::ScopedTimer timer(profiler_, profiler::TRAJECTORY);
     // plans
     double nthpoint = (world_->is_analytical()) ? (1.0 / time_step_train_) : (1.0 / (time_step_real_exec_));
     if (((pathPoints_.size() % (int)nthpoint) == 0) || !found_ik) {
@@ -963,6 +1784,8 @@ void DynamicSystem_base::add_trajectory_point(const GripperPlan &next_plan, bool
 }
 
 std::vector<PathPoint> DynamicSystem_base::visualize_robot_pose(std::string logfile) {
+    check_no_pending_step("visualize_robot_pose");
+    stop_control_thread();
     // Visualize the current gripper goal in color of
     visualization_msgs::Marker goal_marker = utils::marker_from_transform(currentGripperGOAL_, "gripper_goal", "blue", 1.0, marker_counter_, robo_config_.frame_id);
 
@@ -1019,13 +1842,19 @@ void DynamicSystem_base::close_gripper(double position, bool wait_for_result) {
 }
 
 void DynamicSystem_base::update_current_gripper_from_world() {
-    if ((!world_->is_analytical())) {
-        // update kinematic_state_ and current_joint_values_
+    if ((!world_->is_analytical()) && (state_cache_ != NULL) && state_cache_->get_joint_values(current_joint_values_)) {
+        // update kinematic_state_ and current_joint_values_ from the newest joint_states, no service round trip
+        kinematic_state_->setJointGroupPositions(joint_model_group_, current_joint_values_);
+        if (perform_collision_check_) {
+            state_cache_->update_world(planning_scene_);
+        }
+    } else if ((!world_->is_analytical())) {
+        // nothing received yet: ask move_group
         moveit_msgs::GetPlanningScene scene_srv1;
         moveit_msgs::PlanningScene currentScene;
         scene_srv1.request.components.components = 2;  // moveit_msgs::PlanningSceneComponents::ROBOT_STATE;
         if (!client_get_scene_.call(scene_srv1)) {
-            ROS_WARN("Failed to call service /get_planning_scene");
+            ROS_WARN("Failed to call service %s", client_get_scene_.getService().c_str());
         }
         planning_scene_->setPlanningSceneDiffMsg(scene_srv1.response.scene);
 
@@ -1051,17 +1880,40 @@ void DynamicSystem_base::update_current_gripper_from_world() {
     currentGripperTransform_ = currentBaseTransform_ * rel_gripper_pose_;
 }
 
-bool DynamicSystem_base::set_pose_in_world() {
+bool DynamicSystem_base::move_to(const std::vector<double> &joint_values,
+                                 double exec_duration,
+                                 double gripper_position,
+                                 bool close_gripper,
+                                 double timeout) {
+    const bool with_gripper = !std::isnan(gripper_position);
+    send_arm_command(joint_values, exec_duration);
+    if (with_gripper) {
+        send_gripper_command(gripper_position, close_gripper);
+    }
+    const ros::Time deadline = ros::Time::now() + ros::Duration(timeout);
+    const bool success = wait_for_arm(deadline);
+    // a gripper that stalls on an object or finishes late is not a failed start pose
+    if (with_gripper && !wait_for_gripper(deadline)) {
+        ROS_WARN("gripper did not reach %.3f within %.1f s", gripper_position, timeout);
+    }
+    return success;
+}
+
+bool DynamicSystem_base::set_pose_in_world(bool do_close_gripper) {
     // set base
     world_->set_model_state(robo_config_.name, currentBaseTransform_, robo_config_, cmd_base_vel_pub_);
     // arm: use controllers
     bool success = true;
     if (!world_->is_analytical()) {
         ROS_INFO("Setting gripper to start");
-        send_arm_command(current_joint_values_, 5.0);
-        success = get_arm_success();
+        // the gripper closes while the arm moves, both within the same 10 s
+        success = move_to(current_joint_values_, 5.0, do_close_gripper ? 0.0 : NAN, true, 10.0);
         ROS_WARN_COND(!success, "couldn't set arm to selected start pose");
     }
+    if (lockstep_clock_ != NULL) {
+        // set_model_state() unpaused the physics to move the arm, hold the start state until the first step
+        lockstep_clock_->pause();
+    }
     return success;
 }
 
@@ -1094,6 +1946,7 @@ void DynamicSystem_base::setAllowedCollisionMatrix(planning_scene::PlanningScene
 }
 
 bool DynamicSystem_base::check_scene_collisions() {
+    profiler::ScopedTimer timer(profiler_, profiler::COLLISION_CHECK);
     planning_scene::PlanningScenePtr planning_scene = planning_scene_monitor_->getPlanningScene();
 
     // change it only on a copy!
@@ -1110,6 +1963,7 @@ bool DynamicSystem_base::check_scene_collisions() {
     // planning_scene->setCurrentState(*kinematic_state_);
     // planning_scene->checkCollision(collision_request, collision_result, *kinematic_state_, acm_);
     planning_scene->checkCollisionUnpadded(collision_request, collision_result, state_copy, acm_);
+    ik_stats_.add_scene_collision_check(collision_result.collision);
 
     if (collision_result.collision) {
         // ROS_WARN("Collision with scene! N collisions: %d", collision_result.contacts.size());
@@ -1154,8 +2008,11 @@ visualization_msgs::Marker DynamicSystem_base::create_vel_marker(tf::Transform c
 namespace validityFun {
     bool validityCallbackFn(planning_scene::PlanningScenePtr &planning_scene,
                             robot_state::RobotStatePtr kinematic_state,
+                            profiler::Profiler *profiler,
+                            ik_stats::IKStats *ik_stats,
                             const robot_state::JointModelGroup *joint_model_group,
                             const double *joint_group_variable_values) {
+        profiler::ScopedTimer timer(*profiler, profiler::COLLISION_CHECK);
         kinematic_state->setJointGroupPositions(joint_model_group, joint_group_variable_values);
         // Now check for collisions
         collision_detection::CollisionRequest collision_request;
@@ -1165,6 +2022,7 @@ namespace validityFun {
         planning_scene->getCurrentStateNonConst().update();
         planning_scene->checkCollisionUnpadded(collision_request, collision_result, *kinematic_state);
         // planning_scene->checkSelfCollision(collision_request, collision_result, *kinematic_state);
+        ik_stats->add_validity_check(!collision_result.collision);
 
         if (collision_result.collision) {
             // ROS_INFO("IK solution is in collision!");
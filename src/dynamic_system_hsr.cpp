@@ -34,6 +34,7 @@ const RoboConf hsr_config{.name = "hsrb",
                           .neutral_pos_values = {0.2, -0.7, 0.0, -1.2, 0.0},
                           // not double checked yet
                           .base_cmd_topic = "/hsrb/command_velocity",
+                          .odom_topic = "/hsrb/odom",
                           .base_vel_rng = 0.2,
                           .base_rot_rng = 1.5,
                           .z_min = 0.2,
@@ -261,15 +262,8 @@ void DynamicSystemHSR::send_arm_command(const std::vector<double> &target_joint_
     arm_client_->sendGoal(arm_goal_);
 }
 
-bool DynamicSystemHSR::get_arm_success() {
-    arm_client_->waitForResult(ros::Duration(10.0));
-    if (arm_client_->getState() != actionlib::SimpleClientGoalState::SUCCEEDED) {
-        ROS_WARN("The arm_client_ failed.");
-        // throw std::runtime_error("The arm_client_ failed.");
-        return false;
-    } else {
-        return true;
-    }
+bool DynamicSystemHSR::wait_for_arm(const ros::Time &deadline) {
+    return goal_wait::wait_until(*arm_client_, deadline, "arm");
 }
 
 void DynamicSystemHSR::open_gripper(double position, bool wait_for_result) {
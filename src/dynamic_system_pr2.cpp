@@ -13,7 +13,8 @@ const RoboConf pr2_config{
     .neutral_pos_values = {0.359647, 1.22538, 0.0, -1.59997, 2.34256, -0.513323, -2.41144},
     // https://github.com/uu-isrc-robotics/uu-isrc-robotics-pr2-pkgs/blob/master/pr2_control_utilities/src/pr2_control_utilities/pr2_planning.py
     // "r_gripper_tool_joint", "r_gripper_palm_joint", "r_gripper_led_joint", "r_gripper_motor_accelerometer_joint"
-    .base_cmd_topic = "/base_controller/command",
+    .base_cmd_topic = "base_controller/command",
+    .odom_topic = "base_odometry/odom",
     .base_vel_rng = 0.2,
     .base_rot_rng = 1.0,
     .z_min = 0.2,
@@ -31,7 +32,9 @@ DynamicSystemPR2::DynamicSystemPR2(uint32_t seed,
                                    double penalty_scaling,
                                    double time_step,
                                    double slow_down_real_exec,
-                                   bool perform_collision_check) :
+                                   bool perform_collision_check,
+                                   std::string node_name,
+                                   std::string ros_namespace) :
     DynamicSystem_base(seed,
                        min_goal_dist,
                        max_goal_dist,
@@ -42,20 +45,22 @@ DynamicSystemPR2::DynamicSystemPR2(uint32_t seed,
                        time_step,
                        slow_down_real_exec,
                        perform_collision_check,
-                       pr2_config) {
+                       pr2_config,
+                       node_name,
+                       ros_namespace) {
     setup();
 };
 
 void DynamicSystemPR2::setup() {
     if (init_controllers_) {
-        arm_client_ = new TrajClientPR2("r_arm_controller/joint_trajectory_action", true);
+        arm_client_ = new TrajClientPR2(*ns_nh_, "r_arm_controller/joint_trajectory_action", true);
         while (!arm_client_->waitForServer(ros::Duration(5.0))) {
             ROS_INFO("Waiting for the r_arm_controller/joint_trajectory_action action server to come up");
         }
 
         // switch_controller_client_ = nh_->serviceClient<pr2_mechanism_msgs::SwitchController>("/pr2_controller_manager/switch_controller");
         // not sure yet if want to do this for real execution only or always
-        gripper_client_ = new GripperClientPR2("r_gripper_controller/gripper_action", true);
+        gripper_client_ = new GripperClientPR2(*ns_nh_, "r_gripper_controller/gripper_action", true);
         while (!gripper_client_->waitForServer(ros::Duration(5.0))) {
             ROS_INFO("Waiting for the r_gripper_controller/gripper_action action server to come up");
         }
@@ -64,6 +69,9 @@ void DynamicSystemPR2::setup() {
         arm_goal_.trajectory.joint_names.resize(joint_names_.size());
         arm_goal_.trajectory.points[0].positions.resize(joint_names_.size());
         arm_goal_.trajectory.points[0].velocities.resize(joint_names_.size());
+
+        // for set_stream_arm_commands()
+        arm_command_pub_ = ns_nh_->advertise<trajectory_msgs::JointTrajectory>("r_arm_controller/command", 1);
     }
 }
 
@@ -83,37 +91,39 @@ void DynamicSystemPR2::send_arm_command(const std::vector<double> &target_joint_
     arm_client_->sendGoal(arm_goal_);
 }
 
-bool DynamicSystemPR2::get_arm_success() {
-    arm_client_->waitForResult(ros::Duration(10.0));
-    if (arm_client_->getState() != actionlib::SimpleClientGoalState::SUCCEEDED) {
-        ROS_WARN("The arm_client_ failed.");
-        // throw std::runtime_error("The arm_client_ failed.");
-        return false;
-    } else {
-        return true;
-    }
+void DynamicSystemPR2::stream_arm_command(const trajectory_msgs::JointTrajectory &traj) {
+    arm_command_pub_.publish(traj);
+}
+
+bool DynamicSystemPR2::wait_for_arm(const ros::Time &deadline) {
+    return goal_wait::wait_until(*arm_client_, deadline, "arm");
 }
 
 // http://library.isr.ist.utl.pt/docs/roswiki/pr2_controllers(2f)Tutorials(2f)Moving(20)the(20)gripper.html
-void DynamicSystemPR2::move_gripper(double position, double effort, bool wait_for_result) {
+void DynamicSystemPR2::send_gripper_command(double position, bool close) {
     pr2_controllers_msgs::Pr2GripperCommandGoal goal;
     goal.command.position = position;
-    goal.command.max_effort = effort;
+    // close gently, do not limit the effort when opening (negative)
+    goal.command.max_effort = close ? 200.0 : -1.0;
     gripper_client_->sendGoal(goal);
+}
 
-    if (wait_for_result) {
-        gripper_client_->waitForResult(ros::Duration(5.0));
-        if (gripper_client_->getState() != actionlib::SimpleClientGoalState::SUCCEEDED)
-            ROS_WARN("The gripper failed.");
-    }
+bool DynamicSystemPR2::wait_for_gripper(const ros::Time &deadline) {
+    return goal_wait::wait_until(*gripper_client_, deadline, "gripper");
 }
 
 void DynamicSystemPR2::open_gripper(double position, bool wait_for_result) {
-    move_gripper(position, -1.0, wait_for_result);  // Do not limit effort (negative)
+    send_gripper_command(position, false);
+    if (wait_for_result) {
+        wait_for_gripper(ros::Time::now() + ros::Duration(5.0));
+    }
 }
 
 void DynamicSystemPR2::close_gripper(double position, bool wait_for_result) {
-    move_gripper(position, 200.0, wait_for_result);  // Close gently
+    send_gripper_command(position, true);
+    if (wait_for_result) {
+        wait_for_gripper(ros::Time::now() + ros::Duration(5.0));
+    }
 }
 
 // void DynamicSystemPR2::stop_controllers(){
@@ -1,45 +1,255 @@
 // #include <modulation_rl/dynamic_system_hsr.h>
 #include <modulation_rl/dynamic_system_pr2.h>
 #include <modulation_rl/dynamic_system_tiago.h>
+#include <modulation_rl/control_timing.h>
+#include <modulation_rl/env_snapshot.h>
+#include <modulation_rl/episode_stats.h>
+#include <modulation_rl/ik_stats.h>
+#include <modulation_rl/modulation_ellipses.h>
+#include <modulation_rl/profiler.h>
+#include <modulation_rl/shm_vec_env.h>
+#include <modulation_rl/socket_vec_env.h>
+#include <pybind11/eigen.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 namespace py = pybind11;
 
+// The control thread mutates the env state, stop it (the next step() restarts it) before reading that state
+void stop_control_thread(DynamicSystem_base &env, const char *caller) {
+    env.check_no_pending_step(caller);
+    py::gil_scoped_release release;
+    env.stop_control_thread();
+}
+
+// summary statistics per phase plus the raw log2 histogram. bucket_edges are the upper edges of the buckets in seconds
+py::dict profile_to_dict(const profiler::Profiler &prof) {
+    py::dict d;
+    std::map<std::string, std::map<std::string, double>> summary = prof.get_summary();
+    for (int i = 0; i < profiler::N_PHASES; i++) {
+        const profiler::Histogram &h = prof.get_histogram((profiler::Phase)i);
+        if (h.count == 0) {
+            continue;
+        }
+        py::dict phase = py::cast(summary[profiler::phase_name((profiler::Phase)i)]);
+        phase["histogram"] = std::vector<uint64_t>(h.buckets.begin(), h.buckets.end());
+        d[profiler::phase_name((profiler::Phase)i)] = phase;
+    }
+    std::vector<double> edges;
+    for (int i = 0; i < profiler::Histogram::N_BUCKETS; i++) {
+        edges.push_back(pow(2.0, i + 1) * 1e-6);
+    }
+    d["bucket_edges"] = edges;
+    return d;
+}
+
+// ik counters and latencies, keyed with the robot and strategy they were collected for
+py::dict ik_stats_to_dict(const DynamicSystem_base &env) {
+    const ik_stats::IKStats &stats = env.get_ik_stats();
+    py::dict d = py::cast(stats.get_summary());
+    d["robot"] = env.get_robot_name();
+    d["strategy"] = env.get_strategy();
+    d["time_to_solution_histogram"] = std::vector<uint64_t>(stats.get_time_to_solution().buckets.begin(), stats.get_time_to_solution().buckets.end());
+    d["time_to_failure_histogram"] = std::vector<uint64_t>(stats.get_time_to_failure().buckets.begin(), stats.get_time_to_failure().buckets.end());
+    d["partial_pos_error_histogram"] = std::vector<uint64_t>(stats.get_partial_pos_error().buckets.begin(), stats.get_partial_pos_error().buckets.end());
+    return d;
+}
+
+// totals over the ended episodes, the last and the running episode and the ik failure histograms. The xy histograms are
+// N_XY_BINS x N_XY_BINS matrices indexed [x bin, y bin]
+py::dict episode_stats_to_dict(const DynamicSystem_base &env) {
+    using namespace episode_stats;
+    const EpisodeStats &stats = env.get_episode_stats();
+    py::dict d = py::cast(stats.get_summary());
+    d["last_episode"] = stats.get_last();
+    d["current_episode"] = stats.get_current();
+    d["kin_fails_hist"] = std::vector<uint64_t>(stats.get_kin_fails_hist().begin(), stats.get_kin_fails_hist().end());
+    Eigen::MatrixXd xy_steps(N_XY_BINS, N_XY_BINS), xy_fails(N_XY_BINS, N_XY_BINS);
+    for (int i = 0; i < N_XY_BINS; i++) {
+        for (int j = 0; j < N_XY_BINS; j++) {
+            xy_steps(i, j) = stats.get_rel_xy_steps()[i * N_XY_BINS + j];
+            xy_fails(i, j) = stats.get_rel_xy_fails()[i * N_XY_BINS + j];
+        }
+    }
+    d["rel_xy_steps"] = xy_steps;
+    d["rel_xy_fails"] = xy_fails;
+    d["rel_z_steps"] = std::vector<uint64_t>(stats.get_rel_z_steps().begin(), stats.get_rel_z_steps().end());
+    d["rel_z_fails"] = std::vector<uint64_t>(stats.get_rel_z_fails().begin(), stats.get_rel_z_fails().end());
+    d["rel_xy_range"] = REL_XY_RANGE;
+    d["z_max"] = Z_MAX;
+    return d;
+}
+
+// counters and percentiles, the log2 histograms (edges as in get_profile()) and the cycles in the ring buffer as an n x 6 matrix
+// with the columns cycle_columns
+py::dict control_timing_to_dict(const DynamicSystem_base &env) {
+    const control_timing::ControlTiming &timing = env.get_control_timing();
+    py::dict d = py::cast(timing.get_summary());
+    d["cycle_time_histogram"] = std::vector<uint64_t>(timing.get_cycle_time().buckets.begin(), timing.get_cycle_time().buckets.end());
+    d["jitter_histogram"] = std::vector<uint64_t>(timing.get_jitter().buckets.begin(), timing.get_jitter().buckets.end());
+    d["work_histogram"] = std::vector<uint64_t>(timing.get_work().buckets.begin(), timing.get_work().buckets.end());
+    d["send_histogram"] = std::vector<uint64_t>(timing.get_send().buckets.begin(), timing.get_send().buckets.end());
+    d["feedback_sample_delay_histogram"] = std::vector<uint64_t>(timing.get_feedback_sample_delay().buckets.begin(), timing.get_feedback_sample_delay().buckets.end());
+    std::vector<control_timing::CycleRecord> cycles = timing.get_cycles();
+    Eigen::MatrixXd m(cycles.size(), 6);
+    for (int i = 0; i < cycles.size(); i++) {
+        m.row(i) << cycles[i].wake, cycles[i].period, cycles[i].work, cycles[i].send, cycles[i].feedback_sample_delay, (double)cycles[i].deadline_miss;
+    }
+    d["cycles"] = m;
+    d["cycle_columns"] = std::vector<std::string>{"wake", "period", "work", "send", "feedback_sample_delay", "deadline_miss"};
+    return d;
+}
+
+// the native work (ik timeouts, rate_.sleep() in real execution, waiting for controllers) does not touch python objects,
+// so other python threads can run meanwhile. Arguments and return values are converted while holding the GIL
+using release_gil = py::call_guard<py::gil_scoped_release>;
+
 PYBIND11_MODULE(dynamic_system_py, m) {
     py::class_<DynamicSystemPR2>(m, "PR2Env")
-        .def(py::init<uint32_t, double, double, std::string, std::string, bool, double, double, double, bool>())
-        .def("step", &DynamicSystemPR2::step, "Execute the next time step in environment.")
-        .def("reset", &DynamicSystemPR2::reset, "Reset environment.")
-        .def("visualize", &DynamicSystemPR2::visualize_robot_pose, "Visualize trajectory.")
-        .def("get_obs", &DynamicSystemPR2::build_obs_vector, "Get current obs.")
+        .def(py::init<uint32_t, double, double, std::string, std::string, bool, double, double, double, bool, std::string, std::string>())
+        .def("step", &DynamicSystemPR2::step, "Execute the next time step in environment.", release_gil())
+        .def("step_async", &DynamicSystemPR2::step_async, "Start the next time step on a background thread.")
+        .def("step_wait", &DynamicSystemPR2::step_wait, "Wait for the step started by step_async() and return its result.", release_gil())
+        .def("rollout", &DynamicSystemPR2::rollout, "Execute up to k time steps in one call, stopping once done.", release_gil())
+        .def("reset", &DynamicSystemPR2::reset, "Reset environment.", release_gil())
+        .def("visualize", &DynamicSystemPR2::visualize_robot_pose, "Visualize trajectory.", release_gil())
+        .def("get_obs", &DynamicSystemPR2::get_obs, "Get current obs.", release_gil())
         .def("get_obs_dim", &DynamicSystemPR2::get_obs_dim, "Get size of the obs vector.")
-        .def("get_dist_to_goal", &DynamicSystemPR2::get_dist_to_goal, "Get distance to gripper goal.")
-        .def("get_rot_dist_to_goal", &DynamicSystemPR2::get_rot_dist_to_goal, "Get rotational distance to gripper goal.")
-        .def("set_gripper_goal", &DynamicSystemPR2::set_gripper_goal, "Set a new goal for the gripper (in world coordinates).")
-        .def("add_goal_marker", &DynamicSystemPR2::add_goal_marker, "Add a goal marker.")
-        .def("set_real_execution", &DynamicSystemPR2::set_real_execution, "set_real_execution.")
+        .def("get_dist_to_goal", [](DynamicSystemPR2 &self) { stop_control_thread(self, "get_dist_to_goal"); return self.get_dist_to_goal(); }, "Get distance to gripper goal.")
+        .def("get_rot_dist_to_goal", [](DynamicSystemPR2 &self) { stop_control_thread(self, "get_rot_dist_to_goal"); return self.get_rot_dist_to_goal(); }, "Get rotational distance to gripper goal.")
+        .def("set_gripper_goal", &DynamicSystemPR2::set_gripper_goal, "Set a new goal for the gripper (in world coordinates).", release_gil())
+        .def("add_goal_marker", [](DynamicSystemPR2 &self, std::vector<double> pos, int marker_id, std::string color) { self.check_no_pending_step("add_goal_marker"); self.add_goal_marker(pos, marker_id, color); }, "Add a goal marker.")
+        .def("set_real_execution", &DynamicSystemPR2::set_real_execution, "set_real_execution.", release_gil())
         .def("get_real_execution", &DynamicSystemPR2::get_real_execution, "get_real_execution.")
         .def("get_slow_down_factor", &DynamicSystemPR2::get_slow_down_factor, "get_slow_down_factor.")
-        .def("open_gripper", &DynamicSystemPR2::open_gripper, "Open the gripper.")
-        .def("close_gripper", &DynamicSystemPR2::close_gripper, "Close the gripper.");
+        .def("open_gripper", [](DynamicSystemPR2 &self, double position, bool wait_for_result) { self.check_no_pending_step("open_gripper"); self.open_gripper(position, wait_for_result); }, "Open the gripper.", release_gil())
+        .def("close_gripper", [](DynamicSystemPR2 &self, double position, bool wait_for_result) { self.check_no_pending_step("close_gripper"); self.close_gripper(position, wait_for_result); }, "Close the gripper.", release_gil())
+        .def("set_profiling", &DynamicSystemPR2::set_profiling, "Switch the per-phase timers of step() and reset() on or off.", release_gil())
+        .def("get_profile", [](DynamicSystemPR2 &self) { stop_control_thread(self, "get_profile"); return profile_to_dict(self.get_profiler()); }, "Get the per-phase timings.")
+        .def("reset_profile", &DynamicSystemPR2::reset_profile, "Clear the per-phase timings.", release_gil())
+        .def("set_tracing", &DynamicSystemPR2::set_tracing, "Record a trace of the step phases. If dump_dir is not empty, write it there at the end of each episode.",
+             py::arg("enabled"), py::arg("dump_dir") = "", release_gil())
+        .def("dump_trace", [](DynamicSystemPR2 &self, std::string filename) { self.check_no_pending_step("dump_trace"); self.dump_trace(filename); }, "Write the recorded trace as chrome trace json and clear it.", release_gil())
+        .def("get_ik_stats", [](DynamicSystemPR2 &self) { stop_control_thread(self, "get_ik_stats"); return ik_stats_to_dict(self); }, "Get the ik call counters, failure reasons and latencies.")
+        .def("reset_ik_stats", &DynamicSystemPR2::reset_ik_stats, "Clear the ik statistics.", release_gil())
+        .def("get_episode_stats", [](DynamicSystemPR2 &self) { stop_control_thread(self, "get_episode_stats"); return episode_stats_to_dict(self); }, "Get the per-episode and aggregated episode metrics.")
+        .def("reset_episode_stats", &DynamicSystemPR2::reset_episode_stats, "Clear the episode metrics.", release_gil())
+        .def("get_control_timing", [](DynamicSystemPR2 &self) { stop_control_thread(self, "get_control_timing"); return control_timing_to_dict(self); }, "Get the cycle times, deadline misses and feedback sample delays of the control loop.")
+        .def("reset_control_timing", &DynamicSystemPR2::reset_control_timing, "Clear the control loop timings.", release_gil())
+        .def("set_auto_reset", &DynamicSystemPR2::set_auto_reset, "Prepare the next episode in the background and start it directly from step() once the current one is done.")
+        .def("get_auto_reset", &DynamicSystemPR2::get_auto_reset, "get_auto_reset.")
+        .def("set_control_thread", &DynamicSystemPR2::set_control_thread, "Run the real / gazebo control loop at a fixed rate on its own thread, step() only posts the newest action.", release_gil())
+        .def("get_control_thread", &DynamicSystemPR2::get_control_thread, "get_control_thread.")
+        .def("set_stream_arm_commands", &DynamicSystemPR2::set_stream_arm_commands, "Stream multi-point JointTrajectory messages to the controller command topics instead of one-point actionlib goals.", release_gil())
+        .def("get_stream_arm_commands", &DynamicSystemPR2::get_stream_arm_commands, "get_stream_arm_commands.")
+        .def("set_realtime", &DynamicSystemPR2::set_realtime, "Real-time mode for real execution: locked memory, SCHED_FIFO control thread, no allocations or I/O in the control cycles.", release_gil())
+        .def("get_realtime", &DynamicSystemPR2::get_realtime, "get_realtime.")
+        .def("set_lockstep", &DynamicSystemPR2::set_lockstep, "Gazebo only: advance the paused simulation by exactly one control cycle per inner step.", release_gil())
+        .def("get_lockstep", &DynamicSystemPR2::get_lockstep, "get_lockstep.")
+        .def("set_anytime_ik", &DynamicSystemPR2::set_anytime_ik, "Per-cycle ik budget with partial solutions and holding the current joints as fallback.", release_gil())
+        .def("get_anytime_ik", &DynamicSystemPR2::get_anytime_ik, "get_anytime_ik.")
+        .def("snapshot", &DynamicSystemPR2::snapshot, "Capture the current state to branch from it.")
+        .def("restore", &DynamicSystemPR2::restore, "Continue from a snapshot.", release_gil());
 
     py::class_<DynamicSystemTiago>(m, "TiagoEnv")
-        .def(py::init<uint32_t, double, double, std::string, std::string, bool, double, double, double, bool>())
-        .def("step", &DynamicSystemTiago::step, "Execute the next time step in environment.")
-        .def("reset", &DynamicSystemTiago::reset, "Reset environment.")
-        .def("visualize", &DynamicSystemTiago::visualize_robot_pose, "Visualize trajectory.")
-        .def("get_obs", &DynamicSystemTiago::build_obs_vector, "Get current obs.")
+        .def(py::init<uint32_t, double, double, std::string, std::string, bool, double, double, double, bool, std::string, std::string>())
+        .def("step", &DynamicSystemTiago::step, "Execute the next time step in environment.", release_gil())
+        .def("step_async", &DynamicSystemTiago::step_async, "Start the next time step on a background thread.")
+        .def("step_wait", &DynamicSystemTiago::step_wait, "Wait for the step started by step_async() and return its result.", release_gil())
+        .def("rollout", &DynamicSystemTiago::rollout, "Execute up to k time steps in one call, stopping once done.", release_gil())
+        .def("reset", &DynamicSystemTiago::reset, "Reset environment.", release_gil())
+        .def("visualize", &DynamicSystemTiago::visualize_robot_pose, "Visualize trajectory.", release_gil())
+        .def("get_obs", &DynamicSystemTiago::get_obs, "Get current obs.", release_gil())
         .def("get_obs_dim", &DynamicSystemTiago::get_obs_dim, "Get size of the obs vector.")
-        .def("get_dist_to_goal", &DynamicSystemTiago::get_dist_to_goal, "Get distance to gripper goal.")
-        .def("get_rot_dist_to_goal", &DynamicSystemTiago::get_rot_dist_to_goal, "Get rotational distance to gripper goal.")
-        .def("set_gripper_goal", &DynamicSystemTiago::set_gripper_goal, "Set a new goal for the gripper (in world coordinates).")
-        .def("add_goal_marker", &DynamicSystemTiago::add_goal_marker, "Add a goal marker.")
-        .def("set_real_execution", &DynamicSystemTiago::set_real_execution, "set_real_execution.")
+        .def("get_dist_to_goal", [](DynamicSystemTiago &self) { stop_control_thread(self, "get_dist_to_goal"); return self.get_dist_to_goal(); }, "Get distance to gripper goal.")
+        .def("get_rot_dist_to_goal", [](DynamicSystemTiago &self) { stop_control_thread(self, "get_rot_dist_to_goal"); return self.get_rot_dist_to_goal(); }, "Get rotational distance to gripper goal.")
+        .def("set_gripper_goal", &DynamicSystemTiago::set_gripper_goal, "Set a new goal for the gripper (in world coordinates).", release_gil())
+        .def("add_goal_marker", [](DynamicSystemTiago &self, std::vector<double> pos, int marker_id, std::string color) { self.check_no_pending_step("add_goal_marker"); self.add_goal_marker(pos, marker_id, color); }, "Add a goal marker.")
+        .def("set_real_execution", &DynamicSystemTiago::set_real_execution, "set_real_execution.", release_gil())
         .def("get_real_execution", &DynamicSystemTiago::get_real_execution, "get_real_execution.")
         .def("get_slow_down_factor", &DynamicSystemTiago::get_slow_down_factor, "get_slow_down_factor.")
-        .def("open_gripper", &DynamicSystemTiago::open_gripper, "Open the gripper.")
-        .def("close_gripper", &DynamicSystemTiago::close_gripper, "Close the gripper.");
+        .def("open_gripper", [](DynamicSystemTiago &self, double position, bool wait_for_result) { self.check_no_pending_step("open_gripper"); self.open_gripper(position, wait_for_result); }, "Open the gripper.", release_gil())
+        .def("close_gripper", [](DynamicSystemTiago &self, double position, bool wait_for_result) { self.check_no_pending_step("close_gripper"); self.close_gripper(position, wait_for_result); }, "Close the gripper.", release_gil())
+        .def("set_profiling", &DynamicSystemTiago::set_profiling, "Switch the per-phase timers of step() and reset() on or off.", release_gil())
+        .def("get_profile", [](DynamicSystemTiago &self) { stop_control_thread(self, "get_profile"); return profile_to_dict(self.get_profiler()); }, "Get the per-phase timings.")
+        .def("reset_profile", &DynamicSystemTiago::reset_profile, "Clear the per-phase timings.", release_gil())
+        .def("set_tracing", &DynamicSystemTiago::set_tracing, "Record a trace of the step phases. If dump_dir is not empty, write it there at the end of each episode.",
+             py::arg("enabled"), py::arg("dump_dir") = "", release_gil())
+        .def("dump_trace", [](DynamicSystemTiago &self, std::string filename) { self.check_no_pending_step("dump_trace"); self.dump_trace(filename); }, "Write the recorded trace as chrome trace json and clear it.", release_gil())
+        .def("get_ik_stats", [](DynamicSystemTiago &self) { stop_control_thread(self, "get_ik_stats"); return ik_stats_to_dict(self); }, "Get the ik call counters, failure reasons and latencies.")
+        .def("reset_ik_stats", &DynamicSystemTiago::reset_ik_stats, "Clear the ik statistics.", release_gil())
+        .def("get_episode_stats", [](DynamicSystemTiago &self) { stop_control_thread(self, "get_episode_stats"); return episode_stats_to_dict(self); }, "Get the per-episode and aggregated episode metrics.")
+        .def("reset_episode_stats", &DynamicSystemTiago::reset_episode_stats, "Clear the episode metrics.", release_gil())
+        .def("get_control_timing", [](DynamicSystemTiago &self) { stop_control_thread(self, "get_control_timing"); return control_timing_to_dict(self); }, "Get the cycle times, deadline misses and feedback sample delays of the control loop.")
+        .def("reset_control_timing", &DynamicSystemTiago::reset_control_timing, "Clear the control loop timings.", release_gil())
+        .def("set_auto_reset", &DynamicSystemTiago::set_auto_reset, "Prepare the next episode in the background and start it directly from step() once the current one is done.")
+        .def("get_auto_reset", &DynamicSystemTiago::get_auto_reset, "get_auto_reset.")
+        .def("set_control_thread", &DynamicSystemTiago::set_control_thread, "Run the real / gazebo control loop at a fixed rate on its own thread, step() only posts the newest action.", release_gil())
+        .def("get_control_thread", &DynamicSystemTiago::get_control_thread, "get_control_thread.")
+        .def("set_stream_arm_commands", &DynamicSystemTiago::set_stream_arm_commands, "Stream multi-point JointTrajectory messages to the controller command topics instead of one-point actionlib goals.", release_gil())
+        .def("get_stream_arm_commands", &DynamicSystemTiago::get_stream_arm_commands, "get_stream_arm_commands.")
+        .def("set_realtime", &DynamicSystemTiago::set_realtime, "Real-time mode for real execution: locked memory, SCHED_FIFO control thread, no allocations or I/O in the control cycles.", release_gil())
+        .def("get_realtime", &DynamicSystemTiago::get_realtime, "get_realtime.")
+        .def("set_lockstep", &DynamicSystemTiago::set_lockstep, "Gazebo only: advance the paused simulation by exactly one control cycle per inner step.", release_gil())
+        .def("get_lockstep", &DynamicSystemTiago::get_lockstep, "get_lockstep.")
+        .def("set_anytime_ik", &DynamicSystemTiago::set_anytime_ik, "Per-cycle ik budget with partial solutions and holding the current joints as fallback.", release_gil())
+        .def("get_anytime_ik", &DynamicSystemTiago::get_anytime_ik, "get_anytime_ik.")
+        .def("snapshot", &DynamicSystemTiago::snapshot, "Capture the current state to branch from it.")
+        .def("restore", &DynamicSystemTiago::restore, "Continue from a snapshot.", release_gil());
+
+    py::class_<env_snapshot::Snapshot>(m, "EnvSnapshot")
+        .def(py::init<>())
+        .def_readonly("episode", &env_snapshot::Snapshot::episode)
+        .def_readonly("time", &env_snapshot::Snapshot::time)
+        .def_readonly("ik_error_count", &env_snapshot::Snapshot::ik_error_count)
+        .def("save", [](const env_snapshot::Snapshot &self, std::string filename) { env_snapshot::save(self, filename); }, "Write the snapshot to a file.")
+        .def_static("load", &env_snapshot::load, "Read a snapshot written by save().");
+
+    py::class_<ShmVecEnv>(m, "ShmVecEnv")
+        .def(py::init<std::vector<std::string>, uint32_t, uint32_t>(), "Create one shm channel per name, each served by a modulation_rl_env_server process.",
+             py::arg("channel_names"), py::arg("n_slots") = 2, py::arg("slot_capacity") = 256)
+        .def("wait_for_servers", &ShmVecEnv::wait_for_servers, "Wait until every channel has a server, false on timeout.", release_gil())
+        .def("get_num_envs", &ShmVecEnv::get_num_envs, "get_num_envs.")
+        .def("get_obs_dim", &ShmVecEnv::get_obs_dim, "Size of the obs vector, -1 before the first reset.")
+        .def("reset", &ShmVecEnv::reset, "Reset the envs selected by mask (default: all), returns num_envs x obs_dim with NaN rows for the others.",
+             py::arg("mask") = std::vector<bool>(), release_gil())
+        .def("step", &ShmVecEnv::step, "Step all envs with one row of base actions each, returns num_envs x [obs, reward, done, ik fails, terminal obs].",
+             release_gil())
+        .def("step_async", &ShmVecEnv::step_async, "Send the next step to all envs without waiting.")
+        .def("step_wait", &ShmVecEnv::step_wait, "Wait for the step started by step_async().", release_gil())
+        .def("close", &ShmVecEnv::close, "Stop the servers.", release_gil());
+
+    py::class_<SocketVecEnv>(m, "SocketVecEnv")
+        .def(py::init<std::vector<std::string>, double>(), "Connect to modulation_rl_socket_server processes at host:port or unix:/path.",
+             py::arg("addresses"), py::arg("connect_timeout") = 60.0, release_gil())
+        .def("get_num_envs", &SocketVecEnv::get_num_envs, "Total number of envs of all servers.")
+        .def("get_obs_dim", &SocketVecEnv::get_obs_dim, "get_obs_dim.")
+        .def("get_num_in_flight", &SocketVecEnv::get_num_in_flight, "Number of step batches sent but not waited for.")
+        .def("reset", &SocketVecEnv::reset, "Reset the envs selected by mask (default: all), returns num_envs x obs_dim with NaN rows for the others.",
+             py::arg("mask") = std::vector<bool>(), release_gil())
+        .def("step", &SocketVecEnv::step, "Step all envs with one row of base actions each, returns num_envs x [obs, reward, done, ik fails, terminal obs].",
+             release_gil())
+        .def("step_async", &SocketVecEnv::step_async, "Send a step batch without waiting, can be called several times to pipeline batches.", release_gil())
+        .def("step_wait", &SocketVecEnv::step_wait, "Wait for the oldest pending step batch.", release_gil())
+        .def("close", &SocketVecEnv::close, "Stop the servers.", release_gil());
+
+    py::class_<modulation_ellipses::Modulation>(m, "EllipseModulation")
+        .def(py::init([]() {
+            modulation_ellipses::Modulation *modulation = new modulation_ellipses::Modulation();
+            modulation->setEllipses();
+            return modulation;
+        }))
+        .def("evaluate_field",
+             [](modulation_ellipses::Modulation &self, Eigen::VectorXf gripper_pose, Eigen::VectorXf speed, Eigen::MatrixXd base_xy, Eigen::VectorXd base_yaw) {
+                 modulation_ellipses::FieldEvaluation field = self.evaluateField(gripper_pose, speed, base_xy, base_yaw);
+                 py::dict d;
+                 d["gamma"] = py::cast(field.gamma);
+                 d["weights"] = py::cast(field.weights);
+                 d["modulated_speed"] = py::cast(field.modulated_speed);
+                 return d;
+             },
+             "Evaluate gamma, weights and the modulated base speed [x, y, rot] for a fixed gripper pose [x, y, z, qx, qy, qz, qw] "
+             "and speed vector (layout as in Modulation::run) over Nx2 base positions and N base yaws.");
 
 //    py::class_<DynamicSystemHSR>(m, "HSREnv")
 //        .def(py::init<uint32_t, double, double, std::string, std::string, bool, double, double, double, bool, double, double, bool>())
@@ -17,7 +17,8 @@ const RoboConf tiago_config{
     // straight in front of itself:{0.0, 3.14159265359 / 2, -0.0, -0.0, 0.0, -0.0, 0.0, 3.14159265359 / 2},
     // angewinkelt vor sich: {0.19, 1.1, 0.0, -1.0, 2.0, 1.2, 0.0, 0.0}
     .neutral_pos_values = {0.19, 1.1, 0.0, -1.0, 2.0, 1.2, 0.0, 0.0},
-    .base_cmd_topic = "/mobile_base_controller/cmd_vel",
+    .base_cmd_topic = "mobile_base_controller/cmd_vel",
+    .odom_topic = "mobile_base_controller/odom",
     .base_vel_rng = 0.2,
     .base_rot_rng = 0.4,
     .z_min = 0.2,
@@ -35,7 +36,9 @@ DynamicSystemTiago::DynamicSystemTiago(uint32_t seed,
                                        double penalty_scaling,
                                        double time_step,
                                        double slow_down_real_exec,
-                                       bool perform_collision_check) :
+                                       bool perform_collision_check,
+                                       std::string node_name,
+                                       std::string ros_namespace) :
     DynamicSystem_base(seed,
                        min_goal_dist,
                        max_goal_dist,
@@ -46,18 +49,20 @@ DynamicSystemTiago::DynamicSystemTiago(uint32_t seed,
                        time_step,
                        slow_down_real_exec,
                        perform_collision_check,
-                       tiago_config) {
+                       tiago_config,
+                       node_name,
+                       ros_namespace) {
     setup();
 }
 
 void DynamicSystemTiago::setup() {
     if (init_controllers_) {
-        arm_client_.reset(new TrajClientTiago("/arm_controller/follow_joint_trajectory"));
+        arm_client_.reset(new TrajClientTiago(*ns_nh_, "arm_controller/follow_joint_trajectory"));
         while (!arm_client_->waitForServer(ros::Duration(5.0))) {
             ROS_INFO("Waiting for the arm_controller/follow_joint_trajectory action server to come up");
         }
 
-        torso_client_.reset(new TrajClientTiago("/torso_controller/follow_joint_trajectory"));
+        torso_client_.reset(new TrajClientTiago(*ns_nh_, "torso_controller/follow_joint_trajectory"));
         while (!torso_client_->waitForServer(ros::Duration(5.0))) {
             ROS_INFO("Waiting for the torso_controller/follow_joint_trajectory action server to come up");
         }
@@ -72,12 +77,23 @@ void DynamicSystemTiago::setup() {
         torso_goal_.trajectory.points[0].positions.resize(1);
         torso_goal_.trajectory.points[0].velocities.resize(1);
 
+        // for set_stream_arm_commands()
+        arm_command_pub_ = ns_nh_->advertise<trajectory_msgs::JointTrajectory>("arm_controller/command", 1);
+        torso_command_pub_ = ns_nh_->advertise<trajectory_msgs::JointTrajectory>("torso_controller/command", 1);
+        for (int i = 0; i < joint_names_.size(); i++) {
+            if (joint_names_[i] == "torso_lift_joint") {
+                torso_joint_idx_.push_back(i);
+            } else {
+                arm_joint_idx_.push_back(i);
+            }
+        }
+
         // move_group_arm_torso_ = new moveit::planning_interface::MoveGroupInterface(joint_model_group_name_);
         // move_group_arm_torso_->setPlannerId("SBLkConfigDefault");
         // move_group_arm_torso_->setMaxVelocityScalingFactor(1.0);
         // //move_group_arm_torso_->setMaxAccelerationScalingFactor(0.05);
 
-        gripper_client_.reset(new TrajClientTiago("/gripper_controller/follow_joint_trajectory"));
+        gripper_client_.reset(new TrajClientTiago(*ns_nh_, "gripper_controller/follow_joint_trajectory"));
         while (!gripper_client_->waitForServer(ros::Duration(5.0))) {
             ROS_INFO("Waiting for the gripper_controller/follow_joint_trajectory action server to come up");
         }
@@ -239,22 +255,21 @@ void DynamicSystemTiago::send_arm_command(const std::vector<double> &target_join
     torso_client_->sendGoal(torso_goal_);
 }
 
-bool DynamicSystemTiago::get_arm_success() {
-    bool success = true;
-    torso_client_->waitForResult(ros::Duration(10.0));
-    if (torso_client_->getState() != actionlib::SimpleClientGoalState::SUCCEEDED) {
-        ROS_WARN("The torso_client_ failed.");
-        success = false;
-    }
-    arm_client_->waitForResult(ros::Duration(10.0));
-    if (arm_client_->getState() != actionlib::SimpleClientGoalState::SUCCEEDED) {
-        ROS_WARN("The arm_client_ failed.");
-        // throw std::runtime_error("The arm_client_ failed.");
-        success &= false;
-    }
+void DynamicSystemTiago::stream_arm_command(const trajectory_msgs::JointTrajectory &traj) {
+    joint_stream::select_joints(traj, torso_joint_idx_, torso_traj_);
+    joint_stream::select_joints(traj, arm_joint_idx_, arm_traj_);
+    torso_command_pub_.publish(torso_traj_);
+    arm_command_pub_.publish(arm_traj_);
 }
 
-void DynamicSystemTiago::open_gripper(double position, bool wait_for_result) {
+bool DynamicSystemTiago::wait_for_arm(const ros::Time &deadline) {
+    // both goals were sent together and run concurrently, so they share the deadline
+    bool success = goal_wait::wait_until(*torso_client_, deadline, "torso");
+    success &= goal_wait::wait_until(*arm_client_, deadline, "arm");
+    return success;
+}
+
+void DynamicSystemTiago::send_gripper_command(double position, bool close) {
     control_msgs::FollowJointTrajectoryGoal goal;
 
     // The joint names, which apply to all waypoints
@@ -280,12 +295,16 @@ void DynamicSystemTiago::open_gripper(double position, bool wait_for_result) {
     goal.trajectory.points[index].time_from_start = ros::Duration(2.0);
 
     gripper_client_->sendGoal(goal);
+}
 
+bool DynamicSystemTiago::wait_for_gripper(const ros::Time &deadline) {
+    return goal_wait::wait_until(*gripper_client_, deadline, "gripper");
+}
+
+void DynamicSystemTiago::open_gripper(double position, bool wait_for_result) {
+    send_gripper_command(position, false);
     if (wait_for_result) {
-        gripper_client_->waitForResult(ros::Duration(5.0));
-        if (gripper_client_->getState() != actionlib::SimpleClientGoalState::SUCCEEDED)
-            ROS_WARN("The gripper client failed.");
-        ros::Duration(0.1).sleep();
+        wait_for_gripper(ros::Time::now() + ros::Duration(5.0));
     }
 }
 
@@ -1,5 +1,7 @@
 #include "modulation_rl/ellipse.h"
 
+#include <stdexcept>
+
 namespace ellipse {
 
     double Ellipse::sBuffer = 0.50;
@@ -76,4 +78,36 @@ namespace ellipse {
 
     double Ellipse::getGamma() { return _gamma; }
 
+    EllipseState Ellipse::getState() const {
+        EllipseState state;
+        state.type = _type;
+        state.height = _height;
+        state.width = _width;
+        state.alpha_ap = _alpha_ap;
+        state.p_alpha = _p_alpha;
+        state.gamma = _gamma;
+        state.R = {{_R(0, 0), _R(0, 1), _R(1, 0), _R(1, 1)}};
+        state.in_collision = _in_collision;
+        state.hyper_normal = _hyper_normal;
+        state.p_point = _p_point;
+        state.speed = _speed;
+        return state;
+    }
+
+    void Ellipse::setState(const EllipseState &state) {
+        if (state.type != _type) {
+            throw std::runtime_error("Ellipse state of type " + state.type + " does not match an ellipse of type " + _type);
+        }
+        _height = state.height;
+        _width = state.width;
+        _alpha_ap = state.alpha_ap;
+        _p_alpha = state.p_alpha;
+        _gamma = state.gamma;
+        _R << state.R[0], state.R[1], state.R[2], state.R[3];
+        _in_collision = state.in_collision;
+        _hyper_normal = state.hyper_normal;
+        _p_point = state.p_point;
+        _speed = state.speed;
+    }
+
 }  // namespace ellipse
@@ -0,0 +1,88 @@
+#include <modulation_rl/env_server.h>
+
+#include <modulation_rl/dynamic_system_pr2.h>
+#include <modulation_rl/dynamic_system_tiago.h>
+
+namespace env_server {
+    Config parse_args(int argc, char **argv) {
+        Config config;
+        for (int i = 1; i < argc; i++) {
+            std::string arg(argv[i]);
+            size_t pos = arg.find('=');
+            if (pos == std::string::npos) {
+                continue;
+            }
+            std::string key = arg.substr(0, pos), value = arg.substr(pos + 1);
+            if (key.compare(0, 2, "__") == 0) {
+                // ros remappings such as __name:=
+                continue;
+            } else if (key == "channel") {
+                config.channel = value;
+            } else if (key == "address") {
+                config.address = value;
+            } else if (key == "num_envs") {
+                config.num_envs = std::stoi(value);
+            } else if (key == "parallel_steps") {
+                config.parallel_steps = (std::stoi(value) != 0);
+            } else if (key == "robot") {
+                config.robot = value;
+            } else if (key == "seed") {
+                config.seed = std::stoul(value);
+            } else if (key == "strategy") {
+                config.strategy = value;
+            } else if (key == "min_goal_dist") {
+                config.min_goal_dist = std::stod(value);
+            } else if (key == "max_goal_dist") {
+                config.max_goal_dist = std::stod(value);
+            } else if (key == "penalty_scaling") {
+                config.penalty_scaling = std::stod(value);
+            } else if (key == "time_step") {
+                config.time_step = std::stod(value);
+            } else if (key == "perform_collision_check") {
+                config.perform_collision_check = (std::stoi(value) != 0);
+            } else if (key == "start_pose_distribution") {
+                config.start_pose_distribution = value;
+            } else if (key == "gripper_goal_distribution") {
+                config.gripper_goal_distribution = value;
+            } else if (key == "gmm_model_path") {
+                config.gmm_model_path = value;
+            } else if (key == "success_thres_dist") {
+                config.success_thres_dist = std::stod(value);
+            } else if (key == "success_thres_rot") {
+                config.success_thres_rot = std::stod(value);
+            } else if (key == "start_pause") {
+                config.start_pause = std::stod(value);
+            } else if (key == "auto_reset") {
+                config.auto_reset = (std::stoi(value) != 0);
+            } else if (key == "ros_namespace") {
+                config.ros_namespace = value;
+            } else {
+                throw std::runtime_error("Unknown argument " + key);
+            }
+        }
+        return config;
+    }
+
+    DynamicSystem_base *make_env(const Config &c, uint32_t seed) {
+        DynamicSystem_base *env;
+        // the process already initialised an anonymous node, so only the namespace matters here
+        std::string ns = c.ros_namespace.empty() ? "" : c.ros_namespace + "/env_" + std::to_string(seed);
+        if (c.robot == "pr2") {
+            env = new DynamicSystemPR2(seed, c.min_goal_dist, c.max_goal_dist, c.strategy, "sim", false, c.penalty_scaling, c.time_step, 1.0, c.perform_collision_check, "", ns);
+        } else if (c.robot == "tiago") {
+            env = new DynamicSystemTiago(seed, c.min_goal_dist, c.max_goal_dist, c.strategy, "sim", false, c.penalty_scaling, c.time_step, 1.0, c.perform_collision_check, "", ns);
+        } else {
+            throw std::runtime_error("Unknown robot " + c.robot);
+        }
+        if (c.auto_reset) {
+            env->set_auto_reset(true, std::vector<double>(), c.start_pose_distribution, c.gripper_goal_distribution, c.gmm_model_path, c.success_thres_dist,
+                                c.success_thres_rot, c.start_pause);
+        }
+        return env;
+    }
+
+    std::vector<double> reset(const Config &c, DynamicSystem_base *env) {
+        return env->reset(std::vector<double>(), std::vector<double>(), c.start_pose_distribution, c.gripper_goal_distribution, false, c.gmm_model_path,
+                          c.success_thres_dist, c.success_thres_rot, c.start_pause, false);
+    }
+}  // namespace env_server
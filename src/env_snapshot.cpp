@@ -0,0 +1,257 @@
+#include <modulation_rl/env_snapshot.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace env_snapshot {
+    namespace {
+        const char MAGIC[8] = {'M', 'R', 'L', 'S', 'N', 'A', 'P', '3'};
+
+        template <typename T>
+        void write_value(std::ofstream &f, const T &v) {
+            f.write(reinterpret_cast<const char *>(&v), sizeof(T));
+        }
+
+        template <typename T>
+        void read_value(std::ifstream &f, T &v) {
+            f.read(reinterpret_cast<char *>(&v), sizeof(T));
+        }
+
+        void write_vector3(std::ofstream &f, const tf::Vector3 &v) {
+            for (int i = 0; i < 3; i++) {
+                write_value<double>(f, v[i]);
+            }
+        }
+
+        void read_vector3(std::ifstream &f, tf::Vector3 &v) {
+            double xyz[3];
+            for (int i = 0; i < 3; i++) {
+                read_value(f, xyz[i]);
+            }
+            v.setValue(xyz[0], xyz[1], xyz[2]);
+        }
+
+        void write_quaternion(std::ofstream &f, const tf::Quaternion &q) {
+            write_value<double>(f, q.x());
+            write_value<double>(f, q.y());
+            write_value<double>(f, q.z());
+            write_value<double>(f, q.w());
+        }
+
+        void read_quaternion(std::ifstream &f, tf::Quaternion &q) {
+            double xyzw[4];
+            for (int i = 0; i < 4; i++) {
+                read_value(f, xyzw[i]);
+            }
+            q = tf::Quaternion(xyzw[0], xyzw[1], xyzw[2], xyzw[3]);
+        }
+
+        // full basis instead of a quaternion, so that a restored transform is bit-identical
+        void write_transform(std::ofstream &f, const tf::Transform &t) {
+            for (int r = 0; r < 3; r++) {
+                write_vector3(f, t.getBasis()[r]);
+            }
+            write_vector3(f, t.getOrigin());
+        }
+
+        void read_transform(std::ifstream &f, tf::Transform &t) {
+            tf::Vector3 rows[3], origin;
+            for (int r = 0; r < 3; r++) {
+                read_vector3(f, rows[r]);
+            }
+            read_vector3(f, origin);
+            t.setBasis(tf::Matrix3x3(rows[0][0], rows[0][1], rows[0][2], rows[1][0], rows[1][1], rows[1][2], rows[2][0], rows[2][1], rows[2][2]));
+            t.setOrigin(origin);
+        }
+
+        void write_velocities(std::ofstream &f, const PlannedVelocities &v) {
+            write_quaternion(f, v.dq);
+            write_vector3(f, v.vel_world);
+            write_vector3(f, v.vel_rel);
+        }
+
+        void read_velocities(std::ifstream &f, PlannedVelocities &v) {
+            read_quaternion(f, v.dq);
+            read_vector3(f, v.vel_world);
+            read_vector3(f, v.vel_rel);
+        }
+
+        void write_string(std::ofstream &f, const std::string &s) {
+            write_value<uint64_t>(f, s.size());
+            f.write(s.data(), s.size());
+        }
+
+        void read_string(std::ifstream &f, std::string &s, const std::string &filename) {
+            uint64_t n;
+            read_value(f, n);
+            if (!f || (n > 1 << 16)) {
+                throw std::runtime_error("Corrupt snapshot " + filename);
+            }
+            s.resize(n);
+            f.read(&s[0], n);
+        }
+
+        void write_doubles(std::ofstream &f, const std::vector<double> &v) {
+            write_value<uint64_t>(f, v.size());
+            f.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(double));
+        }
+
+        void read_doubles(std::ifstream &f, std::vector<double> &v, const std::string &filename) {
+            uint64_t n;
+            read_value(f, n);
+            if (!f || (n > 1000)) {
+                throw std::runtime_error("Corrupt snapshot " + filename);
+            }
+            v.resize(n);
+            f.read(reinterpret_cast<char *>(v.data()), n * sizeof(double));
+        }
+
+        void write_ellipse(std::ofstream &f, const ellipse::EllipseState &e) {
+            write_string(f, e.type);
+            write_value(f, e.height);
+            write_value(f, e.width);
+            write_value(f, e.alpha_ap);
+            write_value(f, e.p_alpha);
+            write_value(f, e.gamma);
+            write_value(f, e.R);
+            write_value(f, e.in_collision);
+            write_doubles(f, e.hyper_normal);
+            write_value(f, e.p_point);
+            write_doubles(f, e.speed);
+        }
+
+        void read_ellipse(std::ifstream &f, ellipse::EllipseState &e, const std::string &filename) {
+            read_string(f, e.type, filename);
+            read_value(f, e.height);
+            read_value(f, e.width);
+            read_value(f, e.alpha_ap);
+            read_value(f, e.p_alpha);
+            read_value(f, e.gamma);
+            read_value(f, e.R);
+            read_value(f, e.in_collision);
+            read_doubles(f, e.hyper_normal, filename);
+            read_value(f, e.p_point);
+            read_doubles(f, e.speed, filename);
+        }
+    }  // namespace
+
+    void save(const Snapshot &snapshot, const std::string &filename) {
+        std::ofstream f(filename, std::ios::binary);
+        if (!f) {
+            throw std::runtime_error("Could not open " + filename + " to write the snapshot");
+        }
+        f.write(MAGIC, sizeof(MAGIC));
+        write_value(f, snapshot.episode);
+        write_value(f, snapshot.path_size);
+        write_value(f, snapshot.display_trajectory_size);
+        write_value(f, snapshot.episode_stats);
+
+        write_value<uint64_t>(f, snapshot.joint_values.size());
+        f.write(reinterpret_cast<const char *>(snapshot.joint_values.data()), snapshot.joint_values.size() * sizeof(double));
+        write_transform(f, snapshot.base_transform);
+        write_transform(f, snapshot.gripper_transform);
+        write_transform(f, snapshot.rel_gripper_pose);
+        write_transform(f, snapshot.gripper_goal);
+        write_transform(f, snapshot.base_goal);
+        write_velocities(f, snapshot.planned_gripper_vel);
+        write_velocities(f, snapshot.planned_base_vel);
+
+        write_value<uint64_t>(f, snapshot.gmm_model_path.size());
+        f.write(snapshot.gmm_model_path.data(), snapshot.gmm_model_path.size());
+        write_transform(f, snapshot.planner_goal_input);
+        write_transform(f, snapshot.planner_initial_gripper);
+        write_transform(f, snapshot.planner_initial_base);
+        write_transform(f, snapshot.prev_plan.nextGripperTransform);
+        write_transform(f, snapshot.prev_plan.nextBaseTransform);
+        write_value(f, snapshot.gmm_time_offset);
+
+        write_value(f, snapshot.time);
+        write_value(f, snapshot.time_planner);
+        write_value(f, snapshot.reset_time);
+        write_value(f, snapshot.set_goal_time);
+        write_value(f, snapshot.start_pause);
+        write_value(f, snapshot.success_thres_dist);
+        write_value(f, snapshot.success_thres_rot);
+        write_value(f, snapshot.ik_error_count);
+        write_value(f, snapshot.ik_strategy);
+        write_string(f, snapshot.rng_state);
+        write_value<uint64_t>(f, snapshot.ellipses.size());
+        for (const ellipse::EllipseState &e : snapshot.ellipses) {
+            write_ellipse(f, e);
+        }
+        write_doubles(f, snapshot.ellipse_real_gamma);
+        if (!f) {
+            throw std::runtime_error("Failed to write the snapshot to " + filename);
+        }
+    }
+
+    Snapshot load(const std::string &filename) {
+        std::ifstream f(filename, std::ios::binary);
+        if (!f) {
+            throw std::runtime_error("Could not open the snapshot " + filename);
+        }
+        char magic[sizeof(MAGIC)];
+        f.read(magic, sizeof(magic));
+        if (!f || !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) {
+            throw std::runtime_error(filename + " is not an env snapshot");
+        }
+        Snapshot snapshot;
+        read_value(f, snapshot.episode);
+        read_value(f, snapshot.path_size);
+        read_value(f, snapshot.display_trajectory_size);
+        read_value(f, snapshot.episode_stats);
+
+        uint64_t n;
+        read_value(f, n);
+        if (!f || (n > 1000)) {
+            throw std::runtime_error("Corrupt snapshot " + filename);
+        }
+        snapshot.joint_values.resize(n);
+        f.read(reinterpret_cast<char *>(snapshot.joint_values.data()), n * sizeof(double));
+        read_transform(f, snapshot.base_transform);
+        read_transform(f, snapshot.gripper_transform);
+        read_transform(f, snapshot.rel_gripper_pose);
+        read_transform(f, snapshot.gripper_goal);
+        read_transform(f, snapshot.base_goal);
+        read_velocities(f, snapshot.planned_gripper_vel);
+        read_velocities(f, snapshot.planned_base_vel);
+
+        read_value(f, n);
+        if (!f || (n > 4096)) {
+            throw std::runtime_error("Corrupt snapshot " + filename);
+        }
+        snapshot.gmm_model_path.resize(n);
+        f.read(&snapshot.gmm_model_path[0], n);
+        read_transform(f, snapshot.planner_goal_input);
+        read_transform(f, snapshot.planner_initial_gripper);
+        read_transform(f, snapshot.planner_initial_base);
+        read_transform(f, snapshot.prev_plan.nextGripperTransform);
+        read_transform(f, snapshot.prev_plan.nextBaseTransform);
+        read_value(f, snapshot.gmm_time_offset);
+
+        read_value(f, snapshot.time);
+        read_value(f, snapshot.time_planner);
+        read_value(f, snapshot.reset_time);
+        read_value(f, snapshot.set_goal_time);
+        read_value(f, snapshot.start_pause);
+        read_value(f, snapshot.success_thres_dist);
+        read_value(f, snapshot.success_thres_rot);
+        read_value(f, snapshot.ik_error_count);
+        read_value(f, snapshot.ik_strategy);
+        read_string(f, snapshot.rng_state, filename);
+        read_value(f, n);
+        if (!f || (n > 1000)) {
+            throw std::runtime_error("Corrupt snapshot " + filename);
+        }
+        snapshot.ellipses.resize(n);
+        for (ellipse::EllipseState &e : snapshot.ellipses) {
+            read_ellipse(f, e, filename);
+        }
+        read_doubles(f, snapshot.ellipse_real_gamma, filename);
+        if (!f) {
+            throw std::runtime_error("Truncated snapshot " + filename);
+        }
+        return snapshot;
+    }
+}  // namespace env_snapshot
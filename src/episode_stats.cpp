@@ -0,0 +1,135 @@
+#include <modulation_rl/episode_stats.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace episode_stats {
+    int EpisodeStats::bin(double value, double lower, double upper, int n_bins) {
+        if (!(value > lower)) {
+            // also catches nan
+            return 0;
+        }
+        return std::min((int)((value - lower) / (upper - lower) * n_bins), n_bins - 1);
+    }
+
+    void EpisodeStats::add_step(const Step &step) {
+        current_.steps++;
+        current_.gripper_path_length += step.gripper_dist;
+        current_.base_path_length += step.base_dist;
+        current_.max_dist_to_sol = std::max(current_.max_dist_to_sol, step.dist_to_sol);
+        if (step.collision) {
+            current_.collisions++;
+        }
+        if (step.ik_fail) {
+            current_.kin_fails++;
+            current_.dist_to_sol_fail += step.dist_to_sol;
+        } else {
+            current_.dist_to_sol_success += step.dist_to_sol;
+        }
+
+        int xy = bin(step.rel_x, -REL_XY_RANGE, REL_XY_RANGE, N_XY_BINS) * N_XY_BINS + bin(step.rel_y, -REL_XY_RANGE, REL_XY_RANGE, N_XY_BINS);
+        int z = bin(step.rel_z, 0.0, Z_MAX, N_Z_BINS);
+        rel_xy_steps_[xy]++;
+        rel_z_steps_[z]++;
+        if (step.ik_fail) {
+            rel_xy_fails_[xy]++;
+            rel_z_fails_[z]++;
+        }
+    }
+
+    void EpisodeStats::end_episode(bool success, double final_dist_to_goal) {
+        current_.success = success;
+        current_.final_dist_to_goal = final_dist_to_goal;
+
+        episodes_++;
+        successes_ += success;
+        zero_fail_episodes_ += (current_.kin_fails == 0);
+        collision_free_episodes_ += (current_.collisions == 0);
+        steps_ += current_.steps;
+        kin_fails_ += current_.kin_fails;
+        collisions_ += current_.collisions;
+        gripper_path_length_ += current_.gripper_path_length;
+        base_path_length_ += current_.base_path_length;
+        final_dist_to_goal_ += final_dist_to_goal;
+        uint64_t n_success = current_.steps - current_.kin_fails;
+        if (n_success > 0) {
+            dist_to_sol_success_sum_ += current_.dist_to_sol_success / n_success;
+            dist_to_sol_success_n_++;
+        }
+        if (current_.kin_fails > 0) {
+            dist_to_sol_fail_sum_ += current_.dist_to_sol_fail / current_.kin_fails;
+            dist_to_sol_fail_n_++;
+        }
+        reached_within_10cm_ += (final_dist_to_goal <= 0.1) && (current_.max_dist_to_sol < 0.1);
+        reached_within_5cm_ += (final_dist_to_goal <= 0.05) && (current_.max_dist_to_sol < 0.05);
+        kin_fails_hist_[std::min(current_.kin_fails, (uint64_t)N_KIN_FAIL_BINS - 1)]++;
+
+        last_ = current_;
+        current_ = Episode();
+    }
+
+    std::map<std::string, double> EpisodeStats::to_map(const Episode &episode) {
+        std::map<std::string, double> m;
+        uint64_t n_success = episode.steps - episode.kin_fails;
+        m["steps"] = episode.steps;
+        m["kin_fails"] = episode.kin_fails;
+        m["collisions"] = episode.collisions;
+        m["gripper_path_length"] = episode.gripper_path_length;
+        m["base_path_length"] = episode.base_path_length;
+        m["dist_to_sol_success"] = (n_success > 0) ? episode.dist_to_sol_success / n_success : NAN;
+        m["dist_to_sol_fail"] = (episode.kin_fails > 0) ? episode.dist_to_sol_fail / episode.kin_fails : NAN;
+        m["max_dist_to_sol"] = episode.max_dist_to_sol;
+        m["success"] = episode.success;
+        m["final_dist_to_goal"] = episode.final_dist_to_goal;
+        return m;
+    }
+
+    std::map<std::string, double> EpisodeStats::get_summary() const {
+        std::map<std::string, double> s;
+        double n = std::max(episodes_, (uint64_t)1);
+        s["episodes"] = episodes_;
+        s["steps"] = steps_;
+        s["success_rate"] = successes_ / n;
+        s["zero_fail_rate"] = zero_fail_episodes_ / n;
+        s["collision_free_rate"] = collision_free_episodes_ / n;
+        s["kin_fails"] = kin_fails_;
+        s["kin_fails_per_episode"] = kin_fails_ / n;
+        s["collisions"] = collisions_;
+        s["collisions_per_episode"] = collisions_ / n;
+        s["episode_length"] = steps_ / n;
+        s["gripper_path_length"] = gripper_path_length_ / n;
+        s["base_path_length"] = base_path_length_ / n;
+        s["final_dist_to_goal"] = final_dist_to_goal_ / n;
+        s["dist_to_sol_success"] = (dist_to_sol_success_n_ > 0) ? dist_to_sol_success_sum_ / dist_to_sol_success_n_ : NAN;
+        s["dist_to_sol_fail"] = (dist_to_sol_fail_n_ > 0) ? dist_to_sol_fail_sum_ / dist_to_sol_fail_n_ : NAN;
+        s["reached_within_0.1"] = reached_within_10cm_ / n;
+        s["reached_within_0.05"] = reached_within_5cm_ / n;
+        return s;
+    }
+
+    void EpisodeStats::reset() {
+        current_ = Episode();
+        last_ = Episode();
+        episodes_ = 0;
+        successes_ = 0;
+        zero_fail_episodes_ = 0;
+        collision_free_episodes_ = 0;
+        steps_ = 0;
+        kin_fails_ = 0;
+        collisions_ = 0;
+        gripper_path_length_ = 0.0;
+        base_path_length_ = 0.0;
+        final_dist_to_goal_ = 0.0;
+        dist_to_sol_success_sum_ = 0.0;
+        dist_to_sol_success_n_ = 0;
+        dist_to_sol_fail_sum_ = 0.0;
+        dist_to_sol_fail_n_ = 0;
+        reached_within_10cm_ = 0;
+        reached_within_5cm_ = 0;
+        kin_fails_hist_.fill(0);
+        rel_xy_steps_.fill(0);
+        rel_xy_fails_.fill(0);
+        rel_z_steps_.fill(0);
+        rel_z_fails_.fill(0);
+    }
+}  // namespace episode_stats
@@ -1,6 +1,7 @@
 #include <modulation_rl/gaussian_mixture_model.h>
 
 GaussianMixtureModel::GaussianMixtureModel(double max_speed_gripper_rot, double max_speed_base_rot) :
+    gmm_time_offset_{0.0},
     _max_speed_gripper_rot{max_speed_gripper_rot},
     _max_speed_base_rot{max_speed_base_rot},
     _nr_modes{0},
@@ -32,8 +33,11 @@ void GaussianMixtureModel::adaptModel(tf::Transform newGoal, tf::Vector3 gmm_bas
     T = GR * MGR.inverse();
     T.setOrigin(-(T * newGoal.getOrigin()) + newGoal.getOrigin());
 
+    // always adapt the model as loaded from file, so that it can be adapted to a new goal without reloading it.
+    // Assigning to the existing vectors keeps their memory
+    _Sigma = _SigmaBck;
+    _MuEigen.resize(_nr_modes);
     // loop over gaussians
-    _MuEigen.clear();
     for (int i = 0; i < _nr_modes; i++) {
         tf::Transform tf_Mu_gr_i;
         tf_Mu_gr_i.setOrigin(tf::Vector3(_MuEigenBck[i](1), _MuEigenBck[i](2), _MuEigenBck[i](3)));
@@ -68,7 +72,8 @@ void GaussianMixtureModel::adaptModel(tf::Transform newGoal, tf::Vector3 gmm_bas
 
         // set _MuEigen
         double time_i = _MuEigenBck[i](0);
-        Eigen::VectorXf Mu_i_eigen(15);
+        Eigen::VectorXf &Mu_i_eigen = _MuEigen[i];
+        Mu_i_eigen.resize(15);
         Mu_i_eigen << time_i, tf_Mu_gr_i.getOrigin().x(), tf_Mu_gr_i.getOrigin().y(), tf_Mu_gr_i.getOrigin().z(), tf_Mu_gr_i.getRotation().x(), tf_Mu_gr_i.getRotation().y(),
             tf_Mu_gr_i.getRotation().z(), tf_Mu_gr_i.getRotation().w(), tf_Mu_base_i.getOrigin().x(), tf_Mu_base_i.getOrigin().y(), tf_Mu_base_i.getOrigin().z(),
             tf_Mu_base_i.getRotation().x(), tf_Mu_base_i.getRotation().y(), tf_Mu_base_i.getRotation().z(), tf_Mu_base_i.getRotation().w();
@@ -80,7 +85,6 @@ void GaussianMixtureModel::adaptModel(tf::Transform newGoal, tf::Vector3 gmm_bas
         //     Mu_i_eigen(10) = 1.06;
         // keep model height
         Mu_i_eigen(10) = 1.0;  //_MuEigenBck[i](10);
-        _MuEigen.push_back(Mu_i_eigen);
 
         // transform Sigma
         Eigen::MatrixXf TS(4, 4);
@@ -604,6 +608,7 @@ bool GaussianMixtureModel::loadFromFile(std::string &filename) {
         }
         _Sigma.push_back(Sigma_i);
     }
+    _SigmaBck = _Sigma;
 
     // set goal state
     _goalState.setOrigin(tf::Vector3(_Mu[_nr_modes - 1][1], _Mu[_nr_modes - 1][2], _Mu[_nr_modes - 1][3]));
@@ -12,11 +12,26 @@ GMMPlanner::GMMPlanner(const tf::Vector3 tip_to_gripper_offset,
     tip_to_gripper_offset_{tip_to_gripper_offset},
     gripper_to_base_rot_offset_{gripper_to_base_rot_offset} {
     double max_rot = 0.1;
-    gmm_model_path_ = gmm_model_path;
     gaussian_mixture_model_.reset(new GaussianMixtureModel(max_rot, max_rot));
-    // For each learned object manipulation there are three action models one for grasping, one for manipulation and one for releasing
-    // Stick to grasp and move of KallaxTuer first.
-    gaussian_mixture_model_->loadFromFile(gmm_model_path_);
+    reinit(gripperGoal, initialGripperTransform, baseGoal, initialBaseTransform, gmm_model_path, gmm_base_offset);
+};
+
+void GMMPlanner::reinit(tf::Transform gripperGoal,
+                        tf::Transform initialGripperTransform,
+                        tf::Transform baseGoal,
+                        tf::Transform initialBaseTransform,
+                        std::string gmm_model_path,
+                        double gmm_base_offset) {
+    if (gmm_model_path != gmm_model_path_) {
+        // For each learned object manipulation there are three action models one for grasping, one for manipulation and one for releasing
+        // Stick to grasp and move of KallaxTuer first.
+        if (!gaussian_mixture_model_->loadFromFile(gmm_model_path)) {
+            gmm_model_path_ = "";
+            throw std::runtime_error("Could not load the gmm model from " + gmm_model_path);
+        }
+        gmm_model_path_ = gmm_model_path;
+    }
+    gaussian_mixture_model_->gmm_time_offset_ = 0.0;
     // adaptModel(objectPose) transforms the GMM to a given object pose of the handled object (In this case we just use the currentGripperGOAL as new object pose)
     // afterwrds the model can be integrated step by step to generate new gripper poses leading to the correct handling of the object ()
     gaussian_mixture_model_->adaptModel(gripperGoal, tf::Vector3(gmm_base_offset, 0, 0));
@@ -24,7 +39,7 @@ GMMPlanner::GMMPlanner(const tf::Vector3 tip_to_gripper_offset,
     // transform to a tip goal
     prevPlan_.nextGripperTransform = utils::gripper_to_tip_goal(initialGripperTransform, tip_to_gripper_offset_, gripper_to_base_rot_offset_);
     prevPlan_.nextBaseTransform = initialBaseTransform;
-};
+}
 
 GripperPlan GMMPlanner::calc_next_step(double time,
                                        double dt,
@@ -112,7 +127,7 @@ tf::Transform GMMPlanner::get_last_attractor() {
     int nrModes = gaussian_mixture_model_->getNr_modes();
     // muEigen seems to directly give us the wrist goal
     tf::Transform last_attractor;
-    std::vector<Eigen::VectorXf> muEigen = gaussian_mixture_model_->getMu();
+    const std::vector<Eigen::VectorXf> &muEigen = gaussian_mixture_model_->getMu();
     last_attractor.setOrigin(tf::Vector3(muEigen[nrModes - 1][1], muEigen[nrModes - 1][2], muEigen[nrModes - 1][3]));
     last_attractor.setRotation(tf::Quaternion(muEigen[nrModes - 1][4], muEigen[nrModes - 1][5], muEigen[nrModes - 1][6], muEigen[nrModes - 1][7]));
     return last_attractor;
@@ -128,8 +143,8 @@ std::vector<tf::Transform> GMMPlanner::get_mus() {
     int nrModes = gaussian_mixture_model_->getNr_modes();
     std::vector<tf::Transform> v;
 
+    const std::vector<Eigen::VectorXf> &muEigen = gaussian_mixture_model_->getMu();
     for (int i = 0; i < nrModes; i++) {
-        std::vector<Eigen::VectorXf> muEigen = gaussian_mixture_model_->getMu();
 
         tf::Transform gripper_t;
         gripper_t.setOrigin(tf::Vector3(muEigen[i][1], muEigen[i][2], muEigen[i][3]));
@@ -0,0 +1,111 @@
+#include <modulation_rl/ik_stats.h>
+
+#include <algorithm>
+
+namespace ik_stats {
+    const char *result_name(IKResult result) {
+        switch (result) {
+            case SUCCESS: return "success";
+            case NO_SOLUTION: return "no_solution";
+            case COLLISION: return "collision";
+            default: return "unknown";
+        }
+    }
+
+    const char *strategy_name(IKStrategy strategy) {
+        switch (strategy) {
+            case FULL_SOLVE: return "full_solve";
+            case PARTIAL: return "partial";
+            case FALLBACK: return "fallback";
+            default: return "unknown";
+        }
+    }
+
+    void IKStats::begin_call() {
+        call_validity_checks_ = 0;
+        call_validity_rejections_ = 0;
+        call_start_ = profiler::Clock::now();
+    }
+
+    void IKStats::add_validity_check(bool valid) {
+        call_validity_checks_++;
+        validity_checks_++;
+        if (!valid) {
+            call_validity_rejections_++;
+            validity_rejections_++;
+        }
+    }
+
+    IKResult IKStats::end_call(bool success) {
+        double seconds = std::chrono::duration<double>(profiler::Clock::now() - call_start_).count();
+        IKResult result;
+        if (success) {
+            result = SUCCESS;
+            time_to_solution_.add(seconds);
+        } else {
+            result = (call_validity_rejections_ > 0) ? COLLISION : NO_SOLUTION;
+            time_to_failure_.add(seconds);
+        }
+        calls_++;
+        results_[result]++;
+        max_validity_checks_per_call_ = std::max(max_validity_checks_per_call_, call_validity_checks_);
+        return result;
+    }
+
+    void IKStats::add_scene_collision_check(bool in_collision) {
+        scene_collision_checks_++;
+        if (in_collision) {
+            scene_collisions_++;
+        }
+    }
+
+    void IKStats::add_strategy(IKStrategy strategy, double pos_error) {
+        strategies_[strategy]++;
+        if (strategy == PARTIAL) {
+            partial_pos_error_.add(pos_error);
+        }
+    }
+
+    std::map<std::string, double> IKStats::get_summary() const {
+        std::map<std::string, double> s;
+        s["calls"] = calls_;
+        for (int i = 0; i < N_RESULTS; i++) {
+            s[result_name((IKResult)i)] = results_[i];
+        }
+        s["success_rate"] = (calls_ > 0) ? (double)results_[SUCCESS] / calls_ : 0.0;
+        s["validity_checks"] = validity_checks_;
+        s["validity_rejections"] = validity_rejections_;
+        s["validity_checks_per_call"] = (calls_ > 0) ? (double)validity_checks_ / calls_ : 0.0;
+        s["max_validity_checks_per_call"] = max_validity_checks_per_call_;
+        s["scene_collision_checks"] = scene_collision_checks_;
+        s["scene_collisions"] = scene_collisions_;
+        for (int i = 0; i < N_STRATEGIES; i++) {
+            s[std::string("strategy_") + strategy_name((IKStrategy)i)] = strategies_[i];
+        }
+
+        const std::pair<std::string, const profiler::Histogram *> hists[] = {{"time_to_solution", &time_to_solution_}, {"time_to_failure", &time_to_failure_},
+                                                                             {"partial_pos_error", &partial_pos_error_}};
+        for (const std::pair<std::string, const profiler::Histogram *> &h : hists) {
+            s[h.first + "_mean"] = (h.second->count > 0) ? h.second->total / h.second->count : 0.0;
+            s[h.first + "_max"] = h.second->max;
+            s[h.first + "_p50"] = h.second->percentile(0.5);
+            s[h.first + "_p95"] = h.second->percentile(0.95);
+            s[h.first + "_p99"] = h.second->percentile(0.99);
+        }
+        return s;
+    }
+
+    void IKStats::reset() {
+        calls_ = 0;
+        results_.fill(0);
+        validity_checks_ = 0;
+        validity_rejections_ = 0;
+        max_validity_checks_per_call_ = 0;
+        scene_collision_checks_ = 0;
+        scene_collisions_ = 0;
+        strategies_.fill(0);
+        time_to_solution_.reset();
+        time_to_failure_.reset();
+        partial_pos_error_.reset();
+    }
+}  // namespace ik_stats
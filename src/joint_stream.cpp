@@ -0,0 +1,59 @@
+#include <modulation_rl/joint_stream.h>
+
+#include <stdexcept>
+
+namespace joint_stream {
+    void TrajectoryStreamer::init(const std::vector<std::string> &joint_names, int n_lookahead) {
+        if (n_lookahead < 0) {
+            throw std::runtime_error("n_lookahead must be >= 0");
+        }
+        traj_.joint_names = joint_names;
+        traj_.points.resize(n_lookahead + 1);
+        for (trajectory_msgs::JointTrajectoryPoint &p : traj_.points) {
+            p.positions.resize(joint_names.size());
+            p.velocities.resize(joint_names.size());
+        }
+        prev_target_.resize(joint_names.size());
+        has_prev_ = false;
+    }
+
+    const trajectory_msgs::JointTrajectory &TrajectoryStreamer::update(const std::vector<double> &target, double exec_duration, double cycle_time) {
+        const int n_joints = traj_.joint_names.size();
+        if ((int)target.size() != n_joints) {
+            throw std::runtime_error("Expected one target value per streamed joint");
+        }
+        // zero stamp: start as soon as the controller receives it
+        traj_.header.stamp = ros::Time(0);
+        for (int j = 0; j < n_joints; j++) {
+            double vel = has_prev_ ? (target[j] - prev_target_[j]) / cycle_time : 0.0;
+            for (int k = 0; k < traj_.points.size(); k++) {
+                traj_.points[k].positions[j] = target[j] + k * cycle_time * vel;
+                traj_.points[k].velocities[j] = vel;
+            }
+            prev_target_[j] = target[j];
+        }
+        for (int k = 0; k < traj_.points.size(); k++) {
+            traj_.points[k].time_from_start = ros::Duration(exec_duration + k * cycle_time);
+        }
+        has_prev_ = true;
+        return traj_;
+    }
+
+    void select_joints(const trajectory_msgs::JointTrajectory &traj, const std::vector<int> &indices, trajectory_msgs::JointTrajectory &out) {
+        out.header = traj.header;
+        out.joint_names.resize(indices.size());
+        out.points.resize(traj.points.size());
+        for (int i = 0; i < indices.size(); i++) {
+            out.joint_names[i] = traj.joint_names[indices[i]];
+        }
+        for (int k = 0; k < traj.points.size(); k++) {
+            out.points[k].positions.resize(indices.size());
+            out.points[k].velocities.resize(indices.size());
+            out.points[k].time_from_start = traj.points[k].time_from_start;
+            for (int i = 0; i < indices.size(); i++) {
+                out.points[k].positions[i] = traj.points[k].positions[indices[i]];
+                out.points[k].velocities[i] = traj.points[k].velocities[indices[i]];
+            }
+        }
+    }
+}  // namespace joint_stream
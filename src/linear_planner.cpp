@@ -1,6 +1,10 @@
 #include <modulation_rl/linear_planner.h>
 
 LinearPlanner::LinearPlanner(tf::Transform gripperGoal, tf::Transform initialGripperTransform, tf::Transform baseGoal, tf::Transform initialBaseTransform) : BaseGripperPlanner() {
+    reinit(gripperGoal, initialGripperTransform, baseGoal, initialBaseTransform);
+};
+
+void LinearPlanner::reinit(tf::Transform gripperGoal, tf::Transform initialGripperTransform, tf::Transform baseGoal, tf::Transform initialBaseTransform) {
     gripperGoal_ = gripperGoal;
     baseGoal_ = baseGoal;
     initialGripperTransform_ = initialGripperTransform;
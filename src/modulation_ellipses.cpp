@@ -104,23 +104,24 @@ namespace modulation_ellipses {
         gp_phi_sin_inner.reset(new libgp::GaussianProcess((fpath + "gp_phi_sin_inner").c_str()));
     }
 
-    void Modulation::updateSpeedAndPosition(Eigen::Vector3d &curr_pose, Eigen::VectorXf &curr_speed, Eigen::VectorXd &curr_gripper_pose) {
-        position_ = curr_pose;
-        speed_ = curr_speed;
-        gripper_position_ = curr_gripper_pose;
+    double Modulation::computeGripperPitch(const Eigen::Quaterniond &Q) {
+        double gripper_pitch = Q.toRotationMatrix().eulerAngles(2, 1, 0)[1];
+        if (gripper_pitch > M_PI / 2)
+            gripper_pitch = M_PI - gripper_pitch;
+        else if (gripper_pitch < -M_PI / 2)
+            gripper_pitch = -M_PI - gripper_pitch;
+        return gripper_pitch;
+    }
+
+    // Shape, center and speed of the irm ellipses. Only depends on the gripper, not on the base pose
+    void Modulation::updateEllipsesFromGripper(Eigen::VectorXf &curr_speed, Eigen::VectorXd &curr_gripper_pose) {
         Eigen::Matrix2f R(2, 2);
 
         Eigen::Isometry3d gripperPose;
         gripperPose.setIdentity();
         Eigen::Quaterniond Q = Eigen::Quaterniond(curr_gripper_pose(6), curr_gripper_pose(3), curr_gripper_pose(4), curr_gripper_pose(5));
         gripperPose.linear() = Q.matrix();
-        double gripper_pitch;
-        Eigen::Vector3d euler = Q.toRotationMatrix().eulerAngles(2, 1, 0);
-        gripper_pitch = euler[1];
-        if (gripper_pitch > M_PI / 2)
-            gripper_pitch = M_PI - gripper_pitch;
-        else if (gripper_pitch < -M_PI / 2)
-            gripper_pitch = -M_PI - gripper_pitch;
+        double gripper_pitch = computeGripperPitch(Q);
 
         for (int k = 0; k < ellipses_.size(); k++) {
             if (ellipses_[k].getType() == "outter" || ellipses_[k].getType() == "inner") {
@@ -129,7 +130,7 @@ namespace modulation_ellipses {
                 x_Offset_gripper << -0.18, 0.0, 0.0;
                 x_Offset_gripper = gripperPose.linear() * x_Offset_gripper;
                 Eigen::Vector3d wrist_pose;
-                wrist_pose << gripper_position_[0] + x_Offset_gripper[0], gripper_position_[1] + x_Offset_gripper[1], gripper_position_[2] + x_Offset_gripper[2] - 0.1;
+                wrist_pose << curr_gripper_pose[0] + x_Offset_gripper[0], curr_gripper_pose[1] + x_Offset_gripper[1], curr_gripper_pose[2] + x_Offset_gripper[2] - 0.1;
                 double x_test[] = {wrist_pose(2), gripper_pitch};
 
                 // update speed and position of irm ellipses
@@ -174,66 +175,74 @@ namespace modulation_ellipses {
                     radial_velocity = angle_velocity.cross(x_Offset_gripper);
                     ellipse_speed.push_back(curr_speed[0] + radial_velocity[0]);
                     ellipse_speed.push_back(curr_speed[1] + radial_velocity[1]);
+                }
+                ellipses_[k].setSpeed(ellipse_speed);
+            }
+        }
+    }
 
-                    // update orientation part of positioning for irm ellipses
-                    int nr_neighbors = 19;
-                    Eigen::Vector2f pos_ell_frame;
-                    pos_ell_frame << position_[0] - ellipses_[k].getPPoint()[0], position_[1] - ellipses_[k].getPPoint()[1];
-                    pos_ell_frame = ellipses_[k].getR().transpose() * pos_ell_frame;
-                    float _sample[4];
-                    CvMat sample_beta0 = cvMat(1, 4, CV_32FC1, _sample);
-                    sample_beta0.data.fl[0] = (float)curr_gripper_pose(2);
-                    sample_beta0.data.fl[1] = (float)Q.toRotationMatrix().eulerAngles(2, 1, 0)[1];  // 0.0;
-                    if (sample_beta0.data.fl[1] > M_PI / 2)
-                        sample_beta0.data.fl[1] = M_PI - sample_beta0.data.fl[1];
-                    else if (sample_beta0.data.fl[1] < -M_PI / 2)
-                        sample_beta0.data.fl[1] = -M_PI - sample_beta0.data.fl[1];
-                    sample_beta0.data.fl[2] = (float)pos_ell_frame[0];
-                    sample_beta0.data.fl[3] = (float)pos_ell_frame[1];
-                    float _response[nr_neighbors];
-                    float _neighbors[1];
-
-                    CvMat resultMat0 = cvMat(1, 1, CV_32FC1, _neighbors);
-                    const CvMat *resultMat = &resultMat0;
-                    CvMat neighborResponses0 = cvMat(1, nr_neighbors, CV_32FC1, _response);
-                    const CvMat *neighborResponses = &neighborResponses0;
-                    // UBUNTU 14 VERSION
-                    // CvMat resultMat = cvMat(1,1,CV_32FC1,_neighbors);
-                    // CvMat neighborResponses = cvMat(1,nr_neighbors,CV_32F,_response);
-                    ///
-
-                    cv::Mat Mat_result = cv::cvarrToMat(resultMat);
-                    cv::Mat Mat_neighborResponses = cv::cvarrToMat(neighborResponses);
-                    const CvMat *sample_beta = &sample_beta0;
-                    cv::Mat M1 = cv::cvarrToMat(sample_beta);
+    void Modulation::updateSpeedAndPosition(Eigen::Vector3d &curr_pose, Eigen::VectorXf &curr_speed, Eigen::VectorXd &curr_gripper_pose) {
+        position_ = curr_pose;
+        speed_ = curr_speed;
+        gripper_position_ = curr_gripper_pose;
+        updateEllipsesFromGripper(curr_speed, curr_gripper_pose);
 
-                    float result_beta0 = knnAngle_->findNearest(M1, nr_neighbors, Mat_result, Mat_neighborResponses);
+        Eigen::Quaterniond Q = Eigen::Quaterniond(curr_gripper_pose(6), curr_gripper_pose(3), curr_gripper_pose(4), curr_gripper_pose(5));
+        for (int k = 0; k < ellipses_.size(); k++) {
+            if (ellipses_[k].getType() == "outter") {
+                // update orientation part of positioning for irm ellipses
+                int nr_neighbors = 19;
+                Eigen::Vector2f pos_ell_frame;
+                pos_ell_frame << position_[0] - ellipses_[k].getPPoint()[0], position_[1] - ellipses_[k].getPPoint()[1];
+                pos_ell_frame = ellipses_[k].getR().transpose() * pos_ell_frame;
+                float _sample[4];
+                CvMat sample_beta0 = cvMat(1, 4, CV_32FC1, _sample);
+                sample_beta0.data.fl[0] = (float)curr_gripper_pose(2);
+                sample_beta0.data.fl[1] = (float)computeGripperPitch(Q);
+                sample_beta0.data.fl[2] = (float)pos_ell_frame[0];
+                sample_beta0.data.fl[3] = (float)pos_ell_frame[1];
+                float _response[nr_neighbors];
+                float _neighbors[1];
+
+                CvMat resultMat0 = cvMat(1, 1, CV_32FC1, _neighbors);
+                const CvMat *resultMat = &resultMat0;
+                CvMat neighborResponses0 = cvMat(1, nr_neighbors, CV_32FC1, _response);
+                const CvMat *neighborResponses = &neighborResponses0;
+                // UBUNTU 14 VERSION
+                // CvMat resultMat = cvMat(1,1,CV_32FC1,_neighbors);
+                // CvMat neighborResponses = cvMat(1,nr_neighbors,CV_32F,_response);
+                ///
+
+                cv::Mat Mat_result = cv::cvarrToMat(resultMat);
+                cv::Mat Mat_neighborResponses = cv::cvarrToMat(neighborResponses);
+                const CvMat *sample_beta = &sample_beta0;
+                cv::Mat M1 = cv::cvarrToMat(sample_beta);
+
+                float result_beta0 = knnAngle_->findNearest(M1, nr_neighbors, Mat_result, Mat_neighborResponses);
+                // UBUNTU 14 VERSION
+                // const float **neighbors=0;
+                // float result_beta0 = knnAngle_.find_nearest(&sample_beta0, nr_neighbors,&resultMat,neighbors,&neighborResponses);
+
+                Mat_neighborResponses.convertTo(Mat_neighborResponses, CV_64FC1);
+                double sum_sin = 0.0;
+                double sum_cos = 0.0;
+                for (int s = 0; s < nr_neighbors; s++) {
+                    double neighbor_i = Mat_neighborResponses.at<double>(s);
                     // UBUNTU 14 VERSION
-                    // const float **neighbors=0;
-                    // float result_beta0 = knnAngle_.find_nearest(&sample_beta0, nr_neighbors,&resultMat,neighbors,&neighborResponses);
-
-                    Mat_neighborResponses.convertTo(Mat_neighborResponses, CV_64FC1);
-                    double sum_sin = 0.0;
-                    double sum_cos = 0.0;
-                    for (int s = 0; s < nr_neighbors; s++) {
-                        double neighbor_i = Mat_neighborResponses.at<double>(s);
-                        // UBUNTU 14 VERSION
-                        // double neighbor_i = (double) neighborResponses.data.fl[s];
-
-                        sum_sin += sin(neighbor_i);
-                        sum_cos += cos(neighbor_i);
-                    }
-                    result_beta0 = atan2(sum_sin, sum_cos);
-
-                    // find aperture for legal orientation with knn regression
-                    float result_beta_ap = knnAperture_->findNearest(M1, nr_neighbors, Mat_result, Mat_neighborResponses);
-                    // UBTUNTU 14VERSION
-                    // float result_beta_ap = knnAperture_.find_nearest(&sample_beta0, nr_neighbors);
+                    // double neighbor_i = (double) neighborResponses.data.fl[s];
 
-                    ellipses_[k].setPPointAlpha(result_beta0);
-                    ellipses_[k].setAlphaAp(result_beta_ap);
+                    sum_sin += sin(neighbor_i);
+                    sum_cos += cos(neighbor_i);
                 }
-                ellipses_[k].setSpeed(ellipse_speed);
+                result_beta0 = atan2(sum_sin, sum_cos);
+
+                // find aperture for legal orientation with knn regression
+                float result_beta_ap = knnAperture_->findNearest(M1, nr_neighbors, Mat_result, Mat_neighborResponses);
+                // UBTUNTU 14VERSION
+                // float result_beta_ap = knnAperture_.find_nearest(&sample_beta0, nr_neighbors);
+
+                ellipses_[k].setPPointAlpha(result_beta0);
+                ellipses_[k].setAlphaAp(result_beta_ap);
             }
         }
     }
@@ -288,6 +297,8 @@ namespace modulation_ellipses {
 
     void Modulation::computeGamma() {
         gamma_.clear();
+        // only the gammas of this cycle, one per ellipse
+        real_gamma_.clear();
         computeXiWave();
         int i = 0;
         for (ellipse::Ellipse ellipse : ellipses_) {
@@ -493,6 +504,203 @@ namespace modulation_ellipses {
         curr_speed(12) = speed_(12);
     }
 
+    void Modulation::getState(std::vector<ellipse::EllipseState> &ellipses, std::vector<double> &real_gamma) const {
+        ellipses.clear();
+        for (const ellipse::Ellipse &e : ellipses_) {
+            ellipses.push_back(e.getState());
+        }
+        real_gamma = real_gamma_;
+    }
+
+    void Modulation::setState(const std::vector<ellipse::EllipseState> &ellipses, const std::vector<double> &real_gamma) {
+        if (ellipses.size() != ellipses_.size()) {
+            throw std::runtime_error("Ellipse state does not match the number of ellipses");
+        }
+        for (int k = 0; k < ellipses_.size(); k++) {
+            ellipses_[k].setState(ellipses[k]);
+        }
+        real_gamma_ = real_gamma;
+    }
+
+    // Same modulation as run(), but for a whole grid of base poses [x, y] + yaw at once. The GP regression of the ellipses only depends on the gripper
+    // and is done once, the knn lookups are batched into a single query and the remaining per-pose computations run in flat loops over the batch.
+    FieldEvaluation Modulation::evaluateField(const Eigen::VectorXf &gripper_pose,
+                                              const Eigen::VectorXf &curr_speed,
+                                              const Eigen::MatrixXd &base_xy,
+                                              const Eigen::VectorXd &base_yaw) {
+        if ((gripper_pose.size() != 7) || (curr_speed.size() != 14)) {
+            throw std::runtime_error("evaluateField expects a gripper pose of length 7 and a speed vector of length 14");
+        }
+        if ((base_xy.cols() != 2) || (base_xy.rows() != base_yaw.size())) {
+            throw std::runtime_error("evaluateField expects base_xy of shape Nx2 and base_yaw of length N");
+        }
+        const int n = base_xy.rows();
+        const int n_ell = ellipses_.size();
+
+        FieldEvaluation result;
+        result.gamma.resize(n, n_ell);
+        result.weights.resize(n, n_ell);
+        result.modulated_speed.resize(n, 3);
+        result.modulated_speed.col(0).setConstant(curr_speed(7));
+        result.modulated_speed.col(1).setConstant(curr_speed(8));
+        result.modulated_speed.col(2).setConstant(curr_speed(12));
+        if ((n_ell == 0) || (n == 0)) {
+            return result;
+        }
+
+        Eigen::VectorXf speed = curr_speed;
+        Eigen::VectorXd gripper = gripper_pose.cast<double>();
+        gripper_position_ = gripper;
+        updateEllipsesFromGripper(speed, gripper);
+
+        // ellipse frame coordinates and gamma for all poses (see computeXiWave(), computeGamma())
+        Eigen::ArrayXXd xi0(n, n_ell), xi1(n, n_ell), real_gamma(n, n_ell);
+        Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> in_collision(n, n_ell);
+        for (int k = 0; k < n_ell; k++) {
+            ellipse::Ellipse &e = ellipses_[k];
+            const Eigen::Matrix2f R = e.getR();
+            const Eigen::ArrayXd dx = base_xy.col(0).array() - e.getPPoint()[0];
+            const Eigen::ArrayXd dy = base_xy.col(1).array() - e.getPPoint()[1];
+            xi0.col(k) = R(0, 0) * dx + R(1, 0) * dy;
+            xi1.col(k) = R(0, 1) * dx + R(1, 1) * dy;
+
+            Eigen::ArrayXd g = ((xi0.col(k) / e.getHeight()).pow(2 * e.getP1()) + (xi1.col(k) / e.getWidth()).pow(2 * e.getP2())).pow(1.0 / e.getP2());
+            if (e.getType() == "outter") {
+                g = g.inverse();
+            }
+            real_gamma.col(k) = g;
+            in_collision.col(k) = (g < 1.0);
+            result.gamma.col(k) = g.max(1.0).matrix();
+        }
+
+        // orientation bounds of the outer ellipses: one batched knn query for all poses (see updateSpeedAndPosition())
+        const int nr_neighbors = 19;
+        const float gripper_pitch = (float)computeGripperPitch(Eigen::Quaterniond(gripper(6), gripper(3), gripper(4), gripper(5)));
+        Eigen::ArrayXXd p_alpha(n, n_ell), alpha_ap(n, n_ell);
+        for (int k = 0; k < n_ell; k++) {
+            if (ellipses_[k].getType() != "outter") {
+                p_alpha.col(k).setConstant(ellipses_[k].getPPointAlpha());
+                alpha_ap.col(k).setConstant(ellipses_[k].getAlphaAp());
+                continue;
+            }
+            cv::Mat samples(n, 4, CV_32FC1);
+            for (int i = 0; i < n; i++) {
+                float *row = samples.ptr<float>(i);
+                row[0] = (float)gripper(2);
+                row[1] = gripper_pitch;
+                row[2] = (float)xi0(i, k);
+                row[3] = (float)xi1(i, k);
+            }
+            cv::Mat results, neighbor_responses, results_ap;
+            knnAngle_->findNearest(samples, nr_neighbors, results, neighbor_responses);
+            knnAperture_->findNearest(samples, nr_neighbors, results_ap);
+            neighbor_responses.convertTo(neighbor_responses, CV_64FC1);
+            results_ap.convertTo(results_ap, CV_64FC1);
+            for (int i = 0; i < n; i++) {
+                const double *responses = neighbor_responses.ptr<double>(i);
+                double sum_sin = 0.0, sum_cos = 0.0;
+                for (int s = 0; s < nr_neighbors; s++) {
+                    sum_sin += sin(responses[s]);
+                    sum_cos += cos(responses[s]);
+                }
+                p_alpha(i, k) = atan2(sum_sin, sum_cos);
+                alpha_ap(i, k) = results_ap.at<double>(i, 0);
+            }
+        }
+
+        // weights (see computeWeight())
+        for (int k = 0; k < n_ell; k++) {
+            for (int i = 0; i < n; i++) {
+                double w = 1.0;
+                for (int j = first_ellipse_; j < n_ell; j++) {
+                    if (j != k) {
+                        w *= (result.gamma(i, j) - 1) / ((result.gamma(i, k) - 1) + (result.gamma(i, j) - 1));
+                    }
+                }
+                if (w != w) {
+                    w = 1.0;
+                    for (int j = first_ellipse_; j < n_ell; j++) {
+                        if (j != k) {
+                            w *= (real_gamma(i, j) - 1) / ((real_gamma(i, k) - 1) + (real_gamma(i, j) - 1));
+                        }
+                    }
+                }
+                if (!do_ir_modulation_ & first_ellipse_ > k)
+                    w = 0;
+                result.weights(i, k) = w;
+            }
+        }
+
+        const double collision_repulsion = -50.0;
+        for (int i = 0; i < n; i++) {
+            double rot_speed = curr_speed(12);
+            Eigen::Matrix2d modulation = Eigen::Matrix2d::Identity();
+            double meanVelX = 0.0, meanVelY = 0.0, weightSum = 0.0;
+
+            for (int k = 0; k < n_ell; k++) {
+                ellipse::Ellipse &e = ellipses_[k];
+                const Eigen::Matrix2d R = e.getR().cast<double>();
+                const double gamma_k = result.gamma(i, k);
+                const double w = result.weights(i, k);
+
+                // base orientation bound (see computeGammaAlpha())
+                if (e.getType() == "outter") {
+                    double alpha_dist = p_alpha(i, k) - (base_yaw(i) + e.getAlpha());
+                    if (alpha_dist < -M_PI) {
+                        alpha_dist += 2.0 * M_PI;
+                    } else if (alpha_dist > M_PI)
+                        alpha_dist -= 2.0 * M_PI;
+                    double gamma_alpha = pow((alpha_dist / alpha_ap(i, k) / 2.0), 2.0);
+                    if (gamma_alpha >= 0.1) {
+                        rot_speed = (alpha_dist * rot_speed >= 0.0) ? rot_speed * gamma_alpha * 10 : -rot_speed * gamma_alpha * 10;
+                    } else if (alpha_dist * rot_speed < 0.0) {
+                        rot_speed = rot_speed * (1.0 - gamma_alpha);
+                    }
+                }
+
+                // normal of the hyperplane (see computeHyperplane(), assembleE_k())
+                const double n0 = pow(xi0(i, k) / e.getHeight(), 2.0 * e.getP1() - 1) * 2 * e.getP1() / e.getHeight();
+                const double n1 = pow(xi1(i, k) / e.getWidth(), 2.0 * e.getP2() - 1) * 2 * e.getP2() / e.getWidth();
+                Eigen::Matrix2d e_k;
+                e_k << n0, n1, n1, -n0;
+
+                // eigenvalues (see computeEigenvalue())
+                Eigen::Vector2d rel_speed(curr_speed(7) - e.getSpeed()[0], curr_speed(8) - e.getSpeed()[1]);
+                const bool passed_object = rel_speed.dot(R * Eigen::Vector2d(n0, n1)) > 0.0;
+                const double scaled_w = w / pow(gamma_k, 1.0 / e.getRho());
+                double lambda0 = 1.0, lambda1 = 1.0;
+                if (e.getType() == "outter") {
+                    if (passed_object && !in_collision(i, k))
+                        lambda0 = 1.0 - scaled_w;
+                    else if (passed_object && in_collision(i, k))
+                        lambda0 = collision_repulsion;
+                } else if (e.getType() == "inner") {
+                    if (in_collision(i, k)) {
+                        lambda0 = passed_object ? 1.0 + scaled_w : collision_repulsion;
+                        lambda1 = 1.0 + scaled_w;
+                    } else if (!passed_object) {
+                        lambda0 = 1.0 - scaled_w;
+                        lambda1 = 1.0 + 1.0 / 500000.0 * scaled_w;
+                    }
+                }
+                Eigen::Matrix2d d_k = Eigen::Vector2d(lambda0, lambda1).asDiagonal();
+                modulation = (R * e_k * d_k * e_k.inverse() * R.transpose()) * modulation;
+
+                weightSum += w;
+                meanVelX += w * e.getSpeed()[0];
+                meanVelY += w * e.getSpeed()[1];
+            }
+
+            // (see compModulation())
+            Eigen::Vector2d d2(curr_speed(7) - meanVelX / weightSum, curr_speed(8) - meanVelY / weightSum);
+            d2 = modulation * d2;
+            result.modulated_speed(i, 0) = d2[0] + meanVelX / weightSum;
+            result.modulated_speed(i, 1) = d2[1] + meanVelY / weightSum;
+            result.modulated_speed(i, 2) = rot_speed;
+        }
+        return result;
+    }
+
     double computeL2Norm(std::vector<double> v) {
         double res = 0;
         for (double entry : v) {
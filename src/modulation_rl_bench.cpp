@@ -0,0 +1,224 @@
+// Headless throughput benchmark of the env hot path (reset + step) in the analytical SimWorld.
+// Requires a roscore and the robot_description / move_group of the robot to be running, but no gazebo or controllers.
+// One robot per run, as a process only has the robot_description of a single robot.
+//
+// usage: rosrun modulation_rl modulation_rl_bench [episodes=200] [max_steps=200] [robot=pr2] [auto_reset=0] [output=modulation_rl_bench.json]
+#include <modulation_rl/dynamic_system_pr2.h>
+#include <modulation_rl/dynamic_system_tiago.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace bench {
+    const uint32_t seed = 42;
+    const double min_goal_dist = 1.0;
+    const double max_goal_dist = 5.0;
+    const double penalty_scaling = 0.0;
+    const double time_step = 0.02;
+    const double slow_down_real_exec = 1.0;
+    const int max_allow_ik_errors = 20;
+    const double success_thres_dist = 0.02;
+    const double success_thres_rot = 0.05;
+
+    struct Config {
+        int episodes = 200;
+        int max_steps = 200;
+        std::string robot = "pr2";
+        // episodes that end with done are followed by the auto reset inside step() instead of a call to reset()
+        bool auto_reset = false;
+        std::string output = "modulation_rl_bench.json";
+    };
+
+    struct Result {
+        std::string robot;
+        std::string strategy;
+        std::string gripper_goal_distribution;
+        bool perform_collision_check;
+        std::string error;
+        int n_episodes = 0;
+        int n_steps = 0;
+        int n_success = 0;
+        double step_seconds = 0.0;
+        double reset_seconds = 0.0;
+        std::vector<double> step_latencies;
+        std::map<std::string, std::map<std::string, double>> profile;
+        std::map<std::string, double> ik_stats;
+    };
+
+    double now() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    double percentile(std::vector<double> &sorted_values, double p) {
+        if (sorted_values.empty()) {
+            return 0.0;
+        }
+        int idx = std::min((int)(p * sorted_values.size()), (int)sorted_values.size() - 1);
+        return sorted_values[idx];
+    }
+
+    Config parse_args(int argc, char **argv) {
+        Config config;
+        for (int i = 1; i < argc; i++) {
+            std::string arg(argv[i]);
+            size_t pos = arg.find('=');
+            if (pos == std::string::npos) {
+                throw std::runtime_error("Arguments must be of the form key=value, got " + arg);
+            }
+            std::string key = arg.substr(0, pos), value = arg.substr(pos + 1);
+            if (key == "episodes") {
+                config.episodes = std::stoi(value);
+            } else if (key == "max_steps") {
+                config.max_steps = std::stoi(value);
+            } else if (key == "robot") {
+                config.robot = value;
+            } else if (key == "auto_reset") {
+                config.auto_reset = (std::stoi(value) != 0);
+            } else if (key == "output") {
+                config.output = value;
+            } else {
+                throw std::runtime_error("Unknown argument " + key);
+            }
+        }
+        return config;
+    }
+
+    DynamicSystem_base *make_env(const std::string &robot, const std::string &strategy, bool perform_collision_check) {
+        if (robot == "pr2") {
+            return new DynamicSystemPR2(seed, min_goal_dist, max_goal_dist, strategy, "sim", false, penalty_scaling, time_step, slow_down_real_exec, perform_collision_check);
+        } else if (robot == "tiago") {
+            return new DynamicSystemTiago(seed, min_goal_dist, max_goal_dist, strategy, "sim", false, penalty_scaling, time_step, slow_down_real_exec, perform_collision_check);
+        }
+        throw std::runtime_error("Unknown robot " + robot);
+    }
+
+    Result run(const Config &config, const std::string &robot, const std::string &strategy, const std::string &goal_dist, bool perform_collision_check) {
+        Result result;
+        result.robot = robot;
+        result.strategy = strategy;
+        result.gripper_goal_distribution = goal_dist;
+        result.perform_collision_check = perform_collision_check;
+        result.step_latencies.reserve(config.episodes * config.max_steps);
+
+        // fixed seed for the actions as well, so every run sees the same sequence
+        std::mt19937 action_rng(seed);
+        std::uniform_real_distribution<double> action_dist(-1.0, 1.0);
+        int n_actions = (robot == "tiago") ? 2 : 3;
+
+        DynamicSystem_base *env = NULL;
+        try {
+            env = make_env(robot, strategy, perform_collision_check);
+            env->set_profiling(true);
+            if (config.auto_reset) {
+                env->set_auto_reset(true, std::vector<double>(), "rnd", goal_dist, "", success_thres_dist, success_thres_rot, 0.0);
+            }
+            const int obs_dim = env->get_obs_dim();
+            std::vector<double> base_actions(n_actions, 0.0);
+            bool needs_reset = true;
+
+            for (int ep = 0; ep < config.episodes; ep++) {
+                if (needs_reset) {
+                    double t0 = now();
+                    env->reset(std::vector<double>(), std::vector<double>(), "rnd", goal_dist, false, "", success_thres_dist, success_thres_rot, 0.0, false);
+                    result.reset_seconds += now() - t0;
+                }
+                needs_reset = true;
+                result.n_episodes++;
+
+                for (int s = 0; s < config.max_steps; s++) {
+                    for (int a = 0; a < n_actions; a++) {
+                        base_actions[a] = (strategy == "modulate_ellipse") ? 0.0 : action_dist(action_rng);
+                    }
+                    double t1 = now();
+                    std::vector<double> retval = env->step(max_allow_ik_errors, base_actions, 0.0, 0.0);
+                    double dt = now() - t1;
+                    result.step_seconds += dt;
+                    result.step_latencies.push_back(dt);
+                    result.n_steps++;
+
+                    int done_ret = (int)retval[obs_dim + 1];
+                    if (done_ret != 0) {
+                        result.n_success += (done_ret == 1);
+                        // the next episode has already been started by step()
+                        needs_reset = !config.auto_reset;
+                        break;
+                    }
+                }
+            }
+        } catch (const std::exception &e) {
+            // e.g. strategies that are not implemented for a robot
+            result.error = e.what();
+            ROS_WARN("%s / %s / %s / collision check %d: %s", robot.c_str(), strategy.c_str(), goal_dist.c_str(), perform_collision_check, e.what());
+        }
+        if (env != NULL) {
+            result.profile = env->get_profiler().get_summary();
+            result.ik_stats = env->get_ik_stats().get_summary();
+        }
+        delete env;
+        return result;
+    }
+
+    std::string to_json(std::vector<Result> &results, const Config &config) {
+        std::ostringstream out;
+        out.precision(9);
+        out << "{\n  \"episodes\": " << config.episodes << ",\n  \"max_steps\": " << config.max_steps << ",\n  \"auto_reset\": " << (config.auto_reset ? "true" : "false") << ",\n  \"seed\": " << seed << ",\n  \"results\": [";
+        for (int i = 0; i < results.size(); i++) {
+            Result &r = results[i];
+            std::sort(r.step_latencies.begin(), r.step_latencies.end());
+            out << ((i == 0) ? "\n" : ",\n") << "    {"
+                << "\"robot\": \"" << r.robot << "\", "
+                << "\"strategy\": \"" << r.strategy << "\", "
+                << "\"gripper_goal_distribution\": \"" << r.gripper_goal_distribution << "\", "
+                << "\"perform_collision_check\": " << (r.perform_collision_check ? "true" : "false") << ", ";
+            if (!r.error.empty()) {
+                std::string msg = r.error;
+                std::replace(msg.begin(), msg.end(), '"', '\'');
+                out << "\"error\": \"" << msg << "\", ";
+            }
+            out << "\"episodes\": " << r.n_episodes << ", "
+                << "\"steps\": " << r.n_steps << ", "
+                << "\"successes\": " << r.n_success << ", "
+                << "\"steps_per_sec\": " << ((r.step_seconds > 0.0) ? r.n_steps / r.step_seconds : 0.0) << ", "
+                << "\"resets_per_sec\": " << ((r.reset_seconds > 0.0) ? r.n_episodes / r.reset_seconds : 0.0) << ", "
+                << "\"step_latency_p50\": " << percentile(r.step_latencies, 0.50) << ", "
+                << "\"step_latency_p95\": " << percentile(r.step_latencies, 0.95) << ", "
+                << "\"step_latency_p99\": " << percentile(r.step_latencies, 0.99) << ", "
+                << "\"profile\": {";
+            for (auto phase = r.profile.begin(); phase != r.profile.end(); ++phase) {
+                out << ((phase == r.profile.begin()) ? "" : ", ") << "\"" << phase->first << "\": {";
+                for (auto stat = phase->second.begin(); stat != phase->second.end(); ++stat) {
+                    out << ((stat == phase->second.begin()) ? "" : ", ") << "\"" << stat->first << "\": " << stat->second;
+                }
+                out << "}";
+            }
+            out << "}, \"ik_stats\": {";
+            for (auto stat = r.ik_stats.begin(); stat != r.ik_stats.end(); ++stat) {
+                out << ((stat == r.ik_stats.begin()) ? "" : ", ") << "\"" << stat->first << "\": " << stat->second;
+            }
+            out << "}}";
+        }
+        out << "\n  ]\n}\n";
+        return out.str();
+    }
+}  // namespace bench
+
+int main(int argc, char **argv) {
+    bench::Config config = bench::parse_args(argc, argv);
+    const std::vector<std::string> strategies = {"unmodulated", "relvelm", "relveld", "dirvel", "modulate_ellipse"};
+    const std::vector<std::string> goal_dists = {"rnd", "restricted_ws"};
+
+    std::vector<bench::Result> results;
+    for (const std::string &strategy : strategies) {
+        for (const std::string &goal_dist : goal_dists) {
+            for (bool collision_check : {false, true}) {
+                ROS_INFO("Benchmarking %s / %s / %s / collision check %d", config.robot.c_str(), strategy.c_str(), goal_dist.c_str(), collision_check);
+                results.push_back(bench::run(config, config.robot, strategy, goal_dist, collision_check));
+            }
+        }
+    }
+
+    // written to a file as the ros logging shares stdout
+    std::ofstream f(config.output);
+    f << bench::to_json(results, config);
+    ROS_INFO("Written benchmark results to %s", config.output.c_str());
+    return 0;
+}
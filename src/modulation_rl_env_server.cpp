@@ -0,0 +1,60 @@
+// Hosts one env in its own process and serves step() / reset() requests of a ShmVecEnv over a shared-memory channel.
+// For robots whose MoveIt stack cannot be shared by several envs in one process. The learner creates the channel first.
+//
+// usage: rosrun modulation_rl modulation_rl_env_server channel=/mrl_env0 [robot=pr2] [seed=0] [strategy=relvelm]
+//            [min_goal_dist=1.0] [max_goal_dist=5.0] [penalty_scaling=0.0] [time_step=0.02] [perform_collision_check=0]
+//            [start_pose_distribution=rnd] [gripper_goal_distribution=rnd] [gmm_model_path=] [success_thres_dist=0.02]
+//            [success_thres_rot=0.05] [start_pause=0.0] [auto_reset=0] [ros_namespace=]
+#include <modulation_rl/env_server.h>
+#include <modulation_rl/shm_channel.h>
+
+namespace shm_server {
+    // returns false once the server should exit
+    bool serve(const env_server::Config &c, DynamicSystem_base *env, shm_channel::Channel *channel, std::vector<double> &payload) {
+        shm_channel::MessageHeader request = channel->requests().pop(payload.data(), payload.size());
+        shm_channel::MessageHeader response = {request.command, 0, 0.0, 0.0, 0};
+        std::vector<double> result;
+        try {
+            switch (request.command) {
+                case shm_channel::STEP:
+                    result = env->step(request.int_arg, std::vector<double>(payload.begin(), payload.begin() + request.size), request.noise_ee, request.noise_base);
+                    break;
+                case shm_channel::RESET:
+                    result = env_server::reset(c, env);
+                    break;
+                case shm_channel::CLOSE:
+                    break;
+                default:
+                    throw std::runtime_error("Unknown command " + std::to_string(request.command));
+            }
+        } catch (const std::exception &e) {
+            ROS_ERROR("%s: %s", c.channel.c_str(), e.what());
+            std::string msg(e.what());
+            response.command = shm_channel::ERROR;
+            result.assign(msg.begin(), msg.begin() + std::min(msg.size(), payload.size()));
+        }
+        response.size = result.size();
+        channel->responses().push(response, result.data());
+        return request.command != shm_channel::CLOSE;
+    }
+}  // namespace shm_server
+
+int main(int argc, char **argv) {
+    // unique node name so that several servers can run next to each other. The env's own ros::init() is then a no-op
+    ros::init(argc, argv, "modulation_rl_env_server", ros::init_options::AnonymousName);
+    env_server::Config config = env_server::parse_args(argc, argv);
+    if (config.channel.empty()) {
+        throw std::runtime_error("channel=<name> is required");
+    }
+    shm_channel::Channel *channel = shm_channel::Channel::open(config.channel);
+    DynamicSystem_base *env = env_server::make_env(config, config.seed);
+    if ((int)channel->requests().get_slot_capacity() < 2 * env->get_obs_dim() + 3) {
+        throw std::runtime_error("The slot capacity of " + config.channel + " is too small for the obs of " + config.robot);
+    }
+    std::vector<double> payload(channel->requests().get_slot_capacity());
+    while (shm_server::serve(config, env, channel, payload)) {
+    }
+    delete env;
+    delete channel;
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Google Benchmark microbenchmarks of the env kernels on fixed inputs. Run from the project root so the shipped models are found.
+// The utils, planner, gmm and modulation kernels run without ROS. build_obs_vector and find_ik need a robot model and are skipped
+// if no roscore / robot_description is available.
+//
+// usage: rosrun modulation_rl modulation_rl_microbench [--benchmark_filter=...] [--benchmark_format=json]
+#include <benchmark/benchmark.h>
+
+#include <modulation_rl/dynamic_system_pr2.h>
+#include <modulation_rl/gaussian_mixture_model.h>
+#include <modulation_rl/gmm_planner.h>
+#include <modulation_rl/linear_planner.h>
+#include <modulation_rl/modulation_ellipses.h>
+#include <modulation_rl/utils.h>
+
+namespace {
+    const tf::Vector3 tip_to_gripper_offset(0.18, 0.0, 0.0);
+    const tf::Quaternion gripper_to_base_rot_offset(0, 0, 0, 1);
+    const double min_planner_velocity = 0.001;
+    const double max_planner_velocity = 0.1;
+    const double dt = 0.1;
+
+    std::string model_path(const std::string &rel_path) {
+        if (std::ifstream(rel_path).good()) {
+            return rel_path;
+        } else if (std::ifstream("../" + rel_path).good()) {
+            return "../" + rel_path;
+        }
+        throw std::runtime_error(rel_path + " not found. Please run from project root.");
+    }
+
+    tf::Transform make_transform(double x, double y, double z, double roll, double pitch, double yaw) {
+        tf::Quaternion q;
+        q.setRPY(roll, pitch, yaw);
+        return tf::Transform(q, tf::Vector3(x, y, z));
+    }
+
+    // gripper goal and start poses similar to the ones drawn in reset()
+    const tf::Transform gripper_goal = make_transform(2.0, 1.0, 0.8, 0.1, 0.2, 0.3);
+    const tf::Transform gripper_start = make_transform(0.5, -0.2, 0.9, 0.0, 0.0, 0.0);
+    const tf::Transform base_start = make_transform(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+    const tf::Transform base_goal = make_transform(2.0, 1.0, 0.0, 0.0, 0.0, 0.3);
+
+    // exposes the kernels of the env. Constructed once as this needs the robot model from the parameter server
+    class BenchEnvPR2 : public DynamicSystemPR2 {
+      public:
+        BenchEnvPR2() : DynamicSystemPR2(42, 1.0, 5.0, "unmodulated", "sim", false, 0.0, 0.02, 1.0, false) {}
+        using DynamicSystemPR2::find_ik;
+        const tf::Transform &get_rel_gripper_pose() { return rel_gripper_pose_; }
+    };
+
+    BenchEnvPR2 *get_env(benchmark::State &state) {
+        static BenchEnvPR2 *env = NULL;
+        static bool tried = false;
+        if (!tried) {
+            tried = true;
+            ros::init(ros::M_string(), "modulation_rl_microbench", ros::init_options::NoSigintHandler | ros::init_options::AnonymousName);
+            if (ros::master::check()) {
+                env = new BenchEnvPR2();
+                std::vector<double> goal = {gripper_goal.getOrigin().x(), gripper_goal.getOrigin().y(), gripper_goal.getOrigin().z(), 0.1, 0.2, 0.3};
+                env->reset(goal, std::vector<double>(), "fixed", "", false, "", 0.02, 0.05, 0.0, false);
+            }
+        }
+        if (env == NULL) {
+            state.SkipWithError("No roscore running, cannot load robot_description");
+        }
+        return env;
+    }
+}  // namespace
+
+static void BM_norm_scale_vel(benchmark::State &state) {
+    tf::Vector3 vel(0.3, -0.2, 0.1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::norm_scale_vel(vel, 0.0, 0.02));
+    }
+}
+BENCHMARK(BM_norm_scale_vel);
+
+static void BM_tip_to_gripper_goal(benchmark::State &state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utils::tip_to_gripper_goal(gripper_goal, tip_to_gripper_offset, gripper_to_base_rot_offset));
+    }
+}
+BENCHMARK(BM_tip_to_gripper_goal);
+
+static void BM_gmm_loadFromFile(benchmark::State &state) {
+    std::string path = model_path("GMM_models/GMM_grasp_KallaxTuer.csv");
+    for (auto _ : state) {
+        GaussianMixtureModel gmm(0.1, 0.1);
+        if (!gmm.loadFromFile(path)) {
+            state.SkipWithError("Could not load the gmm model");
+            break;
+        }
+        benchmark::DoNotOptimize(gmm.getNr_modes());
+    }
+}
+BENCHMARK(BM_gmm_loadFromFile)->Unit(benchmark::kMicrosecond);
+
+// new goal for an existing planner, as done in every reset(). Compare with BM_gmm_loadFromFile for the cost of constructing a new one
+static void BM_gmm_planner_reinit(benchmark::State &state) {
+    std::string path = model_path("GMM_models/GMM_grasp_KallaxTuer.csv");
+    GMMPlanner *planner;
+    try {
+        planner = new GMMPlanner(tip_to_gripper_offset, gripper_to_base_rot_offset, gripper_goal, gripper_start, base_goal, base_start, path, 0.02);
+    } catch (const std::exception &e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+    for (auto _ : state) {
+        planner->reinit(gripper_goal, gripper_start, base_goal, base_start, path, 0.02);
+        benchmark::DoNotOptimize(planner->get_last_attractor());
+    }
+    delete planner;
+}
+BENCHMARK(BM_gmm_planner_reinit)->Unit(benchmark::kMicrosecond);
+
+static void BM_gmm_integrateModel(benchmark::State &state) {
+    std::string path = model_path("GMM_models/GMM_grasp_KallaxTuer.csv");
+    GaussianMixtureModel gmm(0.1, 0.1);
+    if (!gmm.loadFromFile(path)) {
+        state.SkipWithError("Could not load the gmm model");
+        return;
+    }
+    gmm.adaptModel(gripper_goal, tf::Vector3(0.02, 0, 0));
+
+    Eigen::VectorXf start_pose(14), start_speed(14);
+    start_pose << 0.5, -0.2, 0.9, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0;
+    start_speed.setZero();
+    double time = 0.0;
+    for (auto _ : state) {
+        // integrate from the same state every iteration, otherwise the model converges and the workload changes
+        Eigen::VectorXf pose = start_pose, speed = start_speed;
+        gmm.integrateModel(time, dt, &pose, &speed, min_planner_velocity, max_planner_velocity, false);
+        benchmark::DoNotOptimize(pose.data());
+        time = (time > 20.0) ? 0.0 : time + dt;
+    }
+}
+BENCHMARK(BM_gmm_integrateModel);
+
+static void BM_modulation_run(benchmark::State &state) {
+    modulation_ellipses::Modulation modulation;
+    try {
+        modulation.setEllipses();
+    } catch (const std::exception &e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+    // layout as in DynamicSystem_base::calc_desired_base_transform()
+    Eigen::VectorXf start_pose(14), start_speed(14);
+    start_pose << 0.7, 0.1, 0.8, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0;
+    start_speed << 0.01, 0.005, 0.0, 0.0, 0.0, 0.0, 0.0, 0.01, 0.005, 0.0, 0.0, 0.0, 0.0001, 0.0;
+    for (auto _ : state) {
+        Eigen::VectorXf pose = start_pose, speed = start_speed;
+        modulation.run(pose, speed);
+        benchmark::DoNotOptimize(speed.data());
+    }
+}
+BENCHMARK(BM_modulation_run)->Unit(benchmark::kMicrosecond);
+
+static void BM_linear_planner_get_next_velocities(benchmark::State &state) {
+    LinearPlanner planner(gripper_goal, gripper_start, base_goal, base_start);
+    tf::Vector3 zero(0, 0, 0);
+    tf::Quaternion dq(0, 0, 0, 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(planner.get_next_velocities(0.0, dt, base_start, gripper_start, zero, zero, dq, min_planner_velocity, max_planner_velocity, false));
+    }
+}
+BENCHMARK(BM_linear_planner_get_next_velocities);
+
+static void BM_build_obs_vector(benchmark::State &state) {
+    BenchEnvPR2 *env = get_env(state);
+    if (env == NULL) {
+        return;
+    }
+    tf::Vector3 zero(0, 0, 0);
+    tf::Quaternion dq(0, 0, 0, 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(env->build_obs_vector(zero, zero, dq));
+    }
+}
+BENCHMARK(BM_build_obs_vector);
+
+static void BM_find_ik(benchmark::State &state) {
+    BenchEnvPR2 *env = get_env(state);
+    if (env == NULL) {
+        return;
+    }
+    // small offset from the current (neutral) gripper pose, i.e. the typical case during an episode
+    tf::Transform desired = env->get_rel_gripper_pose();
+    desired.setOrigin(desired.getOrigin() + tf::Vector3(0.01, 0.0, 0.0));
+    Eigen::Isometry3d desired_state;
+    tf::poseTFToEigen(desired, desired_state);
+    int64_t n_success = 0;
+    for (auto _ : state) {
+        n_success += env->find_ik(desired_state, base_start * desired);
+    }
+    state.counters["success_rate"] = benchmark::Counter((double)n_success / state.iterations());
+}
+BENCHMARK(BM_find_ik)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,162 @@
+// Hosts num_envs envs and serves batched step() / reset() requests of a SocketVecEnv over a tcp or unix socket, so that env
+// workers can be spread over several machines. Serves one client at a time until it sends CLOSE.
+//
+// usage: rosrun modulation_rl modulation_rl_socket_server address=0.0.0.0:5555|unix:/tmp/mrl.sock [num_envs=1] [parallel_steps=1]
+//            [robot=pr2] [seed=0] [strategy=relvelm] [...], see modulation_rl_env_server for the env and reset arguments
+#include <modulation_rl/env_server.h>
+#include <modulation_rl/socket_protocol.h>
+
+#include <unistd.h>
+#include <limits>
+
+namespace socket_server {
+    std::vector<double> step_batch(const env_server::Config &c,
+                                   std::vector<DynamicSystem_base *> &envs,
+                                   const socket_protocol::FrameHeader &request,
+                                   const std::vector<double> &actions) {
+        if (request.rows != envs.size()) {
+            throw std::runtime_error("Expected one row of base actions per env");
+        }
+        const int obs_dim = envs[0]->get_obs_dim(), cols = 2 * obs_dim + 3;
+        std::vector<double> result(envs.size() * cols, std::numeric_limits<double>::quiet_NaN());
+        std::vector<std::vector<double>> retvals(envs.size());
+        std::string error;
+        if (c.parallel_steps) {
+            // an env that failed to start must not leave the others' steps running in the background
+            std::vector<bool> started(envs.size(), false);
+            for (int i = 0; i < envs.size(); i++) {
+                std::vector<double> base_actions(actions.begin() + i * request.cols, actions.begin() + (i + 1) * request.cols);
+                try {
+                    envs[i]->step_async(request.int_arg, base_actions, request.noise_ee, request.noise_base);
+                    started[i] = true;
+                } catch (const std::exception &e) {
+                    error += std::string(e.what()) + "\n";
+                }
+            }
+            // wait for all of them before reporting an error
+            for (int i = 0; i < envs.size(); i++) {
+                if (!started[i]) {
+                    continue;
+                }
+                try {
+                    retvals[i] = envs[i]->step_wait();
+                } catch (const std::exception &e) {
+                    error += std::string(e.what()) + "\n";
+                }
+            }
+        } else {
+            for (int i = 0; i < envs.size(); i++) {
+                std::vector<double> base_actions(actions.begin() + i * request.cols, actions.begin() + (i + 1) * request.cols);
+                retvals[i] = envs[i]->step(request.int_arg, base_actions, request.noise_ee, request.noise_base);
+            }
+        }
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+        for (int i = 0; i < envs.size(); i++) {
+            std::copy(retvals[i].begin(), retvals[i].end(), result.begin() + i * cols);
+        }
+        return result;
+    }
+
+    // empty request: all envs, otherwise one mask entry per env
+    std::vector<double> reset_masked(const env_server::Config &c,
+                                     std::vector<DynamicSystem_base *> &envs,
+                                     const socket_protocol::FrameHeader &request,
+                                     const std::vector<double> &mask) {
+        if ((request.rows != 0) && ((request.rows != envs.size()) || (request.cols != 1))) {
+            throw std::runtime_error("Expected one reset mask entry per env");
+        }
+        const int obs_dim = envs[0]->get_obs_dim();
+        std::vector<double> result(envs.size() * obs_dim, std::numeric_limits<double>::quiet_NaN());
+        for (int i = 0; i < envs.size(); i++) {
+            if ((request.rows == 0) || (mask[i] != 0.0)) {
+                std::vector<double> obs = env_server::reset(c, envs[i]);
+                std::copy(obs.begin(), obs.end(), result.begin() + i * obs_dim);
+            }
+        }
+        return result;
+    }
+
+    // returns false once the client sent CLOSE
+    bool serve_connection(const env_server::Config &c, std::vector<DynamicSystem_base *> &envs, int fd) {
+        const uint32_t num_envs = envs.size(), obs_dim = envs[0]->get_obs_dim();
+        std::vector<double> request_data, result;
+        while (true) {
+            socket_protocol::FrameHeader request;
+            try {
+                request = socket_protocol::recv_frame(fd, request_data);
+            } catch (const std::exception &e) {
+                ROS_WARN("Client disconnected: %s", e.what());
+                return true;
+            }
+            socket_protocol::FrameHeader response = socket_protocol::make_header((socket_protocol::Command)request.command, request.request_id, num_envs, 0);
+            std::string error;
+            try {
+                switch (request.command) {
+                    case socket_protocol::INFO:
+                        result = {(double)num_envs, (double)obs_dim};
+                        response.rows = 1;
+                        response.cols = 2;
+                        break;
+                    case socket_protocol::RESET:
+                        result = reset_masked(c, envs, request, request_data);
+                        response.cols = obs_dim;
+                        break;
+                    case socket_protocol::STEP:
+                        result = step_batch(c, envs, request, request_data);
+                        response.cols = 2 * obs_dim + 3;
+                        break;
+                    case socket_protocol::CLOSE:
+                        result.clear();
+                        break;
+                    default:
+                        throw std::runtime_error("Unknown command " + std::to_string(request.command));
+                }
+            } catch (const std::exception &e) {
+                ROS_ERROR("%s", e.what());
+                error = e.what();
+            }
+            try {
+                if (error.empty()) {
+                    socket_protocol::send_frame(fd, response, result.data());
+                } else {
+                    socket_protocol::send_error(fd, request.request_id, error);
+                }
+            } catch (const std::exception &e) {
+                ROS_WARN("Client disconnected: %s", e.what());
+                return true;
+            }
+            if ((request.command == socket_protocol::CLOSE) && error.empty()) {
+                return false;
+            }
+        }
+    }
+}  // namespace socket_server
+
+int main(int argc, char **argv) {
+    // unique node name so that several servers can run on one host. The envs' own ros::init() is then a no-op
+    ros::init(argc, argv, "modulation_rl_socket_server", ros::init_options::AnonymousName);
+    env_server::Config config = env_server::parse_args(argc, argv);
+    if (config.address.empty() || (config.num_envs < 1)) {
+        throw std::runtime_error("address=<host:port|unix:/path> and num_envs >= 1 are required");
+    }
+    std::vector<DynamicSystem_base *> envs;
+    for (int i = 0; i < config.num_envs; i++) {
+        envs.push_back(env_server::make_env(config, config.seed + i));
+    }
+    int listen_fd = socket_protocol::listen_on(config.address);
+    ROS_INFO("Serving %d %s envs on %s", config.num_envs, config.robot.c_str(), config.address.c_str());
+
+    bool keep_serving = true;
+    while (keep_serving) {
+        int fd = socket_protocol::accept_connection(listen_fd);
+        keep_serving = socket_server::serve_connection(config, envs, fd);
+        close(fd);
+    }
+    close(listen_fd);
+    for (DynamicSystem_base *env : envs) {
+        delete env;
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <modulation_rl/profiler.h>
+
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace profiler {
+    const char *phase_name(Phase phase) {
+        switch (phase) {
+            case STEP: return "step";
+            case PLANNER: return "planner";
+            case BASE_TRANSFORM: return "base_transform";
+            case MODULATION: return "modulation";
+            case IK: return "ik";
+            case FK: return "fk";
+            case EXECUTION: return "execution";
+            case VISUALIZATION: return "visualization";
+            case TRAJECTORY: return "trajectory";
+            case OBS: return "obs";
+            case RESET: return "reset";
+            case START_POSE: return "start_pose";
+            case SET_GOAL: return "set_goal";
+            case GMM_LOAD: return "gmm_load";
+            case ACTION_REPEAT: return "action_repeat";
+            case COLLISION_CHECK: return "collision_check";
+            default: return "unknown";
+        }
+    }
+
+    void Histogram::add(double seconds) {
+        count++;
+        total += seconds;
+        min = std::min(min, seconds);
+        max = std::max(max, seconds);
+
+        double us = seconds * 1e6;
+        int bucket = (us < 2.0) ? 0 : (int)log2(us);
+        buckets[std::min(bucket, N_BUCKETS - 1)]++;
+    }
+
+    void Histogram::reset() {
+        count = 0;
+        total = 0.0;
+        min = std::numeric_limits<double>::max();
+        max = 0.0;
+        buckets.fill(0);
+    }
+
+    double Histogram::percentile(double p) const {
+        if (count == 0) {
+            return 0.0;
+        }
+        uint64_t target = (uint64_t)ceil(p * count);
+        uint64_t cumsum = 0;
+        for (int i = 0; i < N_BUCKETS; i++) {
+            cumsum += buckets[i];
+            if (cumsum >= target) {
+                // never report more than the largest value we have actually seen
+                return std::min(pow(2.0, i + 1) * 1e-6, max);
+            }
+        }
+        return max;
+    }
+
+    std::map<std::string, std::map<std::string, double>> Profiler::get_summary() const {
+        std::map<std::string, std::map<std::string, double>> summary;
+        for (int i = 0; i < N_PHASES; i++) {
+            const Histogram &h = histograms_[i];
+            if (h.count == 0) {
+                continue;
+            }
+            std::map<std::string, double> &s = summary[phase_name((Phase)i)];
+            s["count"] = h.count;
+            s["total"] = h.total;
+            s["mean"] = h.total / h.count;
+            s["min"] = h.min;
+            s["max"] = h.max;
+            s["p50"] = h.percentile(0.5);
+            s["p95"] = h.percentile(0.95);
+            s["p99"] = h.percentile(0.99);
+        }
+        return summary;
+    }
+
+    void Profiler::reset() {
+        for (Histogram &h : histograms_) {
+            h.reset();
+        }
+    }
+
+    std::vector<TraceEvent> TraceRing::snapshot() const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t n = std::min<uint64_t>(head, events_.size());
+        std::vector<TraceEvent> events;
+        events.reserve(n);
+        for (uint64_t i = head - n; i < head; i++) {
+            events.push_back(events_[i % events_.size()]);
+        }
+        return events;
+    }
+
+    namespace {
+        std::atomic<uint64_t> next_recorder_id(1);
+    }
+
+    TraceRecorder::TraceRecorder(size_t capacity) : id_(next_recorder_id.fetch_add(1)), capacity_(capacity){};
+
+    TraceRing &TraceRecorder::local_ring() {
+        // ring of this thread per recorder, keyed by id so that a new recorder at the address of a deleted one never finds a stale ring
+        thread_local std::vector<std::pair<uint64_t, TraceRing *>> cache;
+        for (const std::pair<uint64_t, TraceRing *> &entry : cache) {
+            if (entry.first == id_) {
+                return *entry.second;
+            }
+        }
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings_.emplace_back(new TraceRing(capacity_, rings_.size() + 1));
+        cache.push_back(std::make_pair(id_, rings_.back().get()));
+        return *rings_.back();
+    }
+
+    void TraceRecorder::record(Phase phase, Clock::time_point start, Clock::time_point end) {
+        TraceEvent event;
+        event.phase = phase;
+        event.start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+        event.dur_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        local_ring().push(event);
+    }
+
+    void TraceRecorder::dump_chrome_trace(const std::string &filename) {
+        std::ofstream f(filename);
+        if (!f.good()) {
+            throw std::runtime_error("Could not open " + filename + " to write the trace");
+        }
+        f.precision(15);
+        f << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        bool first = true;
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const std::unique_ptr<TraceRing> &ring : rings_) {
+            for (const TraceEvent &e : ring->snapshot()) {
+                // complete events ("X") carry both begin and end, so a wrapped ring never leaves unmatched begin events
+                f << (first ? "\n" : ",\n") << "{\"name\": \"" << phase_name(e.phase) << "\", \"cat\": \"env\", \"ph\": \"X\", \"pid\": " << getpid()
+                  << ", \"tid\": " << ring->tid << ", \"ts\": " << e.start_ns / 1000.0 << ", \"dur\": " << e.dur_ns / 1000.0 << "}";
+                first = false;
+            }
+        }
+        f << "\n]}\n";
+    }
+
+    void TraceRecorder::clear() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const std::unique_ptr<TraceRing> &ring : rings_) {
+            ring->clear();
+        }
+    }
+}  // namespace profiler
@@ -0,0 +1,57 @@
+#include <modulation_rl/realtime.h>
+
+#include <alloca.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <stdexcept>
+#include <string>
+
+namespace realtime {
+    void lock_memory() {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            throw std::runtime_error(std::string("mlockall failed: ") + strerror(errno));
+        }
+        // no trimming of the heap and no separate mmaps for large blocks, both would give locked memory back
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+    }
+
+    void unlock_memory() {
+        if (munlockall() != 0) {
+            throw std::runtime_error(std::string("munlockall failed: ") + strerror(errno));
+        }
+        mallopt(M_TRIM_THRESHOLD, 128 * 1024);
+        mallopt(M_MMAP_MAX, 65536);
+    }
+
+    void prefault_stack(size_t bytes) {
+        volatile unsigned char *stack = (volatile unsigned char *)alloca(bytes);
+        for (size_t i = 0; i < bytes; i += 4096) {
+            stack[i] = 0;
+        }
+    }
+
+    void configure_current_thread(int priority, int cpu) {
+        if (priority > 0) {
+            sched_param param;
+            param.sched_priority = priority;
+            int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (err != 0) {
+                throw std::runtime_error("Could not set SCHED_FIFO priority " + std::to_string(priority) + ": " + strerror(err));
+            }
+        }
+        if (cpu >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            if (err != 0) {
+                throw std::runtime_error("Could not pin the thread to cpu " + std::to_string(cpu) + ": " + strerror(err));
+            }
+        }
+    }
+}  // namespace realtime
@@ -0,0 +1,135 @@
+#include <modulation_rl/robot_state_cache.h>
+
+namespace robot_state_cache {
+    RobotStateCache::RobotStateCache(ros::NodeHandle &nh,
+                                     const std::vector<std::string> &joint_names,
+                                     const std::string &joint_states_topic,
+                                     const std::string &scene_topic,
+                                     const std::vector<moveit_msgs::CollisionObject> &known_objects) :
+        joint_names_{joint_names},
+        positions_(joint_names.size(), 0.0),
+        received_(joint_names.size(), false) {
+        // before subscribing, objects_ belongs to the scene callback afterwards
+        for (const moveit_msgs::CollisionObject &object : known_objects) {
+            objects_[object.id] = object;
+            objects_[object.id].operation = moveit_msgs::CollisionObject::ADD;
+        }
+        joint_states_sub_ = nh.subscribe(joint_states_topic, 10, &RobotStateCache::joint_states_callback, this, ros::TransportHints().tcpNoDelay());
+        scene_sub_ = nh.subscribe(scene_topic, 10, &RobotStateCache::scene_callback, this);
+    }
+
+    void RobotStateCache::joint_states_callback(const sensor_msgs::JointState::ConstPtr &msg) {
+        if (msg->name != msg_names_) {
+            msg_names_ = msg->name;
+            msg_index_.assign(msg->name.size(), -1);
+            for (int i = 0; i < msg->name.size(); i++) {
+                for (int j = 0; j < joint_names_.size(); j++) {
+                    if (msg->name[i] == joint_names_[j]) {
+                        msg_index_[i] = j;
+                        break;
+                    }
+                }
+            }
+        }
+        bool updated = false;
+        for (int i = 0; i < msg_index_.size() && i < msg->position.size(); i++) {
+            int j = msg_index_[i];
+            if (j < 0) {
+                continue;
+            }
+            positions_[j] = msg->position[i];
+            if (!received_[j]) {
+                received_[j] = true;
+                n_received_++;
+            }
+            updated = true;
+        }
+        if (!updated) {
+            return;
+        }
+        double command_time = command_time_.load(std::memory_order_acquire);
+        if ((command_time > 0.0) && (msg->header.stamp.toSec() >= command_time) &&
+            command_time_.compare_exchange_strong(command_time, 0.0, std::memory_order_acq_rel)) {
+            feedback_sample_delay_.store(msg->header.stamp.toSec() - command_time, std::memory_order_release);
+        }
+        if (n_received_ < (int)joint_names_.size()) {
+            return;
+        }
+        JointSnapshot &snapshot = joints_.back();
+        snapshot.positions = positions_;
+        snapshot.stamp = msg->header.stamp;
+        joints_.publish();
+    }
+
+    void RobotStateCache::scene_callback(const moveit_msgs::PlanningScene::ConstPtr &msg) {
+        if (!msg->is_diff) {
+            objects_.clear();
+        }
+        if (msg->world.collision_objects.empty() && msg->is_diff) {
+            // only robot state updates
+            return;
+        }
+        for (const moveit_msgs::CollisionObject &object : msg->world.collision_objects) {
+            if (object.operation == moveit_msgs::CollisionObject::REMOVE) {
+                if (object.id.empty()) {
+                    objects_.clear();
+                } else {
+                    objects_.erase(object.id);
+                }
+            } else if (object.operation == moveit_msgs::CollisionObject::ADD) {
+                objects_[object.id] = object;
+            } else {
+                // APPEND / MOVE: keep it simple and take the newest description if it is complete
+                std::map<std::string, moveit_msgs::CollisionObject>::iterator it = objects_.find(object.id);
+                if ((it == objects_.end()) || !object.primitives.empty() || !object.meshes.empty()) {
+                    objects_[object.id] = object;
+                    objects_[object.id].operation = moveit_msgs::CollisionObject::ADD;
+                } else {
+                    it->second.header = object.header;
+                    it->second.primitive_poses = object.primitive_poses;
+                    it->second.mesh_poses = object.mesh_poses;
+                }
+            }
+        }
+        WorldSnapshot &snapshot = world_.back();
+        snapshot.objects.clear();
+        for (const std::pair<const std::string, moveit_msgs::CollisionObject> &object : objects_) {
+            snapshot.objects.push_back(object.second);
+        }
+        snapshot.version = ++world_version_;
+        world_.publish();
+    }
+
+    bool RobotStateCache::get_joint_values(std::vector<double> &values) {
+        joints_.update();
+        const JointSnapshot &snapshot = joints_.front();
+        if (snapshot.positions.empty()) {
+            return false;
+        }
+        values = snapshot.positions;
+        return true;
+    }
+
+    bool RobotStateCache::take_feedback_sample_delay(double &delay) {
+        double d = feedback_sample_delay_.exchange(-1.0, std::memory_order_acq_rel);
+        if (d < 0.0) {
+            return false;
+        }
+        delay = d;
+        return true;
+    }
+
+    bool RobotStateCache::update_world(planning_scene::PlanningScenePtr scene) {
+        world_.update();
+        const WorldSnapshot &snapshot = world_.front();
+        if (snapshot.version == applied_world_version_) {
+            return false;
+        }
+        scene->removeAllCollisionObjects();
+        for (const moveit_msgs::CollisionObject &object : snapshot.objects) {
+            scene->processCollisionObjectMsg(object);
+        }
+        applied_world_version_ = snapshot.version;
+        return true;
+    }
+}  // namespace robot_state_cache
@@ -0,0 +1,181 @@
+#include <modulation_rl/shm_channel.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace shm_channel {
+    namespace {
+        const uint32_t MAGIC = 0x4d524c43;
+
+        struct ChannelHeader {
+            uint32_t magic;
+            uint32_t n_slots;
+            uint32_t slot_capacity;
+            std::atomic<int32_t> client_pid;
+            std::atomic<int32_t> server_pid;
+            RingHeader requests;
+            RingHeader responses;
+        };
+
+        // not FUTEX_PRIVATE_FLAG: the word is shared between processes
+        void futex_wait(const std::atomic<uint32_t> *word, uint32_t value, const timespec *timeout) {
+            syscall(SYS_futex, reinterpret_cast<const uint32_t *>(word), FUTEX_WAIT, value, timeout, NULL, 0);
+        }
+
+        void futex_wake(std::atomic<uint32_t> *word) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+        }
+
+        size_t total_bytes(uint32_t n_slots, uint32_t slot_capacity) {
+            return sizeof(ChannelHeader) + 2 * Ring::bytes(n_slots, slot_capacity);
+        }
+    }  // namespace
+
+    Ring::Ring(RingHeader *header, char *slots, uint32_t n_slots, uint32_t slot_capacity, const std::atomic<int32_t> *peer_pid) :
+        header_{header},
+        slots_{slots},
+        n_slots_{n_slots},
+        slot_capacity_{slot_capacity},
+        peer_pid_{peer_pid} {};
+
+    size_t Ring::bytes(uint32_t n_slots, uint32_t slot_capacity) {
+        return n_slots * (sizeof(MessageHeader) + slot_capacity * sizeof(double));
+    }
+
+    void Ring::wait_while_equal(const std::atomic<uint32_t> &word, uint32_t value) {
+        // wake up regularly to notice a peer that died without waking us
+        const timespec timeout = {0, 100 * 1000 * 1000};
+        while (word.load(std::memory_order_acquire) == value) {
+            futex_wait(&word, value, &timeout);
+            int32_t pid = peer_pid_->load();
+            if ((pid != 0) && (kill(pid, 0) != 0) && (errno == ESRCH)) {
+                throw std::runtime_error("The process on the other end of the shm channel exited");
+            }
+        }
+    }
+
+    void Ring::push(const MessageHeader &header, const double *payload) {
+        if (header.size > slot_capacity_) {
+            throw std::runtime_error("Message of " + std::to_string(header.size) + " doubles exceeds the slot capacity of " + std::to_string(slot_capacity_));
+        }
+        uint32_t head = header_->head.load(std::memory_order_relaxed);
+        uint32_t tail;
+        while (head - (tail = header_->tail.load(std::memory_order_acquire)) >= n_slots_) {
+            wait_while_equal(header_->tail, tail);
+        }
+        char *slot = slots_ + (head % n_slots_) * slot_bytes();
+        std::memcpy(slot, &header, sizeof(MessageHeader));
+        if (header.size > 0) {
+            std::memcpy(slot + sizeof(MessageHeader), payload, header.size * sizeof(double));
+        }
+        header_->head.store(head + 1, std::memory_order_release);
+        futex_wake(&header_->head);
+    }
+
+    MessageHeader Ring::pop(double *out, uint32_t capacity) {
+        uint32_t tail = header_->tail.load(std::memory_order_relaxed);
+        wait_while_equal(header_->head, tail);
+        const char *slot = slots_ + (tail % n_slots_) * slot_bytes();
+        MessageHeader header;
+        std::memcpy(&header, slot, sizeof(MessageHeader));
+        std::memcpy(out, slot + sizeof(MessageHeader), std::min(header.size, capacity) * sizeof(double));
+        header_->tail.store(tail + 1, std::memory_order_release);
+        futex_wake(&header_->tail);
+        return header;
+    }
+
+    Channel::Channel(const std::string &name, bool owner, void *memory, size_t bytes) : name_{name}, owner_{owner}, memory_{memory}, bytes_{bytes} {
+        ChannelHeader *header = static_cast<ChannelHeader *>(memory_);
+        char *slots = static_cast<char *>(memory_) + sizeof(ChannelHeader);
+        size_t ring_bytes = Ring::bytes(header->n_slots, header->slot_capacity);
+        // the peer of the learner is the server and vice versa
+        const std::atomic<int32_t> *peer = owner ? &header->server_pid : &header->client_pid;
+        requests_ = Ring(&header->requests, slots, header->n_slots, header->slot_capacity, peer);
+        responses_ = Ring(&header->responses, slots + ring_bytes, header->n_slots, header->slot_capacity, peer);
+    }
+
+    Channel *Channel::create(const std::string &name, uint32_t n_slots, uint32_t slot_capacity) {
+        if (n_slots == 0) {
+            throw std::runtime_error("A shm channel needs at least one slot");
+        }
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open(" + name + ") failed: " + std::strerror(errno));
+        }
+        size_t bytes = total_bytes(n_slots, slot_capacity);
+        if (ftruncate(fd, bytes) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error("ftruncate(" + name + ") failed: " + std::strerror(errno));
+        }
+        void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            throw std::runtime_error("mmap(" + name + ") failed: " + std::strerror(errno));
+        }
+        // fresh pages are zeroed, which is a valid state for the atomics
+        ChannelHeader *header = static_cast<ChannelHeader *>(memory);
+        header->n_slots = n_slots;
+        header->slot_capacity = slot_capacity;
+        header->client_pid.store(getpid());
+        header->magic = MAGIC;
+        return new Channel(name, true, memory, bytes);
+    }
+
+    Channel *Channel::open(const std::string &name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open(" + name + ") failed: " + std::strerror(errno));
+        }
+        struct stat st;
+        if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(ChannelHeader))) {
+            close(fd);
+            throw std::runtime_error(name + " is not a shm channel");
+        }
+        void *memory = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error("mmap(" + name + ") failed: " + std::strerror(errno));
+        }
+        ChannelHeader *header = static_cast<ChannelHeader *>(memory);
+        if ((header->magic != MAGIC) || ((size_t)st.st_size != total_bytes(header->n_slots, header->slot_capacity))) {
+            munmap(memory, st.st_size);
+            throw std::runtime_error(name + " is not a shm channel");
+        }
+        header->server_pid.store(getpid());
+        return new Channel(name, false, memory, st.st_size);
+    }
+
+    Channel::~Channel() {
+        munmap(memory_, bytes_);
+        if (owner_) {
+            shm_unlink(name_.c_str());
+        }
+    }
+
+    bool Channel::wait_for_server(double timeout) {
+        const ChannelHeader *header = static_cast<const ChannelHeader *>(memory_);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+        while (header->server_pid.load() == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+}  // namespace shm_channel
@@ -0,0 +1,147 @@
+#include <modulation_rl/shm_vec_env.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+ShmVecEnv::ShmVecEnv(std::vector<std::string> channel_names, uint32_t n_slots, uint32_t slot_capacity) : buffer_(slot_capacity) {
+    try {
+        for (const std::string &name : channel_names) {
+            channels_.push_back(shm_channel::Channel::create(name, n_slots, slot_capacity));
+        }
+    } catch (...) {
+        for (shm_channel::Channel *channel : channels_) {
+            delete channel;
+        }
+        throw;
+    }
+}
+
+ShmVecEnv::~ShmVecEnv() {
+    for (shm_channel::Channel *channel : channels_) {
+        delete channel;
+    }
+}
+
+bool ShmVecEnv::wait_for_servers(double timeout) {
+    for (shm_channel::Channel *channel : channels_) {
+        if (!channel->wait_for_server(timeout)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShmVecEnv::collect(shm_channel::Command command, const std::vector<int> &envs, Eigen::MatrixXd &result) {
+    // every response is read before reporting an error, unread ones would be taken as the replies to the next request
+    std::string error;
+    for (int i : envs) {
+        shm_channel::MessageHeader response = channels_[i]->responses().pop(buffer_.data(), buffer_.size());
+        const uint32_t size = std::min<uint32_t>(response.size, buffer_.size());
+        if (response.command == shm_channel::ERROR) {
+            error += channels_[i]->get_name() + ": " + std::string(buffer_.begin(), buffer_.begin() + size) + "\n";
+            continue;
+        }
+        if (response.command != command) {
+            error += "Unexpected response from " + channels_[i]->get_name() + "\n";
+            continue;
+        }
+        if (command == shm_channel::RESET) {
+            if (obs_dim_ < 0) {
+                obs_dim_ = response.size;
+                result = Eigen::MatrixXd::Constant(channels_.size(), obs_dim_, std::numeric_limits<double>::quiet_NaN());
+            } else if (response.size != (uint32_t)obs_dim_) {
+                error += channels_[i]->get_name() + ": the env servers do not share the same obs dim\n";
+                continue;
+            }
+        }
+        if (response.size > result.cols()) {
+            error += "Response of " + channels_[i]->get_name() + " is larger than expected\n";
+            continue;
+        }
+        for (uint32_t j = 0; j < size; j++) {
+            result(i, j) = buffer_[j];
+        }
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+std::vector<int> ShmVecEnv::all_envs() const {
+    std::vector<int> envs(channels_.size());
+    for (size_t i = 0; i < envs.size(); i++) {
+        envs[i] = i;
+    }
+    return envs;
+}
+
+Eigen::MatrixXd ShmVecEnv::reset(const std::vector<bool> &mask) {
+    if (step_pending_) {
+        throw std::runtime_error("reset() called before step_wait()");
+    }
+    if (!mask.empty() && (mask.size() != channels_.size())) {
+        throw std::runtime_error("Need one reset mask entry per env");
+    }
+    std::vector<int> envs;
+    for (size_t i = 0; i < channels_.size(); i++) {
+        if (mask.empty() || mask[i]) {
+            envs.push_back(i);
+        }
+    }
+    shm_channel::MessageHeader request = {shm_channel::RESET, 0, 0.0, 0.0, 0};
+    for (int i : envs) {
+        channels_[i]->requests().push(request, NULL);
+    }
+    Eigen::MatrixXd obs = Eigen::MatrixXd::Constant(channels_.size(), std::max(obs_dim_, 0), std::numeric_limits<double>::quiet_NaN());
+    collect(shm_channel::RESET, envs, obs);
+    return obs;
+}
+
+void ShmVecEnv::step_async(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base) {
+    if (obs_dim_ < 0) {
+        throw std::runtime_error("reset() has to be called before the first step");
+    }
+    if (step_pending_) {
+        throw std::runtime_error("step_async() called before step_wait() returned the previous step");
+    }
+    if ((size_t)base_actions.rows() != channels_.size()) {
+        throw std::runtime_error("Need one row of base actions per env");
+    }
+    shm_channel::MessageHeader request = {shm_channel::STEP, max_allow_ik_errors, transition_noise_ee, transition_noise_base, (uint32_t)base_actions.cols()};
+    std::vector<double> actions(base_actions.cols());
+    for (size_t i = 0; i < channels_.size(); i++) {
+        for (int j = 0; j < base_actions.cols(); j++) {
+            actions[j] = base_actions(i, j);
+        }
+        channels_[i]->requests().push(request, actions.data());
+    }
+    step_pending_ = true;
+}
+
+Eigen::MatrixXd ShmVecEnv::step_wait() {
+    if (!step_pending_) {
+        throw std::runtime_error("step_wait() called without a pending step_async()");
+    }
+    step_pending_ = false;
+    Eigen::MatrixXd result = Eigen::MatrixXd::Constant(channels_.size(), 2 * obs_dim_ + 3, std::numeric_limits<double>::quiet_NaN());
+    collect(shm_channel::STEP, all_envs(), result);
+    return result;
+}
+
+Eigen::MatrixXd ShmVecEnv::step(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base) {
+    step_async(base_actions, max_allow_ik_errors, transition_noise_ee, transition_noise_base);
+    return step_wait();
+}
+
+void ShmVecEnv::close() {
+    if (step_pending_) {
+        step_wait();
+    }
+    shm_channel::MessageHeader request = {shm_channel::CLOSE, 0, 0.0, 0.0, 0};
+    for (shm_channel::Channel *channel : channels_) {
+        channel->requests().push(request, NULL);
+    }
+    Eigen::MatrixXd ignored;
+    collect(shm_channel::CLOSE, all_envs(), ignored);
+}
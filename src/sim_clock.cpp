@@ -0,0 +1,59 @@
+#include <modulation_rl/sim_clock.h>
+
+#include <std_srvs/Empty.h>
+#include <chrono>
+
+namespace sim_clock {
+    LockstepClock::LockstepClock(ros::NodeHandle &nh, const std::string &clock_topic, const std::string &pause_service, const std::string &unpause_service) {
+        clock_sub_ = nh.subscribe(clock_topic, 10, &LockstepClock::clock_callback, this, ros::TransportHints().tcpNoDelay());
+        pause_client_ = nh.serviceClient<std_srvs::Empty>(pause_service, true);
+        unpause_client_ = nh.serviceClient<std_srvs::Empty>(unpause_service, true);
+        if (!pause_client_.waitForExistence(ros::Duration(10.0)) || !unpause_client_.waitForExistence(ros::Duration(10.0))) {
+            throw std::runtime_error("Services " + pause_service + " and " + unpause_service + " not available");
+        }
+    }
+
+    void LockstepClock::clock_callback(const rosgraph_msgs::Clock::ConstPtr &msg) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            now_ = msg->clock.toSec();
+        }
+        clock_cv_.notify_all();
+    }
+
+    void LockstepClock::call(ros::ServiceClient &client) {
+        std_srvs::Empty srv;
+        if (!client.call(srv)) {
+            throw std::runtime_error("Failed to call service " + client.getService());
+        }
+    }
+
+    double LockstepClock::now() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return now_;
+    }
+
+    bool LockstepClock::wait_until(double time, double timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return clock_cv_.wait_for(lock, std::chrono::duration<double>(timeout), [this, time] { return now_ >= time; });
+    }
+
+    double LockstepClock::advance(double dt, double timeout) {
+        // the clock is only published while the simulation runs, so the first call may have to unpause to see it
+        const double start = now();
+        unpause();
+        if (start < 0.0) {
+            if (!wait_until(0.0, timeout)) {
+                pause();
+                throw std::runtime_error("No message on " + clock_sub_.getTopic());
+            }
+        }
+        const double from = (start < 0.0) ? now() : start;
+        bool reached = wait_until(from + dt, timeout);
+        pause();
+        if (!reached) {
+            throw std::runtime_error("Simulation clock did not advance by " + std::to_string(dt) + " s within " + std::to_string(timeout) + " s");
+        }
+        return now() - from;
+    }
+}  // namespace sim_clock
@@ -0,0 +1,211 @@
+#include <modulation_rl/socket_protocol.h>
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace socket_protocol {
+    namespace {
+        const uint32_t MAGIC = 0x4d524c53;
+        // a frame larger than this is treated as a corrupt stream
+        const uint64_t MAX_FRAME_DOUBLES = 1 << 24;
+
+        std::string errno_string(const std::string &what) { return what + ": " + std::strerror(errno); }
+
+        bool is_unix(const std::string &address) { return address.compare(0, 5, "unix:") == 0; }
+
+        sockaddr_un unix_address(const std::string &address) {
+            std::string path = address.substr(5);
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(addr.sun_path)) {
+                throw std::runtime_error("Unix socket path too long: " + path);
+            }
+            std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            return addr;
+        }
+
+        addrinfo *tcp_address(const std::string &address, bool passive) {
+            size_t pos = address.rfind(':');
+            if (pos == std::string::npos) {
+                throw std::runtime_error("Address must be host:port or unix:/path, got " + address);
+            }
+            std::string host = address.substr(0, pos), port = address.substr(pos + 1);
+            addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = passive ? AI_PASSIVE : 0;
+            addrinfo *result;
+            int err = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &result);
+            if (err != 0) {
+                throw std::runtime_error("Could not resolve " + address + ": " + gai_strerror(err));
+            }
+            return result;
+        }
+
+        void set_nodelay(int fd) {
+            // frames are small and latency bound
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        void read_exact(int fd, char *buf, size_t n) {
+            while (n > 0) {
+                ssize_t r = read(fd, buf, n);
+                if (r == 0) {
+                    throw std::runtime_error("Connection closed by peer");
+                } else if (r < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error(errno_string("read"));
+                }
+                buf += r;
+                n -= r;
+            }
+        }
+    }  // namespace
+
+    FrameHeader make_header(Command command, uint32_t request_id, uint32_t rows, uint32_t cols) {
+        FrameHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = MAGIC;
+        header.command = command;
+        header.request_id = request_id;
+        header.rows = rows;
+        header.cols = cols;
+        return header;
+    }
+
+    int listen_on(const std::string &address) {
+        int fd;
+        if (is_unix(address)) {
+            sockaddr_un addr = unix_address(address);
+            unlink(addr.sun_path);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if ((fd < 0) || (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)) {
+                std::string msg = errno_string("Could not bind " + address);
+                close(fd);
+                throw std::runtime_error(msg);
+            }
+        } else {
+            addrinfo *info = tcp_address(address, true);
+            fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            int err = (fd < 0) ? -1 : bind(fd, info->ai_addr, info->ai_addrlen);
+            freeaddrinfo(info);
+            if (err != 0) {
+                std::string msg = errno_string("Could not bind " + address);
+                close(fd);
+                throw std::runtime_error(msg);
+            }
+        }
+        if (listen(fd, 4) != 0) {
+            throw std::runtime_error(errno_string("Could not listen on " + address));
+        }
+        return fd;
+    }
+
+    int accept_connection(int listen_fd) {
+        int fd;
+        do {
+            fd = accept(listen_fd, NULL, NULL);
+        } while ((fd < 0) && (errno == EINTR));
+        if (fd < 0) {
+            throw std::runtime_error(errno_string("accept"));
+        }
+        set_nodelay(fd);
+        return fd;
+    }
+
+    int connect_to(const std::string &address, double timeout) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+        while (true) {
+            int fd, err;
+            if (is_unix(address)) {
+                sockaddr_un addr = unix_address(address);
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                err = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+            } else {
+                addrinfo *info = tcp_address(address, false);
+                fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+                err = connect(fd, info->ai_addr, info->ai_addrlen);
+                freeaddrinfo(info);
+            }
+            if (err == 0) {
+                set_nodelay(fd);
+                return fd;
+            }
+            close(fd);
+            if (std::chrono::steady_clock::now() > deadline) {
+                throw std::runtime_error(errno_string("Could not connect to " + address));
+            }
+            // server not up yet
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    void send_frame(int fd, const FrameHeader &header, const double *data) {
+        // header and payload in one syscall
+        iovec iov[2];
+        iov[0].iov_base = const_cast<FrameHeader *>(&header);
+        iov[0].iov_len = sizeof(FrameHeader);
+        iov[1].iov_base = const_cast<double *>(data);
+        iov[1].iov_len = (uint64_t)header.rows * header.cols * sizeof(double);
+        int n_iov = (iov[1].iov_len > 0) ? 2 : 1;
+        int first = 0;
+        while (first < n_iov) {
+            msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov + first;
+            msg.msg_iovlen = n_iov - first;
+            ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(errno_string("send"));
+            }
+            // advance over what was written
+            while ((first < n_iov) && ((size_t)w >= iov[first].iov_len)) {
+                w -= iov[first].iov_len;
+                first++;
+            }
+            if (first < n_iov) {
+                iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + w;
+                iov[first].iov_len -= w;
+            }
+        }
+    }
+
+    FrameHeader recv_frame(int fd, std::vector<double> &data) {
+        FrameHeader header;
+        read_exact(fd, reinterpret_cast<char *>(&header), sizeof(header));
+        uint64_t n = (uint64_t)header.rows * header.cols;
+        if ((header.magic != MAGIC) || (n > MAX_FRAME_DOUBLES)) {
+            throw std::runtime_error("Received a corrupt frame (different protocol version or byte order?)");
+        }
+        data.resize(n);
+        read_exact(fd, reinterpret_cast<char *>(data.data()), n * sizeof(double));
+        return header;
+    }
+
+    void send_error(int fd, uint32_t request_id, const std::string &message) {
+        std::vector<double> chars(message.begin(), message.end());
+        send_frame(fd, make_header(ERROR, request_id, 1, chars.size()), chars.data());
+    }
+
+    std::string error_message(const std::vector<double> &data) { return std::string(data.begin(), data.end()); }
+}  // namespace socket_protocol
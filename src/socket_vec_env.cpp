@@ -0,0 +1,179 @@
+#include <modulation_rl/socket_vec_env.h>
+
+#include <unistd.h>
+#include <limits>
+#include <stdexcept>
+
+SocketVecEnv::SocketVecEnv(std::vector<std::string> addresses, double connect_timeout) {
+    try {
+        for (const std::string &address : addresses) {
+            Server server;
+            server.address = address;
+            server.fd = socket_protocol::connect_to(address, connect_timeout);
+            server.first_env = num_envs_;
+            servers_.push_back(server);
+
+            socket_protocol::send_frame(server.fd, socket_protocol::make_header(socket_protocol::INFO, next_request_id_, 0, 0), NULL);
+            socket_protocol::FrameHeader info = socket_protocol::recv_frame(server.fd, buffer_);
+            if ((info.command != socket_protocol::INFO) || (buffer_.size() != 2)) {
+                throw std::runtime_error("Unexpected response from " + address);
+            }
+            servers_.back().num_envs = buffer_[0];
+            num_envs_ += buffer_[0];
+            if ((obs_dim_ >= 0) && (obs_dim_ != buffer_[1])) {
+                throw std::runtime_error("The env servers do not share the same obs dim");
+            }
+            obs_dim_ = buffer_[1];
+        }
+    } catch (...) {
+        for (Server &server : servers_) {
+            ::close(server.fd);
+        }
+        throw;
+    }
+    next_request_id_++;
+}
+
+SocketVecEnv::~SocketVecEnv() {
+    for (Server &server : servers_) {
+        if (server.fd >= 0) {
+            ::close(server.fd);
+        }
+    }
+}
+
+void SocketVecEnv::check_connections() const {
+    for (const Server &server : servers_) {
+        if (server.fd < 0) {
+            throw std::runtime_error("The connection to " + server.address + " was closed after a protocol error");
+        }
+    }
+}
+
+void SocketVecEnv::disconnect(Server &server) {
+    ::close(server.fd);
+    server.fd = -1;
+}
+
+uint32_t SocketVecEnv::send_all(socket_protocol::Command command) {
+    check_connections();
+    uint32_t request_id = next_request_id_++;
+    for (const Server &server : servers_) {
+        socket_protocol::send_frame(server.fd, socket_protocol::make_header(command, request_id, 0, 0), NULL);
+    }
+    return request_id;
+}
+
+void SocketVecEnv::receive_all(socket_protocol::Command command, uint32_t request_id, Eigen::MatrixXd &result) {
+    // every response is read before reporting an error, unread ones would be taken as the replies to the next request.
+    // A connection whose stream is out of sync is closed, later calls then fail instead of returning stale replies
+    std::string error;
+    for (Server &server : servers_) {
+        if (server.fd < 0) {
+            error += "The connection to " + server.address + " was closed after a protocol error\n";
+            continue;
+        }
+        socket_protocol::FrameHeader response;
+        try {
+            response = socket_protocol::recv_frame(server.fd, buffer_);
+        } catch (const std::exception &e) {
+            error += server.address + ": " + e.what() + "\n";
+            disconnect(server);
+            continue;
+        }
+        if (response.request_id != request_id) {
+            error += "Out of order response from " + server.address + "\n";
+            disconnect(server);
+            continue;
+        }
+        if (response.command == socket_protocol::ERROR) {
+            error += server.address + ": " + socket_protocol::error_message(buffer_) + "\n";
+            continue;
+        }
+        if ((response.command != command) || (response.rows != server.num_envs) || (response.cols > result.cols())) {
+            error += "Unexpected response from " + server.address + "\n";
+            continue;
+        }
+        for (int i = 0; i < response.rows; i++) {
+            for (int j = 0; j < response.cols; j++) {
+                result(server.first_env + i, j) = buffer_[i * response.cols + j];
+            }
+        }
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+Eigen::MatrixXd SocketVecEnv::reset(const std::vector<bool> &mask) {
+    if (!in_flight_.empty()) {
+        throw std::runtime_error("reset() called while steps are in flight");
+    }
+    if (!mask.empty() && (mask.size() != num_envs_)) {
+        throw std::runtime_error("Need one reset mask entry per env");
+    }
+    check_connections();
+    uint32_t request_id = next_request_id_++;
+    std::vector<double> data;
+    for (const Server &server : servers_) {
+        // no payload: reset all envs of the server
+        socket_protocol::FrameHeader header = socket_protocol::make_header(socket_protocol::RESET, request_id, mask.empty() ? 0 : server.num_envs, mask.empty() ? 0 : 1);
+        data.resize(header.rows);
+        for (int i = 0; i < header.rows; i++) {
+            data[i] = mask[server.first_env + i] ? 1.0 : 0.0;
+        }
+        socket_protocol::send_frame(server.fd, header, data.data());
+    }
+    Eigen::MatrixXd obs = Eigen::MatrixXd::Constant(num_envs_, obs_dim_, std::numeric_limits<double>::quiet_NaN());
+    receive_all(socket_protocol::RESET, request_id, obs);
+    return obs;
+}
+
+void SocketVecEnv::step_async(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base) {
+    if (base_actions.rows() != num_envs_) {
+        throw std::runtime_error("Need one row of base actions per env");
+    }
+    check_connections();
+    uint32_t request_id = next_request_id_++;
+    std::vector<double> data;
+    for (const Server &server : servers_) {
+        socket_protocol::FrameHeader header = socket_protocol::make_header(socket_protocol::STEP, request_id, server.num_envs, base_actions.cols());
+        header.int_arg = max_allow_ik_errors;
+        header.noise_ee = transition_noise_ee;
+        header.noise_base = transition_noise_base;
+        // row major on the wire
+        data.resize(header.rows * header.cols);
+        for (int i = 0; i < server.num_envs; i++) {
+            for (int j = 0; j < base_actions.cols(); j++) {
+                data[i * header.cols + j] = base_actions(server.first_env + i, j);
+            }
+        }
+        socket_protocol::send_frame(server.fd, header, data.data());
+    }
+    in_flight_.push_back(request_id);
+}
+
+Eigen::MatrixXd SocketVecEnv::step_wait() {
+    if (in_flight_.empty()) {
+        throw std::runtime_error("step_wait() called without a pending step_async()");
+    }
+    uint32_t request_id = in_flight_.front();
+    in_flight_.pop_front();
+    Eigen::MatrixXd result = Eigen::MatrixXd::Constant(num_envs_, 2 * obs_dim_ + 3, std::numeric_limits<double>::quiet_NaN());
+    receive_all(socket_protocol::STEP, request_id, result);
+    return result;
+}
+
+Eigen::MatrixXd SocketVecEnv::step(const Eigen::MatrixXd &base_actions, int max_allow_ik_errors, double transition_noise_ee, double transition_noise_base) {
+    step_async(base_actions, max_allow_ik_errors, transition_noise_ee, transition_noise_base);
+    return step_wait();
+}
+
+void SocketVecEnv::close() {
+    while (!in_flight_.empty()) {
+        step_wait();
+    }
+    uint32_t request_id = send_all(socket_protocol::CLOSE);
+    Eigen::MatrixXd ignored;
+    receive_all(socket_protocol::CLOSE, request_id, ignored);
+}
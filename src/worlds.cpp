@@ -1,13 +1,26 @@
 #include <modulation_rl/worlds.h>
 
-BaseWorld::BaseWorld(std::string name, bool is_analytical) : name_{name}, is_analytical_{is_analytical} {
+#include <modulation_rl/realtime.h>
+
+BaseWorld::BaseWorld(std::string name, bool is_analytical, ros::NodeHandle *nh, std::string odom_topic) :
+    name_{name},
+    is_analytical_{is_analytical} {
     if (name_ != "sim") {
         listener_.waitForTransform("map", "base_footprint", ros::Time(0), ros::Duration(10.0));
     }
+    if ((name_ != "sim") && (nh != NULL) && !odom_topic.empty()) {
+        base_pose_ = new base_pose::BasePoseProvider(*nh, odom_topic, listener_, "map", "base_footprint");
+    }
 };
 
 tf::Transform BaseWorld::get_base_transform_world() {
-    if (name_ != "sim") {
+    if ((base_pose_ != NULL) && base_pose_->has_pose()) {
+        tf::Transform newBaseTransform = base_pose_->get(ros::Time::now());
+        newBaseTransform.setOrigin(tf::Vector3(newBaseTransform.getOrigin().x(), newBaseTransform.getOrigin().y(), 0.0));
+        return newBaseTransform;
+    } else if (name_ != "sim") {
+        // no odometry yet
+        realtime::AllocationExempt tf_exempt;
         tf::StampedTransform newBaseTransform;
         listener_.lookupTransform("map", "base_footprint", ros::Time(0), newBaseTransform);
         // Seems to sometimes return a non-zero z coordinate for e.g. PR2
@@ -27,8 +40,8 @@ void SimWorld::set_model_state(std::string model_name,
     return;
 }
 
-GazeboWorld::GazeboWorld() :
-    BaseWorld("gazebo", false){
+GazeboWorld::GazeboWorld(ros::NodeHandle *nh, std::string odom_topic) :
+    BaseWorld("gazebo", false, nh, odom_topic){
         // set_model_state_client_ = nh_->serviceClient<gazebo_msgs::SetModelState>("/gazebo/set_model_state");
         // set_model_configuration_client_ = nh_->serviceClient<gazebo_msgs::SetModelConfiguration>("/gazebo/set_model_configuration");
         // pause_gazebo_client_ = nh_->serviceClient<std_srvs::Empty>("/gazebo/pause_physics");
@@ -82,7 +95,7 @@ void GazeboWorld::set_model_state(std::string model_name,
     // start_controllers();
 }
 
-RealWorld::RealWorld() : BaseWorld("world", false){};
+RealWorld::RealWorld(ros::NodeHandle *nh, std::string odom_topic) : BaseWorld("world", false, nh, odom_topic){};
 
 bool RealWorld::is_within_world(tf::Transform base_transform) {
     double min_x = -0.0, max_x = 3.5, min_y = -0.0, max_y = 2.0, max_y_small = 1.0;
@@ -0,0 +1,58 @@
+// Save / load round trip of the modulate_ellipse state after a long run, no roscore needed
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <modulation_rl/env_snapshot.h>
+#include <modulation_rl/modulation_ellipses.h>
+
+namespace {
+    const int N_CYCLES = 1200;
+
+    // layout as in DynamicSystem_base::modulate_ellipse_velocity(), the base drives along x
+    void run_cycle(modulation_ellipses::Modulation &modulation, int i, Eigen::VectorXf &speed) {
+        Eigen::VectorXf pose(14);
+        pose << 0.7, 0.1, 0.8, 0.0, 0.0, 0.0, 1.0, 0.001 * (i % 500), 0.0, 0.0, 0.0, 0.0, 0.0, 1.0;
+        speed.resize(14);
+        speed << 0.01, 0.005, 0.0, 0.0, 0.0, 0.0, 0.0, 0.01, 0.005, 0.0, 0.0, 0.0, 0.0001, 0.0;
+        modulation.run(pose, speed);
+    }
+}  // namespace
+
+TEST(EnvSnapshot, ModulateEllipseRoundTripAfterLongRun) {
+    // the ellipse models are read relative to the project root
+    ASSERT_EQ(chdir(MODULATION_RL_SOURCE_DIR), 0);
+    modulation_ellipses::Modulation modulation;
+    modulation.setEllipses();
+    Eigen::VectorXf speed;
+    for (int i = 0; i < N_CYCLES; i++) {
+        run_cycle(modulation, i, speed);
+    }
+
+    env_snapshot::Snapshot snapshot;
+    modulation.getState(snapshot.ellipses, snapshot.ellipse_real_gamma);
+    // O(state size): one gamma per ellipse, independent of how long the env ran
+    EXPECT_EQ(snapshot.ellipse_real_gamma.size(), snapshot.ellipses.size());
+
+    const std::string filename = "/tmp/test_env_snapshot_" + std::to_string(getpid()) + ".bin";
+    env_snapshot::save(snapshot, filename);
+    env_snapshot::Snapshot loaded = env_snapshot::load(filename);
+    remove(filename.c_str());
+    ASSERT_EQ(loaded.ellipses.size(), snapshot.ellipses.size());
+    EXPECT_EQ(loaded.ellipse_real_gamma, snapshot.ellipse_real_gamma);
+
+    // a restored modulation continues exactly like the original
+    modulation_ellipses::Modulation restored;
+    restored.setEllipses();
+    restored.setState(loaded.ellipses, loaded.ellipse_real_gamma);
+    Eigen::VectorXf restored_speed;
+    for (int i = N_CYCLES; i < N_CYCLES + 20; i++) {
+        run_cycle(modulation, i, speed);
+        run_cycle(restored, i, restored_speed);
+        for (int k = 0; k < speed.size(); k++) {
+            EXPECT_EQ(restored_speed(k), speed(k)) << "cycle " << i << ", entry " << k;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+// Streamed arm commands against a mock controller that subscribes to the command topic, run with rostest
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <modulation_rl/joint_stream.h>
+
+namespace {
+    const double CYCLE_TIME = 0.02;
+    const double EXEC_DURATION = 0.1;
+    const int N_LOOKAHEAD = 3;
+    const int N_CYCLES = 50;
+
+    // records what a JointTrajectoryController would receive on its command topic
+    class MockController {
+      public:
+        MockController(ros::NodeHandle &nh, const std::string &topic) {
+            sub_ = nh.subscribe(topic, N_CYCLES, &MockController::callback, this);
+        }
+        std::vector<trajectory_msgs::JointTrajectory> get_received() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return received_;
+        }
+        std::vector<ros::WallTime> get_receive_times() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return receive_times_;
+        }
+
+      private:
+        ros::Subscriber sub_;
+        std::mutex mutex_;
+        std::vector<trajectory_msgs::JointTrajectory> received_;
+        std::vector<ros::WallTime> receive_times_;
+
+        void callback(const trajectory_msgs::JointTrajectory::ConstPtr &msg) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            received_.push_back(*msg);
+            receive_times_.push_back(ros::WallTime::now());
+        }
+    };
+
+    // joint j moves with constant velocity (j + 1) * 0.1 rad/s
+    std::vector<double> target_at(int cycle, int n_joints) {
+        std::vector<double> target(n_joints);
+        for (int j = 0; j < n_joints; j++) {
+            target[j] = 0.5 * j + (j + 1) * 0.1 * cycle * CYCLE_TIME;
+        }
+        return target;
+    }
+
+    // publishes like DynamicSystem_base::stream_arm_command until the controller has everything
+    void stream(ros::NodeHandle &nh, const std::string &topic, const std::vector<std::string> &joint_names, MockController &controller) {
+        // queue every cycle, a slow publisher thread must not drop messages the tests count
+        ros::Publisher pub = nh.advertise<trajectory_msgs::JointTrajectory>(topic, N_CYCLES);
+        ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(5.0);
+        while (pub.getNumSubscribers() == 0 && ros::WallTime::now() < deadline) {
+            ros::WallDuration(0.01).sleep();
+        }
+        ASSERT_GT(pub.getNumSubscribers(), 0u);
+
+        joint_stream::TrajectoryStreamer streamer;
+        streamer.init(joint_names, N_LOOKAHEAD);
+        ros::WallRate rate(1.0 / CYCLE_TIME);
+        for (int i = 0; i < N_CYCLES; i++) {
+            pub.publish(streamer.update(target_at(i, joint_names.size()), EXEC_DURATION, CYCLE_TIME));
+            rate.sleep();
+        }
+        deadline = ros::WallTime::now() + ros::WallDuration(5.0);
+        while ((int)controller.get_received().size() < N_CYCLES && ros::WallTime::now() < deadline) {
+            ros::WallDuration(0.01).sleep();
+        }
+    }
+}  // namespace
+
+TEST(JointStream, MockControllerReceivesEveryCycle) {
+    ros::NodeHandle nh;
+    const std::string topic = "mock_arm_controller/command";
+    const std::vector<std::string> joint_names = {"joint_a", "joint_b", "joint_c"};
+    MockController controller(nh, topic);
+    stream(nh, topic, joint_names, controller);
+
+    std::vector<trajectory_msgs::JointTrajectory> received = controller.get_received();
+    ASSERT_EQ((int)received.size(), N_CYCLES);
+    for (int i = 0; i < N_CYCLES; i++) {
+        const trajectory_msgs::JointTrajectory &traj = received[i];
+        EXPECT_EQ(traj.joint_names, joint_names);
+        // zero stamp: the controller starts it on receipt and replaces the rest of the previous one
+        EXPECT_EQ(traj.header.stamp, ros::Time(0));
+        ASSERT_EQ((int)traj.points.size(), N_LOOKAHEAD + 1);
+        std::vector<double> target = target_at(i, joint_names.size());
+        for (int k = 0; k < traj.points.size(); k++) {
+            EXPECT_NEAR(traj.points[k].time_from_start.toSec(), EXEC_DURATION + k * CYCLE_TIME, 1e-9);
+            for (int j = 0; j < joint_names.size(); j++) {
+                // no velocity estimate before the second cycle, afterwards the constant target velocity
+                double vel = (i == 0) ? 0.0 : (j + 1) * 0.1;
+                EXPECT_NEAR(traj.points[k].velocities[j], vel, 1e-9);
+                EXPECT_NEAR(traj.points[k].positions[j], target[j] + k * CYCLE_TIME * vel, 1e-9);
+            }
+        }
+    }
+    // for a constant velocity the first lookahead point is the next cycle's target
+    for (int i = 1; i + 1 < N_CYCLES; i++) {
+        for (int j = 0; j < joint_names.size(); j++) {
+            EXPECT_NEAR(received[i].points[1].positions[j], received[i + 1].points[0].positions[j], 1e-9);
+        }
+    }
+}
+
+TEST(JointStream, MockControllerTiming) {
+    ros::NodeHandle nh;
+    const std::string topic = "mock_timing_controller/command";
+    MockController controller(nh, topic);
+    stream(nh, topic, {"joint_a"}, controller);
+
+    std::vector<ros::WallTime> times = controller.get_receive_times();
+    // loose bound on a loaded machine, only over the messages that actually arrived: on average a message arrives before
+    // the previous one's first point is due
+    ASSERT_GE((int)times.size(), 2);
+    double mean_period = (times.back() - times.front()).toSec() / (times.size() - 1);
+    EXPECT_LT(mean_period, EXEC_DURATION);
+}
+
+TEST(JointStream, SelectJointsSplitsControllers) {
+    joint_stream::TrajectoryStreamer streamer;
+    streamer.init({"torso", "arm_1", "arm_2"}, N_LOOKAHEAD);
+    streamer.update({0.1, 0.2, 0.3}, EXEC_DURATION, CYCLE_TIME);
+    const trajectory_msgs::JointTrajectory &traj = streamer.update({0.2, 0.4, 0.6}, EXEC_DURATION, CYCLE_TIME);
+
+    trajectory_msgs::JointTrajectory torso, arm;
+    joint_stream::select_joints(traj, {0}, torso);
+    joint_stream::select_joints(traj, {1, 2}, arm);
+    ASSERT_EQ(torso.joint_names, std::vector<std::string>({"torso"}));
+    ASSERT_EQ(arm.joint_names, std::vector<std::string>({"arm_1", "arm_2"}));
+    ASSERT_EQ((int)arm.points.size(), N_LOOKAHEAD + 1);
+    for (int k = 0; k < traj.points.size(); k++) {
+        EXPECT_EQ(torso.points[k].time_from_start, traj.points[k].time_from_start);
+        EXPECT_DOUBLE_EQ(torso.points[k].positions[0], traj.points[k].positions[0]);
+        EXPECT_DOUBLE_EQ(arm.points[k].positions[0], traj.points[k].positions[1]);
+        EXPECT_DOUBLE_EQ(arm.points[k].velocities[1], traj.points[k].velocities[2]);
+    }
+    // reset() drops the velocity estimate, e.g. at the start of an episode
+    streamer.reset();
+    EXPECT_DOUBLE_EQ(streamer.update({0.3, 0.6, 0.9}, EXEC_DURATION, CYCLE_TIME).points[N_LOOKAHEAD].positions[2], 0.9);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "test_joint_stream");
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    int ret = RUN_ALL_TESTS();
+    spinner.stop();
+    ros::shutdown();
+    return ret;
+}
@@ -0,0 +1,250 @@
+// Heap allocations of the components the real-time control cycle uses (LatestValue mailboxes, TrajectoryStreamer,
+// ControlTiming, Profiler, EpisodeStats), counted by overriding malloc and operator new. Needs no roscore. RealtimeCycle
+// below only replays how DynamicSystem_base::control_loop drives them, it does not run control_loop itself: a change to
+// the loop that allocates is not caught here
+#include <gtest/gtest.h>
+#include <geometry_msgs/Twist.h>
+#include <stdlib.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <modulation_rl/control_timing.h>
+#include <modulation_rl/episode_stats.h>
+#include <modulation_rl/joint_stream.h>
+#include <modulation_rl/latest_value.h>
+#include <modulation_rl/profiler.h>
+#include <modulation_rl/realtime.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+namespace {
+    std::atomic<uint64_t> allocations{0};
+    // keeps the compiler from eliding the allocations of the sanity check
+    void *volatile sink = NULL;
+    // only the test thread counts, and only between start_counting() and stop_counting()
+    thread_local bool counting = false;
+
+    void count_allocation() {
+        if (counting && !realtime::AllocationExempt::active()) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void start_counting() {
+        allocations = 0;
+        counting = true;
+    }
+
+    uint64_t stop_counting() {
+        counting = false;
+        return allocations.load();
+    }
+}  // namespace
+
+extern "C" {
+void *malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+void *calloc(size_t n, size_t size) {
+    count_allocation();
+    return __libc_calloc(n, size);
+}
+void *realloc(void *ptr, size_t size) {
+    count_allocation();
+    return __libc_realloc(ptr, size);
+}
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+}
+
+void *operator new(size_t size) {
+    count_allocation();
+    void *ptr = __libc_malloc(size);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void *ptr) noexcept {
+    __libc_free(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+    __libc_free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept {
+    __libc_free(ptr);
+}
+void operator delete[](void *ptr, size_t) noexcept {
+    __libc_free(ptr);
+}
+
+namespace {
+    const int N_JOINTS = 8;
+    const int OBS_DIM = 24;
+    const int N_WARMUP = 10;
+    const int N_CYCLES = 1000;
+    const double CYCLE_TIME = 0.02;
+
+    // same layout as DynamicSystem_base's mailboxes
+    struct ControlCommand {
+        std::vector<double> base_actions;
+        int max_allow_ik_errors;
+    };
+    struct ControlObs {
+        std::vector<double> retval;
+        uint64_t cycle = 0;
+        double reward_total = 0.0;
+    };
+    struct RobotCommand {
+        trajectory_msgs::JointTrajectory arm;
+        geometry_msgs::Twist base;
+    };
+
+    // replays the calls DynamicSystem_base::control_loop / control_cycle make on these components in real-time mode, in the
+    // same order, with stand-ins for the exempt ik and planner calls
+    class RealtimeCycle {
+      public:
+        RealtimeCycle() : joint_values_(N_JOINTS, 0.0), command_{std::vector<double>(3, 0.0), 10} {
+            std::vector<std::string> joint_names;
+            for (int j = 0; j < N_JOINTS; j++) {
+                joint_names.push_back("joint_" + std::to_string(j));
+            }
+            streamer_.init(joint_names, 3);
+            profiler_.set_enabled(true);
+            timing_.set_expected_period(CYCLE_TIME);
+            // what DynamicSystem_base::preallocate_control_buffers does
+            obs_mailbox_.for_each_slot([](ControlObs &obs) { obs.retval.reserve(OBS_DIM + 3); });
+            const trajectory_msgs::JointTrajectory &arm = streamer_.get_trajectory();
+            command_mailbox_.for_each_slot([&arm](RobotCommand &command) { command.arm = arm; });
+            action_mailbox_.for_each_slot([](ControlCommand &command) { command.base_actions.assign(3, 0.0); });
+        }
+
+        // one control cycle, with the caller posting an action like step_control_thread() does
+        void run(int i) {
+            ControlCommand &action = action_mailbox_.back();
+            action.base_actions[0] = 0.1 * i;
+            action_mailbox_.publish();
+
+            action_mailbox_.read(command_);
+            profiler::ScopedTimer repeat_timer(profiler_, profiler::ACTION_REPEAT);
+            {
+                profiler::ScopedTimer planner_timer(profiler_, profiler::PLANNER);
+                realtime::AllocationExempt planner_exempt;
+                // a planner that allocates
+                std::vector<double> plan(64, 1.0);
+                sink = plan.data();
+            }
+            {
+                profiler::ScopedTimer ik_timer(profiler_, profiler::IK);
+                realtime::AllocationExempt ik_exempt;
+                for (int j = 0; j < N_JOINTS; j++) {
+                    joint_values_[j] = 0.01 * i * (j + 1);
+                }
+            }
+            {
+                profiler::ScopedTimer exec_timer(profiler_, profiler::EXECUTION);
+                const double now = i * CYCLE_TIME;
+                timing_.sleep_start(now - 0.5 * CYCLE_TIME);
+                timing_.wake(now, true);
+                RobotCommand &command = command_mailbox_.back();
+                command.arm = streamer_.update(joint_values_, 0.1, CYCLE_TIME);
+                command.base.linear.x = command_.base_actions[0];
+                command_mailbox_.publish();
+                timing_.command_sent(now + 0.001);
+                timing_.add_feedback_sample_delay(0.005);
+            }
+            episode_stats::Step step = {false, false, 0.01, 0.02, 0.03, 0.4, -0.2, 0.8};
+            stats_.add_step(step);
+            reward_total_ -= 0.1;
+
+            ControlObs &obs = obs_mailbox_.back();
+            {
+                profiler::ScopedTimer obs_timer(profiler_, profiler::OBS);
+                obs.retval.clear();
+                for (int k = 0; k < OBS_DIM; k++) {
+                    obs.retval.push_back(k * 0.5);
+                }
+            }
+            obs.retval.push_back(-0.1);
+            obs.retval.push_back(0);
+            obs.retval.push_back(0);
+            obs.cycle = i + 1;
+            obs.reward_total = reward_total_;
+            obs_mailbox_.publish();
+        }
+
+        // the command thread and the python side picking up the newest values
+        void read() {
+            command_mailbox_.update();
+            obs_mailbox_.update();
+        }
+        const LatestValue<ControlObs> &get_obs_mailbox() const { return obs_mailbox_; };
+
+      private:
+        std::vector<double> joint_values_;
+        ControlCommand command_;
+        joint_stream::TrajectoryStreamer streamer_;
+        profiler::Profiler profiler_;
+        control_timing::ControlTiming timing_;
+        episode_stats::EpisodeStats stats_;
+        LatestValue<ControlCommand> action_mailbox_;
+        LatestValue<ControlObs> obs_mailbox_;
+        LatestValue<RobotCommand> command_mailbox_;
+        double reward_total_ = 0.0;
+    };
+}  // namespace
+
+TEST(RealtimeAlloc, CountsAllocationsOutsideExemptSections) {
+    // otherwise the zero counts below would prove nothing
+    start_counting();
+    std::vector<double> *counted = new std::vector<double>(16);
+    sink = counted;
+    void *raw = malloc(64);
+    sink = raw;
+    uint64_t n = stop_counting();
+    EXPECT_GE(n, 3u);
+    free(raw);
+    delete counted;
+
+    start_counting();
+    {
+        realtime::AllocationExempt exempt;
+        {
+            realtime::AllocationExempt nested;
+        }
+        std::vector<double> exempt_vector(16);
+        sink = exempt_vector.data();
+        std::string exempt_string(100, 'x');
+        sink = &exempt_string[0];
+    }
+    EXPECT_EQ(stop_counting(), 0u);
+    EXPECT_FALSE(realtime::AllocationExempt::active());
+}
+
+TEST(RealtimeAlloc, WarmCycleComponentsDoNotAllocate) {
+    RealtimeCycle cycle;
+    for (int i = 0; i < N_WARMUP; i++) {
+        cycle.run(i);
+        cycle.read();
+    }
+    start_counting();
+    for (int i = N_WARMUP; i < N_WARMUP + N_CYCLES; i++) {
+        cycle.run(i);
+        cycle.read();
+    }
+    EXPECT_EQ(stop_counting(), 0u);
+    EXPECT_EQ(cycle.get_obs_mailbox().front().cycle, (uint64_t)(N_WARMUP + N_CYCLES));
+}
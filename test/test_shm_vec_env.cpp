@@ -0,0 +1,140 @@
+// ShmVecEnv against forked stub env servers, no ROS needed
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <modulation_rl/shm_vec_env.h>
+
+namespace {
+    const int OBS_DIM = 3;
+
+    enum StepFailure { NONE, ERROR_REPLY, OVERSIZED_REPLY };
+
+    // answers like modulation_rl_env_server: obs = [env, number of resets, number of steps], every step fails as configured
+    void serve_stub(const std::string &name, int env, StepFailure failure) {
+        shm_channel::Channel *channel = shm_channel::Channel::open(name);
+        std::vector<double> payload(channel->requests().get_slot_capacity());
+        int resets = 0, steps = 0;
+        while (true) {
+            shm_channel::MessageHeader request = channel->requests().pop(payload.data(), payload.size());
+            shm_channel::MessageHeader response = {request.command, 0, 0.0, 0.0, 0};
+            std::vector<double> result;
+            if (request.command == shm_channel::RESET) {
+                resets++;
+                result = {(double)env, (double)resets, (double)steps};
+            } else if ((request.command == shm_channel::STEP) && (failure == ERROR_REPLY)) {
+                std::string msg = "stub step failed";
+                response.command = shm_channel::ERROR;
+                result.assign(msg.begin(), msg.end());
+            } else if ((request.command == shm_channel::STEP) && (failure == OVERSIZED_REPLY)) {
+                result.assign(4 * OBS_DIM, 0.0);
+            } else if (request.command == shm_channel::STEP) {
+                steps++;
+                result = {(double)env, (double)resets, (double)steps, payload[0], 0.0, 0.0};
+                result.resize(2 * OBS_DIM + 3, std::nan(""));
+            }
+            response.size = result.size();
+            channel->responses().push(response, result.data());
+            if (request.command == shm_channel::CLOSE) {
+                break;
+            }
+        }
+        delete channel;
+    }
+
+    class ShmVecEnvTest : public ::testing::Test {
+      protected:
+        std::vector<pid_t> servers_;
+
+        ShmVecEnv *start(const std::vector<StepFailure> &failures) {
+            const int num_envs = failures.size();
+            std::vector<std::string> names;
+            for (int i = 0; i < num_envs; i++) {
+                names.push_back("/mrl_test_" + std::to_string(getpid()) + "_" + std::to_string(i));
+            }
+            ShmVecEnv *vec_env = new ShmVecEnv(names, 2, 64);
+            for (int i = 0; i < num_envs; i++) {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    serve_stub(names[i], i, failures[i]);
+                    _exit(0);
+                }
+                servers_.push_back(pid);
+            }
+            EXPECT_TRUE(vec_env->wait_for_servers(5.0));
+            return vec_env;
+        }
+
+        void TearDown() override {
+            for (pid_t pid : servers_) {
+                int status;
+                waitpid(pid, &status, 0);
+                EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+            }
+        }
+    };
+}  // namespace
+
+TEST_F(ShmVecEnvTest, ResetAndStep) {
+    ShmVecEnv *vec_env = start({NONE, NONE, NONE});
+    Eigen::MatrixXd obs = vec_env->reset();
+    ASSERT_EQ(vec_env->get_obs_dim(), OBS_DIM);
+    ASSERT_EQ(obs.rows(), 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(obs(i, 0), i);
+        EXPECT_EQ(obs(i, 1), 1);
+    }
+    Eigen::MatrixXd actions = Eigen::MatrixXd::Constant(3, 1, 0.5);
+    Eigen::MatrixXd result = vec_env->step(actions, 100, 0.0, 0.0);
+    ASSERT_EQ(result.cols(), 2 * OBS_DIM + 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(result(i, 0), i);
+        EXPECT_EQ(result(i, 2), 1);
+        EXPECT_EQ(result(i, 3), 0.5);
+        EXPECT_TRUE(std::isnan(result(i, 2 * OBS_DIM + 2)));
+    }
+    vec_env->close();
+    delete vec_env;
+}
+
+TEST_F(ShmVecEnvTest, ResetMask) {
+    ShmVecEnv *vec_env = start({NONE, NONE, NONE});
+    vec_env->reset();
+    Eigen::MatrixXd obs = vec_env->reset({false, true, false});
+    EXPECT_TRUE(std::isnan(obs(0, 0)));
+    EXPECT_EQ(obs(1, 0), 1);
+    EXPECT_EQ(obs(1, 1), 2);
+    EXPECT_TRUE(std::isnan(obs(2, 0)));
+    // the envs that were not reset have no reply left over
+    obs = vec_env->reset();
+    EXPECT_EQ(obs(0, 1), 2);
+    EXPECT_EQ(obs(1, 1), 3);
+    EXPECT_EQ(obs(2, 1), 2);
+    EXPECT_THROW(vec_env->reset({true}), std::runtime_error);
+    vec_env->close();
+    delete vec_env;
+}
+
+TEST_F(ShmVecEnvTest, FailedRepliesDrainAllChannels) {
+    ShmVecEnv *vec_env = start({OVERSIZED_REPLY, ERROR_REPLY, NONE});
+    vec_env->reset();
+    Eigen::MatrixXd actions = Eigen::MatrixXd::Zero(3, 1);
+    try {
+        vec_env->step(actions, 100, 0.0, 0.0);
+        FAIL() << "step() should report the failing server";
+    } catch (const std::runtime_error &e) {
+        EXPECT_NE(std::string(e.what()).find("larger than expected"), std::string::npos);
+        EXPECT_NE(std::string(e.what()).find("stub step failed"), std::string::npos);
+    }
+    // the replies of all servers were consumed with the failing ones
+    Eigen::MatrixXd obs = vec_env->reset();
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(obs(i, 0), i);
+        EXPECT_EQ(obs(i, 1), 2);
+    }
+    vec_env->close();
+    delete vec_env;
+}
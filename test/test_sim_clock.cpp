@@ -0,0 +1,145 @@
+// LockstepClock against a fake simulation that publishes a clock while unpaused and offers Empty pause / unpause services,
+// run with rostest
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+#include <std_srvs/Empty.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <modulation_rl/sim_clock.h>
+
+namespace {
+    const double DT = 0.05;
+
+    // advances its time by step every step / real_time_factor [s, wall time] while unpaused. Starts paused
+    class FakeSim {
+      public:
+        FakeSim(ros::NodeHandle &nh, double step, double real_time_factor) : step_(step), real_time_factor_(real_time_factor) {
+            clock_pub_ = nh.advertise<rosgraph_msgs::Clock>("fake_clock", 10);
+            pause_srv_ = nh.advertiseService("fake_sim/pause_physics", &FakeSim::pause, this);
+            unpause_srv_ = nh.advertiseService("fake_sim/unpause_physics", &FakeSim::unpause, this);
+            thread_ = std::thread(&FakeSim::run, this);
+        }
+        ~FakeSim() {
+            running_ = false;
+            thread_.join();
+        }
+        double get_time() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return time_;
+        }
+        bool is_paused() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return paused_;
+        }
+        // keeps running but the clock stops, like a hanging physics step
+        void set_frozen(bool frozen) { frozen_ = frozen; }
+
+      private:
+        const double step_;
+        const double real_time_factor_;
+        ros::Publisher clock_pub_;
+        ros::ServiceServer pause_srv_;
+        ros::ServiceServer unpause_srv_;
+        std::thread thread_;
+        std::atomic<bool> running_{true};
+        std::atomic<bool> frozen_{false};
+        std::mutex mutex_;
+        bool paused_ = true;
+        double time_ = 0.0;
+
+        bool pause(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            paused_ = true;
+            return true;
+        }
+        bool unpause(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            paused_ = false;
+            return true;
+        }
+        void run() {
+            while (running_) {
+                ros::WallDuration(step_ / real_time_factor_).sleep();
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (paused_ || frozen_) {
+                    continue;
+                }
+                time_ += step_;
+                rosgraph_msgs::Clock msg;
+                msg.clock = ros::Time(time_);
+                clock_pub_.publish(msg);
+            }
+        }
+    };
+
+    // longest round trip of the pause service [s, wall time]
+    double max_pause_rtt(sim_clock::LockstepClock &clock, int n) {
+        double rtt = 0.0;
+        for (int i = 0; i < n; i++) {
+            ros::WallTime start = ros::WallTime::now();
+            clock.pause();
+            rtt = std::max(rtt, (ros::WallTime::now() - start).toSec());
+        }
+        return rtt;
+    }
+
+    void check_advance(double step, double real_time_factor) {
+        ros::NodeHandle nh;
+        FakeSim sim(nh, step, real_time_factor);
+        sim_clock::LockstepClock clock(nh, "fake_clock", "fake_sim/pause_physics", "fake_sim/unpause_physics");
+        // nothing published yet: the first advance has to unpause to see the clock
+        EXPECT_LT(clock.now(), 0.0);
+        const double rtt = max_pause_rtt(clock, 10);
+
+        for (int i = 0; i < 20; i++) {
+            const double passed = clock.advance(DT);
+            EXPECT_TRUE(sim.is_paused());
+            EXPECT_GE(passed, DT - 1e-9);
+            // overshoot: one clock period plus the simulated time that passes until the pause call arrives, i.e. about the
+            // real-time factor times the clock delivery and service round trip. Slack for scheduling on a loaded machine
+            EXPECT_LE(passed - DT, step + real_time_factor * (2.0 * rtt + 0.02)) << "cycle " << i;
+            // stays paused between the steps
+            const double paused_at = sim.get_time();
+            ros::WallDuration(2.0 * step / real_time_factor).sleep();
+            EXPECT_DOUBLE_EQ(sim.get_time(), paused_at);
+        }
+        EXPECT_GE(clock.now(), 20 * DT - 1e-9);
+    }
+}  // namespace
+
+TEST(LockstepClock, AdvanceAtRealTime) {
+    check_advance(0.001, 1.0);
+}
+
+TEST(LockstepClock, AdvanceFasterThanRealTime) {
+    check_advance(0.001, 4.0);
+}
+
+TEST(LockstepClock, ThrowsAndPausesIfTheClockStops) {
+    ros::NodeHandle nh;
+    FakeSim sim(nh, 0.001, 1.0);
+    sim_clock::LockstepClock clock(nh, "fake_clock", "fake_sim/pause_physics", "fake_sim/unpause_physics");
+    clock.advance(DT);
+    sim.set_frozen(true);
+    EXPECT_THROW(clock.advance(DT, 0.5), std::runtime_error);
+    EXPECT_TRUE(sim.is_paused());
+    sim.set_frozen(false);
+    EXPECT_GE(clock.advance(DT), DT - 1e-9);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "test_sim_clock");
+    // the service calls of the clock are answered by the fake sim in the same process
+    ros::AsyncSpinner spinner(2);
+    spinner.start();
+    int ret = RUN_ALL_TESTS();
+    spinner.stop();
+    ros::shutdown();
+    return ret;
+}
@@ -0,0 +1,200 @@
+// SocketVecEnv against stub servers on a unix socket and on 127.0.0.1, no ROS needed
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <modulation_rl/socket_vec_env.h>
+
+namespace {
+    const int OBS_DIM = 3;
+
+    enum StepFailure { NONE, ERROR_REPLY, WRONG_REQUEST_ID };
+
+    // answers like modulation_rl_socket_server for num_envs envs: obs = [global env index, number of resets, number of steps]
+    class StubServer {
+      public:
+        StubServer(const std::string &address, int num_envs, int first_env, StepFailure failure) :
+            num_envs_(num_envs),
+            first_env_(first_env),
+            failure_(failure),
+            resets_(num_envs, 0),
+            steps_(num_envs, 0) {
+            listen_fd_ = socket_protocol::listen_on(address);
+            address_ = address;
+            if (address.compare(0, 5, "unix:") != 0) {
+                // bound to port 0, connect to the one the kernel picked
+                sockaddr_in addr;
+                socklen_t len = sizeof(addr);
+                getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len);
+                address_ = "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+            }
+            thread_ = std::thread(&StubServer::serve, this);
+        }
+        ~StubServer() {
+            thread_.join();
+            close(listen_fd_);
+            if (address_.compare(0, 5, "unix:") == 0) {
+                unlink(address_.substr(5).c_str());
+            }
+        }
+        std::string get_address() const { return address_; }
+
+      private:
+        int listen_fd_;
+        std::string address_;
+        int num_envs_, first_env_;
+        StepFailure failure_;
+        std::vector<int> resets_, steps_;
+        std::thread thread_;
+
+        void serve() {
+            int fd = socket_protocol::accept_connection(listen_fd_);
+            std::vector<double> request_data;
+            try {
+                while (true) {
+                    socket_protocol::FrameHeader request = socket_protocol::recv_frame(fd, request_data);
+                    socket_protocol::FrameHeader response =
+                        socket_protocol::make_header((socket_protocol::Command)request.command, request.request_id, num_envs_, 0);
+                    std::vector<double> result;
+                    if (request.command == socket_protocol::INFO) {
+                        result = {(double)num_envs_, (double)OBS_DIM};
+                        response.rows = 1;
+                        response.cols = 2;
+                    } else if (request.command == socket_protocol::RESET) {
+                        result.assign(num_envs_ * OBS_DIM, std::numeric_limits<double>::quiet_NaN());
+                        for (int i = 0; i < num_envs_; i++) {
+                            if ((request.rows == 0) || (request_data[i] != 0.0)) {
+                                resets_[i]++;
+                                result[i * OBS_DIM] = first_env_ + i;
+                                result[i * OBS_DIM + 1] = resets_[i];
+                                result[i * OBS_DIM + 2] = steps_[i];
+                            }
+                        }
+                        response.cols = OBS_DIM;
+                    } else if ((request.command == socket_protocol::STEP) && (failure_ == ERROR_REPLY)) {
+                        socket_protocol::send_error(fd, request.request_id, "stub step failed");
+                        continue;
+                    } else if (request.command == socket_protocol::STEP) {
+                        const int cols = 2 * OBS_DIM + 3;
+                        result.assign(num_envs_ * cols, std::numeric_limits<double>::quiet_NaN());
+                        for (int i = 0; i < num_envs_; i++) {
+                            steps_[i]++;
+                            result[i * cols] = first_env_ + i;
+                            result[i * cols + 1] = resets_[i];
+                            result[i * cols + 2] = steps_[i];
+                            // reward: first action of the env
+                            result[i * cols + OBS_DIM] = request_data[i * request.cols];
+                        }
+                        response.cols = cols;
+                        if (failure_ == WRONG_REQUEST_ID) {
+                            response.request_id++;
+                        }
+                    }
+                    socket_protocol::send_frame(fd, response, result.data());
+                    if (request.command == socket_protocol::CLOSE) {
+                        break;
+                    }
+                }
+            } catch (const std::exception &e) {
+                // the client closed the connection
+            }
+            close(fd);
+        }
+    };
+
+    std::string unix_address(const std::string &name) { return "unix:/tmp/mrl_test_" + std::to_string(getpid()) + "_" + name + ".sock"; }
+}  // namespace
+
+TEST(SocketVecEnvTest, ResetAndStepOverLoopback) {
+    StubServer unix_server(unix_address("a"), 2, 0, NONE);
+    StubServer tcp_server("127.0.0.1:0", 3, 2, NONE);
+    SocketVecEnv vec_env({unix_server.get_address(), tcp_server.get_address()}, 5.0);
+    ASSERT_EQ(vec_env.get_num_envs(), 5);
+    ASSERT_EQ(vec_env.get_obs_dim(), OBS_DIM);
+
+    Eigen::MatrixXd obs = vec_env.reset();
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(obs(i, 0), i);
+        EXPECT_EQ(obs(i, 1), 1);
+    }
+    Eigen::MatrixXd actions(5, 2);
+    for (int i = 0; i < 5; i++) {
+        actions(i, 0) = 0.1 * i;
+        actions(i, 1) = 0.0;
+    }
+    // two pipelined batches come back in order
+    vec_env.step_async(actions, 100, 0.0, 0.0);
+    vec_env.step_async(actions, 100, 0.0, 0.0);
+    EXPECT_EQ(vec_env.get_num_in_flight(), 2);
+    Eigen::MatrixXd first = vec_env.step_wait(), second = vec_env.step_wait();
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(first(i, 0), i);
+        EXPECT_EQ(first(i, 2), 1);
+        EXPECT_EQ(second(i, 2), 2);
+        EXPECT_DOUBLE_EQ(first(i, OBS_DIM), 0.1 * i);
+        EXPECT_TRUE(std::isnan(first(i, 2 * OBS_DIM + 2)));
+    }
+    vec_env.close();
+}
+
+TEST(SocketVecEnvTest, ResetMask) {
+    StubServer unix_server(unix_address("b"), 2, 0, NONE);
+    StubServer tcp_server("127.0.0.1:0", 2, 2, NONE);
+    SocketVecEnv vec_env({unix_server.get_address(), tcp_server.get_address()}, 5.0);
+    vec_env.reset();
+    Eigen::MatrixXd obs = vec_env.reset({false, true, false, true});
+    EXPECT_TRUE(std::isnan(obs(0, 0)));
+    EXPECT_EQ(obs(1, 1), 2);
+    EXPECT_TRUE(std::isnan(obs(2, 0)));
+    EXPECT_EQ(obs(3, 1), 2);
+    obs = vec_env.reset();
+    EXPECT_EQ(obs(0, 1), 2);
+    EXPECT_EQ(obs(1, 1), 3);
+    EXPECT_THROW(vec_env.reset({true}), std::runtime_error);
+    vec_env.close();
+}
+
+TEST(SocketVecEnvTest, ErrorReplyDrainsAllConnections) {
+    StubServer failing(unix_address("c"), 1, 0, ERROR_REPLY);
+    StubServer healthy(unix_address("d"), 1, 1, NONE);
+    SocketVecEnv vec_env({failing.get_address(), healthy.get_address()}, 5.0);
+    vec_env.reset();
+    try {
+        vec_env.step(Eigen::MatrixXd::Zero(2, 1), 100, 0.0, 0.0);
+        FAIL() << "step() should report the failing server";
+    } catch (const std::runtime_error &e) {
+        EXPECT_NE(std::string(e.what()).find("stub step failed"), std::string::npos);
+    }
+    // the reply of the healthy server was consumed, the next request gets its own reply
+    Eigen::MatrixXd obs = vec_env.reset();
+    EXPECT_EQ(obs(0, 1), 2);
+    EXPECT_EQ(obs(1, 0), 1);
+    EXPECT_EQ(obs(1, 1), 2);
+    EXPECT_EQ(obs(1, 2), 1);
+    vec_env.close();
+}
+
+TEST(SocketVecEnvTest, OutOfOrderReplyClosesConnection) {
+    StubServer broken(unix_address("e"), 1, 0, WRONG_REQUEST_ID);
+    StubServer healthy(unix_address("f"), 1, 1, NONE);
+    {
+        SocketVecEnv vec_env({broken.get_address(), healthy.get_address()}, 5.0);
+        vec_env.reset();
+        try {
+            vec_env.step(Eigen::MatrixXd::Zero(2, 1), 100, 0.0, 0.0);
+            FAIL() << "step() should report the out of order reply";
+        } catch (const std::runtime_error &e) {
+            EXPECT_NE(std::string(e.what()).find("Out of order"), std::string::npos);
+        }
+        // nothing is sent while a connection is out of sync
+        EXPECT_THROW(vec_env.reset(), std::runtime_error);
+        EXPECT_THROW(vec_env.step(Eigen::MatrixXd::Zero(2, 1), 100, 0.0, 0.0), std::runtime_error);
+        EXPECT_EQ(vec_env.get_num_in_flight(), 0);
+    }
+}